@@ -624,6 +624,89 @@ PHP_METHOD(opencreport_expr, set_delayed) {
 	ocrpt_expr_set_delayed(eo->e, value);
 }
 
+PHP_METHOD(opencreport_expr, get_profile) {
+	zval *object = getThis();
+	php_opencreport_expr_object *eo = Z_OPENCREPORT_EXPR_P(object);
+	uint64_t calls, total_ns, self_ns;
+
+	if (!eo->e) {
+		zend_throw_error(NULL, "OpenCReport\\Expr object was freed");
+		RETURN_THROWS();
+	}
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	if (!ocrpt_expr_get_profile(eo->e, &calls, &total_ns, &self_ns))
+		RETURN_NULL();
+
+	array_init(return_value);
+
+#if PHP_VERSION_ID >= 70000
+	zval tmp;
+
+	ZVAL_LONG(&tmp, calls);
+	zend_hash_str_add_new(Z_ARRVAL_P(return_value), "calls", 5, &tmp);
+
+	ZVAL_LONG(&tmp, total_ns);
+	zend_hash_str_add_new(Z_ARRVAL_P(return_value), "total_ns", 8, &tmp);
+
+	ZVAL_LONG(&tmp, self_ns);
+	zend_hash_str_add_new(Z_ARRVAL_P(return_value), "self_ns", 7, &tmp);
+#else
+	zval *tmp;
+
+	ALLOC_INIT_ZVAL(tmp);
+	ZVAL_LONG(tmp, calls);
+	zend_hash_add(Z_ARRVAL_P(return_value), "calls", sizeof("calls"), &tmp, sizeof(zval*), NULL);
+
+	ALLOC_INIT_ZVAL(tmp);
+	ZVAL_LONG(tmp, total_ns);
+	zend_hash_add(Z_ARRVAL_P(return_value), "total_ns", sizeof("total_ns"), &tmp, sizeof(zval*), NULL);
+
+	ALLOC_INIT_ZVAL(tmp);
+	ZVAL_LONG(tmp, self_ns);
+	zend_hash_add(Z_ARRVAL_P(return_value), "self_ns", sizeof("self_ns"), &tmp, sizeof(zval*), NULL);
+#endif
+}
+
+PHP_METHOD(opencreport_expr, get_memo_stats) {
+	zval *object = getThis();
+	php_opencreport_expr_object *eo = Z_OPENCREPORT_EXPR_P(object);
+	uint64_t hits, misses;
+
+	if (!eo->e) {
+		zend_throw_error(NULL, "OpenCReport\\Expr object was freed");
+		RETURN_THROWS();
+	}
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	if (!ocrpt_expr_get_memo_stats(eo->e, &hits, &misses))
+		RETURN_NULL();
+
+	array_init(return_value);
+
+#if PHP_VERSION_ID >= 70000
+	zval tmp;
+
+	ZVAL_LONG(&tmp, hits);
+	zend_hash_str_add_new(Z_ARRVAL_P(return_value), "hits", 4, &tmp);
+
+	ZVAL_LONG(&tmp, misses);
+	zend_hash_str_add_new(Z_ARRVAL_P(return_value), "misses", 6, &tmp);
+#else
+	zval *tmp;
+
+	ALLOC_INIT_ZVAL(tmp);
+	ZVAL_LONG(tmp, hits);
+	zend_hash_add(Z_ARRVAL_P(return_value), "hits", sizeof("hits"), &tmp, sizeof(zval*), NULL);
+
+	ALLOC_INIT_ZVAL(tmp);
+	ZVAL_LONG(tmp, misses);
+	zend_hash_add(Z_ARRVAL_P(return_value), "misses", sizeof("misses"), &tmp, sizeof(zval*), NULL);
+#endif
+}
+
 #if PHP_VERSION_ID >= 70000
 
 OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_expr_free, 0, 0, IS_VOID, 0)
@@ -728,6 +811,12 @@ OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_expr_set_delayed, 0
 ZEND_ARG_TYPE_INFO(0, value, _IS_BOOL, 0)
 ZEND_END_ARG_INFO()
 
+OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_expr_get_profile, 0, 0, IS_ARRAY, 1)
+ZEND_END_ARG_INFO()
+
+OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_expr_get_memo_stats, 0, 0, IS_ARRAY, 1)
+ZEND_END_ARG_INFO()
+
 #else
 
 #define arginfo_opencreport_expr_free NULL
@@ -758,6 +847,8 @@ ZEND_END_ARG_INFO()
 #define arginfo_opencreport_expr_set_nth_result_double NULL
 #define arginfo_opencreport_expr_set_iterative_start_value NULL
 #define arginfo_opencreport_expr_set_delayed NULL
+#define arginfo_opencreport_expr_get_profile NULL
+#define arginfo_opencreport_expr_get_memo_stats NULL
 
 #endif
 
@@ -790,6 +881,8 @@ static const zend_function_entry opencreport_expr_class_methods[] = {
 	PHP_ME(opencreport_expr, set_nth_result_double, arginfo_opencreport_expr_set_nth_result_double, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
 	PHP_ME(opencreport_expr, set_iterative_start_value, arginfo_opencreport_expr_set_iterative_start_value, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
 	PHP_ME(opencreport_expr, set_delayed, arginfo_opencreport_expr_set_delayed, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
+	PHP_ME(opencreport_expr, get_profile, arginfo_opencreport_expr_get_profile, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
+	PHP_ME(opencreport_expr, get_memo_stats, arginfo_opencreport_expr_get_memo_stats, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
 	PHP_FE_END
 };
 
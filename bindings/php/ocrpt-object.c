@@ -818,7 +818,7 @@ PHP_METHOD(opencreport, part_get_first) {
 PHP_METHOD(opencreport, function_add) {
 	zval *object = getThis();
 	php_opencreport_object *oo = Z_OPENCREPORT_P(object);
-	zend_bool commutative, associative, left_associative, dont_optimize;
+	zend_bool commutative, associative, left_associative, dont_optimize, pure = false;
 
 	if (!oo->o) {
 		zend_throw_error(NULL, "OpenCReport object was freed");
@@ -830,7 +830,7 @@ PHP_METHOD(opencreport, function_add) {
 	zend_string *zend_func_name;
 	zend_long n_ops;
 
-	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 7, 7)
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 7, 8)
 		Z_PARAM_STR(expr_func_name);
 		Z_PARAM_STR(zend_func_name);
 		Z_PARAM_LONG(n_ops);
@@ -838,19 +838,24 @@ PHP_METHOD(opencreport, function_add) {
 		Z_PARAM_BOOL(associative);
 		Z_PARAM_BOOL(left_associative);
 		Z_PARAM_BOOL(dont_optimize);
+		Z_PARAM_OPTIONAL;
+		Z_PARAM_BOOL(pure);
 	ZEND_PARSE_PARAMETERS_END();
 #else
 	char *expr_func_name, *zend_func_name;
 	int expr_func_name_len, zend_func_name_len;
 	long n_ops;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sslbbbb", &expr_func_name, &expr_func_name_len, &zend_func_name, &zend_func_name_len, &n_ops, &commutative, &associative, &left_associative, &dont_optimize) == FAILURE)
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "sslbbbb|b", &expr_func_name, &expr_func_name_len, &zend_func_name, &zend_func_name_len, &n_ops, &commutative, &associative, &left_associative, &dont_optimize, &pure) == FAILURE)
 		return;
 #endif
 
 	ocrpt_string *ofunc = ocrpt_mem_string_new_with_len(ZSTR_VAL(zend_func_name), ZSTR_LEN(zend_func_name));
 	bool ret = ocrpt_function_add(oo->o, ZSTR_VAL(expr_func_name), opencreport_default_function, ofunc, n_ops, commutative, associative, left_associative, dont_optimize);
 
+	if (ret && pure)
+		ret = ocrpt_function_set_pure(oo->o, ZSTR_VAL(expr_func_name), true);
+
 	RETURN_BOOL(ret);
 }
 
@@ -1527,6 +1532,95 @@ PHP_METHOD(opencreport, get_follower_match_single_direct) {
 	RETURN_BOOL(ocrpt_get_follower_match_single_direct(oo->o));
 }
 
+PHP_METHOD(opencreport, set_profiling) {
+	zval *object = getThis();
+	php_opencreport_object *oo = Z_OPENCREPORT_P(object);
+	zend_bool value = false;
+
+#if PHP_VERSION_ID >= 70000
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_BOOL(value);
+	ZEND_PARSE_PARAMETERS_END();
+#else
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "b", &value) == FAILURE)
+		return;
+#endif
+
+	RETURN_BOOL(ocrpt_set_profiling(oo->o, value));
+}
+
+PHP_METHOD(opencreport, get_profiling) {
+	zval *object = getThis();
+	php_opencreport_object *oo = Z_OPENCREPORT_P(object);
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	RETURN_BOOL(ocrpt_get_profiling(oo->o));
+}
+
+PHP_METHOD(opencreport, function_get_profile) {
+	zval *object = getThis();
+	php_opencreport_object *oo = Z_OPENCREPORT_P(object);
+#if PHP_VERSION_ID >= 70000
+	zend_string *fname;
+
+	ZEND_PARSE_PARAMETERS_START_EX(ZEND_PARSE_PARAMS_THROW, 1, 1)
+		Z_PARAM_STR(fname);
+	ZEND_PARSE_PARAMETERS_END();
+#else
+	char *fname;
+	int fname_len;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s", &fname, &fname_len) == FAILURE)
+		return;
+#endif
+
+	uint64_t calls, total_ns;
+
+	if (!ocrpt_function_get_profile(oo->o, ZSTR_VAL(fname), &calls, &total_ns))
+		RETURN_NULL();
+
+	array_init(return_value);
+
+#if PHP_VERSION_ID >= 70000
+	zval tmp;
+
+	ZVAL_LONG(&tmp, calls);
+	zend_hash_str_add_new(Z_ARRVAL_P(return_value), "calls", 5, &tmp);
+
+	ZVAL_LONG(&tmp, total_ns);
+	zend_hash_str_add_new(Z_ARRVAL_P(return_value), "total_ns", 8, &tmp);
+#else
+	zval *tmp;
+
+	ALLOC_INIT_ZVAL(tmp);
+	ZVAL_LONG(tmp, calls);
+	zend_hash_add(Z_ARRVAL_P(return_value), "calls", sizeof("calls"), &tmp, sizeof(zval*), NULL);
+
+	ALLOC_INIT_ZVAL(tmp);
+	ZVAL_LONG(tmp, total_ns);
+	zend_hash_add(Z_ARRVAL_P(return_value), "total_ns", sizeof("total_ns"), &tmp, sizeof(zval*), NULL);
+#endif
+}
+
+PHP_METHOD(opencreport, profile_print) {
+	zval *object = getThis();
+	php_opencreport_object *oo = Z_OPENCREPORT_P(object);
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	ocrpt_profile_print(oo->o);
+}
+
+PHP_METHOD(opencreport, profile_reset) {
+	zval *object = getThis();
+	php_opencreport_object *oo = Z_OPENCREPORT_P(object);
+
+	ZEND_PARSE_PARAMETERS_NONE();
+
+	ocrpt_profile_reset(oo->o);
+}
+
 #if PHP_VERSION_ID >= 70000
 
 ZEND_BEGIN_ARG_INFO_EX(arginfo_opencreport___construct, 0, 0, 0)
@@ -1628,6 +1722,7 @@ ZEND_ARG_TYPE_INFO(0, commutative, _IS_BOOL, 0)
 ZEND_ARG_TYPE_INFO(0, associative, _IS_BOOL, 0)
 ZEND_ARG_TYPE_INFO(0, left_associative, _IS_BOOL, 0)
 ZEND_ARG_TYPE_INFO(0, dont_optimize, _IS_BOOL, 0)
+ZEND_ARG_TYPE_INFO(0, pure, _IS_BOOL, 0)
 ZEND_END_ARG_INFO()
 
 OCRPT_BEGIN_ARG_WITH_RETURN_OBJ_INFO_EX(arginfo_opencreport_env_get, 0, 1, OpenCReport\\Result, 1)
@@ -1699,6 +1794,23 @@ ZEND_END_ARG_INFO()
 OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_get_follower_match_single_direct, 0, 0, _IS_BOOL, 0)
 ZEND_END_ARG_INFO()
 
+OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_set_profiling, 0, 1, _IS_BOOL, 0)
+ZEND_ARG_TYPE_INFO(0, value, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_get_profiling, 0, 0, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_function_get_profile, 0, 1, IS_ARRAY, 1)
+ZEND_ARG_TYPE_INFO(0, fname, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_profile_print, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
+
+OCRPT_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_opencreport_profile_reset, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
+
 #else
 
 #define arginfo_opencreport___construct NULL
@@ -1745,6 +1857,11 @@ ZEND_END_ARG_INFO()
 #define arginfo_opencreport_get_follower_match_single NULL
 #define arginfo_opencreport_set_follower_match_single_direct NULL
 #define arginfo_opencreport_get_follower_match_single_direct NULL
+#define arginfo_opencreport_set_profiling NULL
+#define arginfo_opencreport_get_profiling NULL
+#define arginfo_opencreport_function_get_profile NULL
+#define arginfo_opencreport_profile_print NULL
+#define arginfo_opencreport_profile_reset NULL
 
 #endif
 
@@ -1815,6 +1932,11 @@ static const zend_function_entry opencreport_class_methods[] = {
 	PHP_ME(opencreport, get_follower_match_single, arginfo_opencreport_get_follower_match_single, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
 	PHP_ME(opencreport, set_follower_match_single_direct, arginfo_opencreport_set_follower_match_single_direct, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
 	PHP_ME(opencreport, get_follower_match_single_direct, arginfo_opencreport_get_follower_match_single_direct, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
+	PHP_ME(opencreport, set_profiling, arginfo_opencreport_set_profiling, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
+	PHP_ME(opencreport, get_profiling, arginfo_opencreport_get_profiling, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
+	PHP_ME(opencreport, function_get_profile, arginfo_opencreport_function_get_profile, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
+	PHP_ME(opencreport, profile_print, arginfo_opencreport_profile_print, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
+	PHP_ME(opencreport, profile_reset, arginfo_opencreport_profile_reset, ZEND_ACC_PUBLIC | ZEND_ACC_FINAL)
 	PHP_FE_END
 };
 
@@ -61,6 +61,8 @@ struct ocrpt_result {
 	bool time_valid:1;
 	bool interval:1;
 	bool isnull:1;
+	/* Allocated from the result pool of its opencreport */
+	bool pooled:1;
 	/*
 	 * Date +/- month carry bits for handling invalid day-of-month.
 	 * E.g. yyyy-01-31 + 1 month -> yyyy-02-31 which is an invalid date.
@@ -429,6 +431,12 @@ char *ocrpt_query_get_name(const ocrpt_query *query);
 ocrpt_datasource *ocrpt_query_get_source(const ocrpt_query *query);
 void ocrpt_query_set_private(ocrpt_query *query, const void *priv);
 void *ocrpt_query_get_private(const ocrpt_query *query);
+/*
+ * Signal that the rows of the query cannot be read completely,
+ * e.g. because of a syntax error in the input file.
+ * Navigating the query fails after it.
+ */
+void ocrpt_query_set_error(ocrpt_query *query);
 /*
  * Query whether the datasource is data based
  */
@@ -493,8 +501,15 @@ bool ocrpt_query_refresh(opencreport *o);
 void ocrpt_query_navigate_start(ocrpt_query *q);
 /*
  * Move to next row in the query resultset
+ * It returns false at the end of the rows or
+ * if reading the rows failed, see below.
  */
 bool ocrpt_query_navigate_next(ocrpt_query *q);
+/*
+ * Whether reading the rows of the query
+ * or any of its followers failed
+ */
+bool ocrpt_query_get_error(ocrpt_query *q);
 /*
  * Move to previous row in the query row cache
  */
@@ -537,6 +552,26 @@ ocrpt_expr *ocrpt_expr_parse(opencreport *o, const char *expr_string, char **err
  * for a report
  */
 ocrpt_expr *ocrpt_report_expr_parse(ocrpt_report *r, const char *expr_string, char **err);
+/*
+ * Set the maximum number of entries in the process-wide
+ * parsed expression cache. 0 disables the cache.
+ * Shrinking it below the current number of entries
+ * empties the cache.
+ */
+void ocrpt_expr_parse_cache_set_size(uint32_t max_entries);
+/*
+ * Get the maximum number of entries in the parsed expression cache
+ */
+uint32_t ocrpt_expr_parse_cache_get_size(void);
+/*
+ * Get the parsed expression cache statistics.
+ * Any of the pointers may be NULL.
+ */
+void ocrpt_expr_parse_cache_get_stats(uint64_t *hits, uint64_t *misses, uint32_t *entries);
+/*
+ * Empty the parsed expression cache and reset its statistics
+ */
+void ocrpt_expr_parse_cache_clear(void);
 /*
  * Free an expression parse tree
  */
@@ -583,6 +618,45 @@ ocrpt_result *ocrpt_expr_eval(ocrpt_expr *e);
  * The returned ocrpt_result MUST NOT be freed with ocrpt_result_free().
  */
 ocrpt_result *ocrpt_expr_get_result(ocrpt_expr *e);
+/*
+ * Enable or disable profiling expression evaluation.
+ * While enabled, the number of evaluations and the time spent
+ * are collected for every toplevel expression and for every
+ * user defined function. It returns false and does nothing
+ * if the library was built without profiling support.
+ */
+bool ocrpt_set_profiling(opencreport *o, bool enabled);
+bool ocrpt_get_profiling(opencreport *o);
+/*
+ * Get the profiling data of an expression. Times are in nanoseconds.
+ * The self time excludes the time spent evaluating other toplevel
+ * expressions, e.g. the expressions of referenced variables.
+ * Any of the pointers may be NULL. It returns false if the expression
+ * was not evaluated while profiling was enabled.
+ */
+bool ocrpt_expr_get_profile(ocrpt_expr *e, uint64_t *calls, uint64_t *total_ns, uint64_t *self_ns);
+/*
+ * Get the profiling data of a user defined function.
+ * The time is in nanoseconds. Any of the pointers may be NULL.
+ * It returns false if there's no such user defined function.
+ */
+bool ocrpt_function_get_profile(opencreport *o, const char *fname, uint64_t *calls, uint64_t *total_ns);
+/*
+ * Get the number of memoized pure function calls in the expression
+ * that reused a previous result (hits) and that called the function
+ * (misses). Any of the pointers may be NULL. It returns false if
+ * no pure function was called with operands in the expression.
+ */
+bool ocrpt_expr_get_memo_stats(ocrpt_expr *e, uint64_t *hits, uint64_t *misses);
+/*
+ * Print the profiling data of expressions sorted by the total time,
+ * followed by the profiling data of user defined functions.
+ */
+void ocrpt_profile_print(opencreport *o);
+/*
+ * Reset the profiling data of expressions and user defined functions
+ */
+void ocrpt_profile_reset(opencreport *o);
 /*
  * Print an expression on stdout. Good for unit testing.
  */
@@ -816,6 +890,16 @@ bool ocrpt_function_add(opencreport *o, const char *fname,
 						ocrpt_function_call func, void *user_data,
 						int32_t n_ops, bool commutative, bool associative,
 						bool left_associative, bool dont_optimize);
+/*
+ * Declare a custom function pure or volatile.
+ * The result of a pure function only depends on its operands.
+ * Its calls may be shared between expressions and are memoized:
+ * if it's called with the same operand values again, the previous
+ * result is reused. Other functions are called every time.
+ * It must be called before parsing expressions using the function.
+ * It returns false if there's no such user defined function.
+ */
+bool ocrpt_function_set_pure(opencreport *o, const char *fname, bool pure);
 /*
  * Find a named function
  */
@@ -1460,6 +1544,8 @@ ocrpt_string *ocrpt_mem_string_new_vnprintf(size_t len, const char *format, va_l
 ocrpt_string *ocrpt_mem_string_new_printf(const char *format, ...) __attribute__ ((format(printf, 1, 2)));
 ocrpt_string *ocrpt_mem_string_resize(ocrpt_string *string, size_t len);
 char *ocrpt_mem_string_free(ocrpt_string *string, bool free_str);
+ocrpt_string *ocrpt_mem_string_view(ocrpt_string *string, const char *str, size_t len);
+bool ocrpt_mem_string_is_view(const ocrpt_string *string);
 void ocrpt_mem_string_append_len(ocrpt_string *string, const char *str, const size_t len);
 void ocrpt_mem_string_append_len_binary(ocrpt_string *string, const char *str, const size_t len);
 void ocrpt_mem_string_append(ocrpt_string *string, const char *str);
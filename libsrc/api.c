@@ -124,6 +124,7 @@ DLL_EXPORT_SYM opencreport *ocrpt_init(void) {
 	o->paper = system_paper;
 	o->prec = OCRPT_MPFR_PRECISION_BITS;
 	o->rndmode = MPFR_RNDN;
+	mpfr_init2(o->format_tmp, o->prec);
 	gmp_randinit_default(o->randstate);
 	gmp_randseed_ui(o->randstate, seed);
 	o->c_locale = o->locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
@@ -205,6 +206,8 @@ DLL_EXPORT_SYM void ocrpt_free(opencreport *o) {
 	}
 	ocrpt_mem_free(o->functions);
 
+	ocrpt_eval_cache_free(o->eval_cache);
+
 	/*
 	 * ocrpt_free_query() or ocrpt_free_query0()
 	 * must not be called from a List iterator on
@@ -277,6 +280,10 @@ DLL_EXPORT_SYM void ocrpt_free(opencreport *o) {
 	ocrpt_mem_free(o->xlate_domain_s);
 	ocrpt_mem_free(o->xlate_dir_s);
 
+	mpfr_clear(o->format_tmp);
+
+	ocrpt_result_pool_free(o);
+
 	ocrpt_mem_free(o);
 }
 
@@ -304,6 +311,8 @@ DLL_EXPORT_SYM void ocrpt_set_numeric_precision_bits(opencreport *o, const char
 			o->prec = OCRPT_MPFR_PRECISION_BITS;
 	} else
 		o->prec = OCRPT_MPFR_PRECISION_BITS;
+
+	o->memo_epoch++;
 }
 
 DLL_EXPORT_SYM mpfr_prec_t ocrpt_get_numeric_precision_bits(opencreport *o) {
@@ -829,6 +838,11 @@ static void ocrpt_execute_evaluate_global_params(opencreport *o) {
 		ocrpt_expr_free(domain_expr);
 		ocrpt_expr_free(dir_expr);
 	}
+
+	/* The settings above may change the results of pure functions */
+	o->memo_epoch++;
+	/* Environment variables may have changed since the previous run */
+	o->resolve_epoch++;
 }
 
 static void ocrpt_execute_parts_evaluate_global_params(opencreport *o, ocrpt_part *p) {
@@ -1638,6 +1652,11 @@ DLL_EXPORT_SYM bool ocrpt_execute(opencreport *o) {
 	if (o->output_functions.finalize)
 		o->output_functions.finalize(o);
 
+	/* The output is incomplete if reading a query failed */
+	for (ocrpt_list *ql = o->queries; ql; ql = ql->next)
+		if (((ocrpt_query *)ql->data)->error)
+			return false;
+
 	return true;
 }
 
@@ -2098,6 +2117,7 @@ DLL_EXPORT_SYM void ocrpt_bindtextdomain(opencreport *o, const char *domainname,
 	bindtextdomain(domainname, dirname);
 	bind_textdomain_codeset(domainname, "UTF-8");
 	o->textdomain = ocrpt_mem_strdup(domainname);
+	o->memo_epoch++;
 }
 
 DLL_EXPORT_SYM void ocrpt_bindtextdomain_from_expr(opencreport *o, const char *domainname, const char *dirname) {
@@ -2120,6 +2140,8 @@ DLL_EXPORT_SYM void ocrpt_set_locale(opencreport *o, const char *locale) {
 	o->locale = newlocale(LC_ALL_MASK, locale, (locale_t)0);
 	if (o->locale == (locale_t)0)
 		o->locale = o->c_locale;
+
+	o->memo_epoch++;
 }
 
 DLL_EXPORT_SYM void ocrpt_set_locale_from_expr(opencreport *o, const char *expr_string) {
@@ -2223,5 +2245,7 @@ __attribute__((destructor))
 static void uninitialize_ocrpt(void) {
 	free(papersizes);
 
+	ocrpt_expr_parse_cache_clear();
+
 	xmlCleanupParser();
 }
@@ -11,12 +11,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <dlfcn.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
 
-#include <csv.h>
 #include <yajl/yajl_parse.h>
 #include <yajl/yajl_gen.h>
 #include <libxml/parser.h>
@@ -28,10 +29,14 @@
 #include "listutil.h"
 #include "memutil.h"
 #include "datasource.h"
+#include "scanutil.h"
+#include "colstore.h"
 
 struct ocrpt_array_results {
+	/* With a columnar store, data only holds the column names */
 	const char **data;
 	const int32_t *types; /* for enum ocrpt_result_type elements */
+	ocrpt_colstore *store;
 	ocrpt_query_result *result;
 	ocrpt_string *converted;
 	int32_t rows;
@@ -183,6 +188,8 @@ static void ocrpt_array_rewind(ocrpt_query *query) {
 	result->current_row = 0;
 	result->atstart = true;
 	result->isdone = false;
+
+	ocrpt_colstore_reset_cache(result->store);
 }
 
 static bool ocrpt_array_populate_result(ocrpt_query *query) {
@@ -195,6 +202,11 @@ static bool ocrpt_array_populate_result(ocrpt_query *query) {
 		return !result->isdone;
 	}
 
+	if (result->store) {
+		ocrpt_colstore_populate_result(query, result->store, result->current_row - 1, ocrpt_datasource_get_private(source));
+		return true;
+	}
+
 	for (i = 0; i < result->cols; i++) {
 		int32_t dataidx = result->current_row * result->cols + i;
 		const char *str = result->data[dataidx];
@@ -320,11 +332,11 @@ static void ocrpt_file_free(ocrpt_query *query) {
 
 	struct ocrpt_array_results *result = ocrpt_query_get_private(query);
 	int32_t i;
-	int32_t max = (result->rows + 1) * result->cols;
 
-	for (i = 0; i < max; i++)
+	for (i = 0; i < result->cols; i++)
 		ocrpt_mem_free(result->data[i]);
 
+	ocrpt_colstore_free(result->store);
 	ocrpt_mem_free(result->types);
 	ocrpt_mem_free(result->data);
 	ocrpt_mem_free(result);
@@ -346,11 +358,15 @@ struct ocrpt_file_query {
 	ocrpt_list *col_last;
 	const char **names;
 	const char **fields;
+	/* The XML input stores the rows here while parsing */
+	ocrpt_colstore *store;
 	int32_t *types;
 	int32_t rows;
 	int32_t cols;
 	int32_t depth;
 	int32_t current_col;
+	/* Number of columns in the first XML row */
+	int32_t firstrow_cols;
 	bool firstrow:1;
 	bool firstcol:1;
 	bool inheader:1;
@@ -363,44 +379,6 @@ struct ocrpt_file_query {
 };
 typedef struct ocrpt_file_query ocrpt_file_query;
 
-static void csv_parser_field_cb(void *field_ptr, size_t field_sz, void *user_data) {
-	struct ocrpt_file_query *fq = user_data;
-	char *field = NULL;
-
-	if (!fq->firstrow && (ocrpt_list_length(fq->collist) >= fq->cols))
-		return;
-
-	if (field_ptr) {
-		field = ocrpt_mem_malloc(field_sz + 1);
-		if (field) {
-			char *end = stpncpy(field, field_ptr, field_sz);
-			*end = 0;
-		}
-	}
-
-	if (fq->firstcol) {
-		fq->firstcol = false;
-		fq->collist = fq->col_last = ocrpt_makelist1(field);
-		fq->rowlist = ocrpt_list_end_append(fq->rowlist, &fq->row_last, fq->collist);
-	} else {
-		fq->collist = ocrpt_list_end_append(fq->collist, &fq->col_last, field);
-	}
-
-	if (fq->firstrow)
-		fq->cols++;
-}
-
-static void csv_parser_eol_cb(int eolchar UNUSED, void *user_data) {
-	struct ocrpt_file_query *fq = user_data;
-
-	fq->rows++;
-	if (fq->firstrow)
-		fq->firstrow = false;
-	fq->firstcol = true;
-	fq->collist = NULL;
-	fq->col_last = NULL;
-}
-
 static void ocrpt_file_query_free_rows(const void *ptr) {
 	ocrpt_list_free_deep((ocrpt_list *)ptr, ocrpt_mem_free);
 }
@@ -418,114 +396,688 @@ static void ocrpt_file_query_free(ocrpt_file_query *fq, bool in_error) {
 		ocrpt_list_free_deep(fq->rowlist, (ocrpt_mem_free_t)ocrpt_list_free);
 }
 
-static ocrpt_query *ocrpt_csv_query_add(ocrpt_datasource *source,
-										const char *name, const char *filename,
-										const int32_t *types, int32_t types_cols) {
-	if (!source || !name || !filename)
-		return NULL;
+/*
+ * CSV files are memory mapped and only the offsets of the
+ * rows are kept. The current row is parsed from the mapping
+ * when it's needed, with the same rules libcsv applies in
+ * strict mode:
+ * - leading and trailing spaces and tabs of unquoted fields
+ *   are ignored
+ * - empty unquoted fields are NULL, "" is an empty string
+ * - a double quote inside an unquoted field, or anything
+ *   but spaces after the closing quote of a quoted field
+ *   is an error, as is an unterminated quoted field
+ * - empty lines are skipped
+ */
+struct ocrpt_csv_cell {
+	size_t offset;
+	size_t len;
+	bool isnull;
+};
 
-	char *real_filename = ocrpt_find_file(source->o, filename);
-	if (!real_filename)
-		return NULL;
+struct ocrpt_csv_results {
+	/* The array query state, data holds the column names */
+	struct ocrpt_array_results array;
+	const char *map;
+	size_t size;
+	/* Offset of every data row in the mapping */
+	size_t *rowoffs;
+	/* Unquoted and NUL terminated cells of the last parsed row */
+	ocrpt_string *rowbuf;
+	struct ocrpt_csv_cell *cells;
+	int32_t parsed_row;
+	bool mapped:1;
+};
 
-	struct stat st;
-	struct csv_parser csv;
-	char *buf;
-	const char **array;
-	ocrpt_query *retval;
-	ocrpt_file_query fq = {};
-	ocrpt_list *rowptr;
-	size_t parser_retval;
-	int32_t fd, row;
+/* Parallel indexing doesn't split the file into smaller chunks */
+#define OCRPT_CSV_MIN_CHUNK (64 * 1024)
 
-	if (stat(real_filename, &st) != 0) {
-		/* This cannot happen due to ocrpt_find_file() above. */
-		return NULL;
+struct ocrpt_csv_conn_private {
+	iconv_t conv;
+	int32_t threads;
+};
+
+static const ocrpt_input_connect_parameter ocrpt_csv_connect_method1[] = {
+	{ .param_name = "threads", { .optional = true } },
+	{ .param_name = NULL }
+};
+
+static const ocrpt_input_connect_parameter *ocrpt_csv_connect_methods[] = {
+	ocrpt_csv_connect_method1,
+	NULL
+};
+
+static bool ocrpt_csv_connect(ocrpt_datasource *ds, const ocrpt_input_connect_parameter *conn_params) {
+	struct ocrpt_csv_conn_private *priv = ocrpt_mem_malloc(sizeof(struct ocrpt_csv_conn_private));
+
+	if (!priv)
+		return false;
+
+	priv->conv = (iconv_t)-1;
+	priv->threads = 1;
+
+	for (int32_t i = 0; conn_params && conn_params[i].param_name; i++) {
+		if (strcasecmp(conn_params[i].param_name, "threads") == 0 && conn_params[i].param_value) {
+			int32_t threads = atoi(conn_params[i].param_value);
+
+			if (threads > 1)
+				priv->threads = threads;
+		}
 	}
 
-	fd = open(real_filename, O_RDONLY);
+	ocrpt_datasource_set_private(ds, priv);
+	return true;
+}
+
+static bool ocrpt_csv_set_encoding(ocrpt_datasource *ds, const char *encoding) {
+	struct ocrpt_csv_conn_private *priv = ocrpt_datasource_get_private(ds);
 
-	ocrpt_mem_free(real_filename);
+	if (priv->conv != (iconv_t)-1)
+		iconv_close(priv->conv);
+
+	priv->conv = iconv_open("UTF-8", encoding);
+
+	return (priv->conv != (iconv_t)-1);
+}
+
+static void ocrpt_csv_close(const ocrpt_datasource *ds) {
+	struct ocrpt_csv_conn_private *priv = ocrpt_datasource_get_private((ocrpt_datasource *)ds);
 
+	if (priv->conv != (iconv_t)-1)
+		iconv_close(priv->conv);
+
+	ocrpt_mem_free(priv);
+}
+
+static inline bool ocrpt_csv_isblank(char c) {
+	return c == ' ' || c == '\t';
+}
+
+static inline bool ocrpt_csv_iseol(char c) {
+	return c == '\r' || c == '\n';
+}
+
+static bool ocrpt_csv_store_cell(struct ocrpt_csv_results *csv, int32_t col, const char *str, size_t len, bool isnull, bool unescape) {
+	struct ocrpt_csv_cell *cell = &csv->cells[col];
+	ocrpt_string *rowbuf = csv->rowbuf;
+	char *dst;
+
+	if (rowbuf->allocated_len < rowbuf->len + len + 1 && !ocrpt_mem_string_resize(rowbuf, 2 * (rowbuf->len + len + 1)))
+		return false;
+
+	dst = rowbuf->str + rowbuf->len;
+	memcpy(dst, str, len);
+
+	/* "" stands for a double quote in quoted fields */
+	if (unescape) {
+		size_t i, n;
+
+		for (i = 0, n = 0; i < len; i++) {
+			dst[n++] = dst[i];
+			if (dst[i] == '"')
+				i++;
+		}
+		len = n;
+	}
+	dst[len] = 0;
+
+	cell->offset = rowbuf->len;
+	cell->len = len;
+	cell->isnull = isnull;
+	rowbuf->len += len + 1;
+
+	return true;
+}
+
+/*
+ * Parse the record starting at *pos and move *pos after it.
+ * If cells is true, the fields are stored as the cells of the
+ * current row, otherwise they are only counted into *fields.
+ *
+ * Returns 1 for a record, 0 at the end of the file
+ * and -1 for a parse error.
+ */
+static int32_t ocrpt_csv_parse_record(struct ocrpt_csv_results *csv, size_t *pos, bool cells, int32_t *fields) {
+	const char *map = csv->map;
+	size_t size = csv->size, i = *pos;
+	int32_t field = 0;
+
+	while (i < size && (ocrpt_csv_isblank(map[i]) || ocrpt_csv_iseol(map[i])))
+		i++;
+
+	if (i == size) {
+		*pos = i;
+		return 0;
+	}
+
+	/*
+	 * Without quotes, only the end of the line matters
+	 * when the record is merely skipped over.
+	 */
+	if (!cells && !fields) {
+		size_t end = i + ocrpt_scan_any4(map + i, size - i, '"', '\r', '\n', '\n');
+
+		if (end == size || map[end] != '"') {
+			*pos = (end < size ? end + 1 : end);
+			return 1;
+		}
+	}
+
+	if (cells)
+		csv->rowbuf->len = 0;
+
+	for (;;) {
+		size_t start, len;
+
+		while (i < size && ocrpt_csv_isblank(map[i]))
+			i++;
+
+		if (i < size && map[i] == '"') {
+			bool escaped = false;
+
+			start = ++i;
+			for (;;) {
+				const char *quote = memchr(map + i, '"', size - i);
+
+				if (!quote)
+					return -1;
+				i = quote - map;
+				if (i + 1 < size && map[i + 1] == '"') {
+					escaped = true;
+					i += 2;
+					continue;
+				}
+				break;
+			}
+			len = i - start;
+			i++;
+
+			while (i < size && ocrpt_csv_isblank(map[i]))
+				i++;
+			if (i < size && map[i] != ',' && !ocrpt_csv_iseol(map[i]))
+				return -1;
+
+			if (cells && field < csv->array.cols && !ocrpt_csv_store_cell(csv, field, map + start, len, false, escaped))
+				return -1;
+		} else {
+			start = i;
+			i += ocrpt_scan_any4(map + i, size - i, ',', '"', '\r', '\n');
+			if (i < size && map[i] == '"')
+				return -1;
+
+			len = i - start;
+			while (len && ocrpt_csv_isblank(map[start + len - 1]))
+				len--;
+
+			if (cells && field < csv->array.cols && !ocrpt_csv_store_cell(csv, field, map + start, len, len == 0, false))
+				return -1;
+		}
+
+		field++;
+
+		if (i < size && map[i] == ',') {
+			i++;
+			continue;
+		}
+
+		/* End of line or end of file */
+		if (i < size)
+			i++;
+		break;
+	}
+
+	if (cells) {
+		for (; field < csv->array.cols; field++) {
+			csv->cells[field].offset = 0;
+			csv->cells[field].len = 0;
+			csv->cells[field].isnull = true;
+		}
+	}
+
+	if (fields)
+		*fields = field;
+
+	*pos = i;
+	return 1;
+}
+
+static bool ocrpt_csv_populate_result(ocrpt_query *query) {
+	struct ocrpt_csv_conn_private *priv = ocrpt_datasource_get_private(ocrpt_query_get_source(query));
+	struct ocrpt_csv_results *csv = ocrpt_query_get_private(query);
+	struct ocrpt_array_results *result = &csv->array;
+	int32_t i;
+
+	if (result->atstart || result->isdone) {
+		ocrpt_query_result_set_values_null(query);
+		return !result->isdone;
+	}
+
+	/* The row was checked when the file was indexed */
+	if (csv->parsed_row != result->current_row) {
+		size_t pos = csv->rowoffs[result->current_row - 1];
+
+		if (ocrpt_csv_parse_record(csv, &pos, true, NULL) <= 0) {
+			ocrpt_query_result_set_values_null(query);
+			return true;
+		}
+		csv->parsed_row = result->current_row;
+	}
+
+	for (i = 0; i < result->cols; i++) {
+		struct ocrpt_csv_cell *cell = &csv->cells[i];
+
+		ocrpt_query_result_set_value(query, i, cell->isnull, priv->conv, cell->isnull ? NULL : csv->rowbuf->str + cell->offset, cell->len);
+	}
+
+	return true;
+}
+
+static bool ocrpt_csv_next(ocrpt_query *query) {
+	struct ocrpt_csv_results *csv = ocrpt_query_get_private(query);
+
+	if (csv == NULL)
+		return false;
+
+	csv->array.atstart = false;
+	csv->array.current_row++;
+	csv->array.isdone = (csv->array.current_row > csv->array.rows);
+
+	return ocrpt_csv_populate_result(query);
+}
+
+static void ocrpt_csv_free_private(struct ocrpt_csv_results *csv) {
+	if (csv->array.data) {
+		for (int32_t i = 0; i < csv->array.cols; i++)
+			ocrpt_mem_free(csv->array.data[i]);
+		ocrpt_mem_free(csv->array.data);
+	}
+
+	if (csv->map) {
+		if (csv->mapped)
+			munmap((void *)csv->map, csv->size);
+		else
+			ocrpt_mem_free(csv->map);
+	}
+
+	ocrpt_mem_string_free(csv->rowbuf, true);
+	ocrpt_mem_free(csv->cells);
+	ocrpt_mem_free(csv->rowoffs);
+	ocrpt_mem_free(csv->array.types);
+	ocrpt_mem_free(csv);
+}
+
+static void ocrpt_csv_free(ocrpt_query *query) {
+	if (!query)
+		return;
+
+	ocrpt_csv_free_private(ocrpt_query_get_private(query));
+	ocrpt_query_set_private(query, NULL);
+}
+
+static bool ocrpt_csv_map_file(struct ocrpt_csv_results *csv, const char *filename) {
+	struct stat st;
+	int32_t fd;
+	void *map;
+	char *buf;
+
+	fd = open(filename, O_RDONLY);
 	if (fd < 0)
-		return NULL;
+		return false;
 
-	buf = ocrpt_mem_malloc(st.st_size);
-	if (!buf) {
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
 		close(fd);
-		return NULL;
+		return false;
 	}
 
-	if (read(fd, buf, st.st_size) != st.st_size) {
+	csv->size = st.st_size;
+
+	map = mmap(NULL, csv->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map != MAP_FAILED) {
+		madvise(map, csv->size, MADV_SEQUENTIAL);
+		csv->map = map;
+		csv->mapped = true;
 		close(fd);
+		return true;
+	}
+
+	/* Read the file if it can't be mapped */
+	buf = ocrpt_mem_malloc(csv->size);
+
+	if (buf && read(fd, buf, csv->size) != (ssize_t)csv->size) {
 		ocrpt_mem_free(buf);
-		return NULL;
+		buf = NULL;
 	}
 
 	close(fd);
 
-	if (csv_init(&csv, CSV_STRICT | CSV_REPALL_NL | CSV_STRICT_FINI | CSV_APPEND_NULL | CSV_EMPTY_IS_NULL) != 0) {
-		ocrpt_mem_free(buf);
-		return NULL;
+	csv->map = buf;
+	return buf != NULL;
+}
+
+/* Skip empty lines and the blanks before the next record */
+static size_t ocrpt_csv_skip_blanks(struct ocrpt_csv_results *csv, size_t pos) {
+	while (pos < csv->size && (ocrpt_csv_isblank(csv->map[pos]) || ocrpt_csv_iseol(csv->map[pos])))
+		pos++;
+
+	return pos;
+}
+
+/*
+ * A part of the file indexed either serially or by a worker
+ * thread. The chunk indexes the records starting at or
+ * after "first" and before "end".
+ */
+struct ocrpt_csv_chunk {
+	struct ocrpt_csv_results *csv;
+	/* Worker threads must not call ocrpt_mem_realloc() */
+	ocrpt_mem_realloc_t realloc_fn;
+	size_t *rowoffs;
+	size_t begin;
+	size_t end;
+	size_t first;
+	/* The start of the record after the last indexed one */
+	size_t next;
+	pthread_t thread;
+	int32_t rows;
+	int32_t allocated;
+	bool inquote:1;
+	bool odd_quotes:1;
+	bool started:1;
+	bool ok:1;
+};
+
+/* Index the records of the chunk, the offset of a row is where its first field starts */
+static void *ocrpt_csv_index_chunk(void *arg) {
+	struct ocrpt_csv_chunk *chunk = arg;
+	size_t pos = chunk->first;
+
+	chunk->ok = false;
+
+	for (;;) {
+		pos = ocrpt_csv_skip_blanks(chunk->csv, pos);
+		if (pos >= chunk->end)
+			break;
+
+		if (chunk->rows == chunk->allocated) {
+			int32_t allocated = (chunk->allocated ? 2 * chunk->allocated : 1024);
+			size_t *rowoffs = chunk->realloc_fn(chunk->rowoffs, allocated * sizeof(size_t));
+
+			if (!rowoffs)
+				return NULL;
+			chunk->rowoffs = rowoffs;
+			chunk->allocated = allocated;
+		}
+
+		chunk->rowoffs[chunk->rows++] = pos;
+
+		if (ocrpt_csv_parse_record(chunk->csv, &pos, false, NULL) < 0)
+			return NULL;
 	}
 
-	csv_set_realloc_func(&csv, ocrpt_mem_realloc0);
-	csv_set_free_func(&csv, (ocrpt_mem_free_nconst_t)ocrpt_mem_free0);
+	chunk->next = pos;
+	chunk->ok = true;
+	return NULL;
+}
 
-	memset(&fq, 0, sizeof(ocrpt_file_query));
-	fq.firstrow = true;
-	fq.firstcol = true;
+static void *ocrpt_csv_count_quotes(void *arg) {
+	struct ocrpt_csv_chunk *chunk = arg;
+	const char *map = chunk->csv->map;
+	size_t pos = chunk->begin;
+	bool odd = false;
 
-	parser_retval = csv_parse(&csv, buf, st.st_size, csv_parser_field_cb, csv_parser_eol_cb, &fq);
-	if (parser_retval != st.st_size) {
-		ocrpt_mem_free(buf);
-		csv_free(&csv);
-		ocrpt_file_query_free(&fq, true);
-		return NULL;
+	while (pos < chunk->end) {
+		const char *quote = memchr(map + pos, '"', chunk->end - pos);
+
+		if (!quote)
+			break;
+		odd = !odd;
+		pos = quote - map + 1;
+	}
+
+	chunk->odd_quotes = odd;
+	return NULL;
+}
+
+/*
+ * Find the first record of a chunk. In a valid file, every double
+ * quote toggles being inside a quoted field, so the state at the
+ * beginning of the chunk is known from the number of quotes before
+ * it. The first record starts after the first line end outside
+ * quoted fields.
+ */
+static void *ocrpt_csv_sync_and_index_chunk(void *arg) {
+	struct ocrpt_csv_chunk *chunk = arg;
+	struct ocrpt_csv_results *csv = chunk->csv;
+	const char *map = csv->map;
+	size_t pos = chunk->begin;
+	bool inquote = chunk->inquote;
+
+	/* The first chunk starts at a known record boundary */
+	if (chunk->first == chunk->begin)
+		return ocrpt_csv_index_chunk(chunk);
+
+	chunk->first = csv->size;
+
+	if (!inquote && ocrpt_csv_iseol(map[pos - 1]))
+		chunk->first = ocrpt_csv_skip_blanks(csv, pos);
+	else {
+		while (pos < csv->size) {
+			pos += ocrpt_scan_any4(map + pos, csv->size - pos, '"', '\r', '\n', '\n');
+			if (pos == csv->size)
+				break;
+			if (map[pos] == '"')
+				inquote = !inquote;
+			else if (!inquote) {
+				chunk->first = ocrpt_csv_skip_blanks(csv, pos + 1);
+				break;
+			}
+			pos++;
+		}
 	}
 
-	csv_free(&csv);
+	return ocrpt_csv_index_chunk(chunk);
+}
 
-	ocrpt_mem_free(buf);
+static void ocrpt_csv_run_chunks(struct ocrpt_csv_chunk *chunks, int32_t nchunks, void *(*worker)(void *)) {
+	int32_t i;
 
-	array = ocrpt_mem_malloc(fq.rows * fq.cols * sizeof(char *));
-	if (!array) {
-		ocrpt_file_query_free(&fq, true);
+	/* Do the work in this thread if a thread can't be started */
+	for (i = 0; i < nchunks; i++) {
+		chunks[i].started = (pthread_create(&chunks[i].thread, NULL, worker, &chunks[i]) == 0);
+		if (!chunks[i].started)
+			worker(&chunks[i]);
+	}
+
+	for (i = 0; i < nchunks; i++)
+		if (chunks[i].started)
+			pthread_join(chunks[i].thread, NULL);
+}
+
+/*
+ * Index the file in parallel. The chunks are verified to follow
+ * each other exactly: the record after the last one of a chunk
+ * must be the first record of the next chunk. If anything fails
+ * (e.g. the file has an error that makes the quote counting
+ * wrong) the caller indexes the file serially which also
+ * reports the error the same way.
+ */
+static bool ocrpt_csv_index_parallel(struct ocrpt_csv_results *csv, size_t pos, int32_t threads) {
+	struct ocrpt_csv_chunk *chunks;
+	size_t chunk_size;
+	int32_t nchunks, rows, i;
+	bool ok = true, inquote = false;
+
+	if ((csv->size - pos) / threads < OCRPT_CSV_MIN_CHUNK)
+		threads = (csv->size - pos) / OCRPT_CSV_MIN_CHUNK;
+	if (threads < 2)
+		return false;
+
+	nchunks = threads;
+	chunk_size = (csv->size - pos) / nchunks;
+
+	chunks = ocrpt_mem_malloc(nchunks * sizeof(struct ocrpt_csv_chunk));
+	if (!chunks)
+		return false;
+
+	memset(chunks, 0, nchunks * sizeof(struct ocrpt_csv_chunk));
+
+	for (i = 0; i < nchunks; i++) {
+		chunks[i].csv = csv;
+		chunks[i].realloc_fn = realloc;
+		chunks[i].begin = pos + i * chunk_size;
+		chunks[i].end = (i == nchunks - 1 ? csv->size : pos + (i + 1) * chunk_size);
+	}
+
+	ocrpt_csv_run_chunks(chunks, nchunks, ocrpt_csv_count_quotes);
+
+	for (i = 0; i < nchunks; i++) {
+		chunks[i].inquote = inquote;
+		inquote ^= chunks[i].odd_quotes;
+	}
+
+	chunks[0].first = pos;
+	ocrpt_csv_run_chunks(chunks, nchunks, ocrpt_csv_sync_and_index_chunk);
+
+	for (i = 0, rows = 0; ok && i < nchunks; i++) {
+		ok = chunks[i].ok && (i == 0 || chunks[i - 1].next == chunks[i].first) && rows <= INT32_MAX - chunks[i].rows;
+		rows += chunks[i].rows;
+	}
+
+	if (ok && rows) {
+		csv->rowoffs = ocrpt_mem_malloc(rows * sizeof(size_t));
+		ok = (csv->rowoffs != NULL);
+	}
+
+	if (ok) {
+		for (i = 0, rows = 0; i < nchunks; i++) {
+			memcpy(csv->rowoffs + rows, chunks[i].rowoffs, chunks[i].rows * sizeof(size_t));
+			rows += chunks[i].rows;
+		}
+		csv->array.rows = rows;
+	}
+
+	for (i = 0; i < nchunks; i++)
+		free(chunks[i].rowoffs);
+	ocrpt_mem_free(chunks);
+
+	return ok;
+}
+
+/* Check the whole file and collect the offsets of the rows */
+static bool ocrpt_csv_index(struct ocrpt_csv_results *csv, size_t pos, int32_t threads) {
+	struct ocrpt_csv_chunk chunk;
+
+	if (threads > 1 && ocrpt_csv_index_parallel(csv, pos, threads))
+		return true;
+
+	memset(&chunk, 0, sizeof(chunk));
+	chunk.csv = csv;
+	chunk.realloc_fn = ocrpt_mem_realloc0;
+	chunk.first = pos;
+	chunk.end = csv->size;
+
+	ocrpt_csv_index_chunk(&chunk);
+
+	csv->rowoffs = chunk.rowoffs;
+	csv->array.rows = chunk.rows;
+	return chunk.ok;
+}
+
+static ocrpt_query *ocrpt_csv_query_add(ocrpt_datasource *source,
+										const char *name, const char *filename,
+										const int32_t *types, int32_t types_cols) {
+	if (!source || !name || !filename)
+		return NULL;
+
+	char *real_filename = ocrpt_find_file(source->o, filename);
+	if (!real_filename)
+		return NULL;
+
+	struct ocrpt_csv_results *csv;
+	ocrpt_query *query;
+	size_t pos = 0, hdrpos = 0;
+	int32_t cols, i;
+	bool ok;
+
+	csv = ocrpt_mem_malloc(sizeof(struct ocrpt_csv_results));
+	if (!csv) {
+		ocrpt_mem_free(real_filename);
 		return NULL;
 	}
 
-	for (rowptr = fq.rowlist, row = 0; rowptr; rowptr = rowptr->next, row++) {
-		const ocrpt_list *colptr;
-		int32_t col;
+	memset(csv, 0, sizeof(struct ocrpt_csv_results));
+	csv->parsed_row = -1;
 
-		for (colptr = rowptr->data, col = 0; colptr; colptr = colptr->next, col++)
-			array[row * fq.cols + col] = colptr->data;
+	ok = ocrpt_csv_map_file(csv, real_filename);
+	ocrpt_mem_free(real_filename);
 
-		for (; col < fq.cols; col++)
-			array[row * fq.cols + col] = NULL;
+	/* The header is the first record, every name must be valid */
+	if (ok)
+		ok = (ocrpt_csv_parse_record(csv, &hdrpos, false, &cols) > 0);
+	if (ok) {
+		csv->array.cols = cols;
+		csv->cells = ocrpt_mem_malloc(cols * sizeof(struct ocrpt_csv_cell));
+		csv->rowbuf = ocrpt_mem_string_new_with_len(NULL, 256);
+		ok = (csv->cells != NULL && csv->rowbuf != NULL && ocrpt_csv_parse_record(csv, &pos, true, NULL) > 0);
+	}
+	if (ok) {
+		csv->array.data = ocrpt_mem_malloc(cols * sizeof(char *));
+		ok = (csv->array.data != NULL);
+		if (ok)
+			memset(csv->array.data, 0, cols * sizeof(char *));
+		for (i = 0; ok && i < cols; i++) {
+			ok = !csv->cells[i].isnull;
+			if (ok) {
+				csv->array.data[i] = ocrpt_mem_strdup(csv->rowbuf->str + csv->cells[i].offset);
+				ok = (csv->array.data[i] != NULL);
+			}
+		}
+	}
+	if (ok)
+		ok = ocrpt_csv_index(csv, pos, ((struct ocrpt_csv_conn_private *)ocrpt_datasource_get_private(source))->threads);
+	if (ok && types) {
+		int32_t types_cols_copy = (types_cols > 0 ? types_cols : cols);
+		int32_t *types_copy = ocrpt_mem_malloc((types_cols_copy > cols ? types_cols_copy : cols) * sizeof(int32_t));
+
+		ok = (types_copy != NULL);
+		if (ok) {
+			memcpy(types_copy, types, types_cols_copy * sizeof(int32_t));
+			for (i = types_cols_copy; i < cols; i++)
+				types_copy[i] = OCRPT_RESULT_STRING;
+			csv->array.types = types_copy;
+			csv->array.types_cols = types_cols_copy;
+		}
 	}
 
-	retval = array_query_add(source, name, array, fq.rows - 1, fq.cols, types, types_cols);
+	query = (ok ? ocrpt_query_alloc(source, name) : NULL);
+	if (!query) {
+		ocrpt_csv_free_private(csv);
+		return NULL;
+	}
 
-	ocrpt_file_query_free(&fq, false);
+	csv->array.current_row = 0;
+	csv->array.atstart = true;
+	csv->array.isdone = false;
+	ocrpt_query_set_private(query, csv);
 
-	return retval;
+	return query;
 }
 
 static const char *ocrpt_csv_input_names[] = { "csv", NULL };
 
 const ocrpt_input ocrpt_csv_input = {
 	.names = ocrpt_csv_input_names,
-	.connect = ocrpt_array_connect,
+	.connect_parameters = ocrpt_csv_connect_methods,
+	.connect = ocrpt_csv_connect,
 	.query_add_file = ocrpt_csv_query_add,
 	.describe = ocrpt_array_describe,
 	.rewind = ocrpt_array_rewind,
-	.next = ocrpt_array_next,
-	.populate_result = ocrpt_array_populate_result,
+	.next = ocrpt_csv_next,
+	.populate_result = ocrpt_csv_populate_result,
 	.isdone = ocrpt_array_isdone,
-	.free = ocrpt_file_free,
-	.set_encoding = ocrpt_array_set_encoding,
-	.close = ocrpt_array_close
+	.free = ocrpt_csv_free,
+	.set_encoding = ocrpt_csv_set_encoding,
+	.close = ocrpt_csv_close
 };
 
 static int ocrpt_yajl_null(void *ctx) {
@@ -739,91 +1291,409 @@ static yajl_callbacks ocrpt_yajl_cb = {
 	ocrpt_yajl_end_array
 };
 
-static ocrpt_query *ocrpt_json_query_add(ocrpt_datasource *source,
-										const char *name, const char *filename,
-										const int32_t *types,
-										int32_t types_cols) {
-	if (!source || !name || !filename)
-		return NULL;
-
-	char *real_filename = ocrpt_find_file(source->o, filename);
-	if (!real_filename)
-		return NULL;
+/*
+ * JSON files are parsed incrementally. The file is fed to yajl
+ * in blocks and the rows parsed from a block are queued until
+ * they are read, so only the header and the rows of one block
+ * are kept in memory while the rows are read once.
+ * A file that fits into a single block is kept in memory
+ * as a whole and rewinding it is cheap.
+ *
+ * When the rows of a larger file are read again, or the query
+ * is an N:1 follower that is rewound for every row of its
+ * leader, the file is parsed once more into a columnar store
+ * and the query is served from the store from then on.
+ *
+ * The column types are decided when the query is added,
+ * so "coltypes" are only considered before "rows" in
+ * files larger than a block.
+ */
+#define OCRPT_JSON_BLOCK (64 * 1024)
 
-	struct stat st;
-	char *buf;
-	const char **array;
-	ocrpt_query *retval;
+struct ocrpt_json_results {
+	/* The array query state, data holds the column names */
+	struct ocrpt_array_results array;
 	ocrpt_file_query fq;
-	yajl_status yajl_stat;
-	yajl_handle yhandler;
-	ocrpt_list *rowptr;
-	int32_t fd, row;
+	yajl_handle yhandle;
+	unsigned char *buf;
+	/* The list of the column names */
+	ocrpt_list *header;
+	/* The current row, the rows after it are in fq.rowlist */
+	ocrpt_list *current;
+	char *filename;
+	int32_t fd;
+	bool eof:1;
+	bool spooled:1;
+	/* The file could not be read completely */
+	bool error:1;
+};
 
-	if (stat(filename, &st) != 0)
-		return NULL;
+static void ocrpt_json_free_parser(struct ocrpt_json_results *json) {
+	if (json->yhandle)
+		yajl_free(json->yhandle);
+	json->yhandle = NULL;
 
-	fd = open(real_filename, O_RDONLY);
+	/* The values of an incomplete row */
+	if (json->fq.fields) {
+		for (int32_t i = 0; i < json->fq.cols; i++)
+			ocrpt_mem_free(json->fq.fields[i]);
+	}
+	ocrpt_list_free_deep(json->fq.collist, ocrpt_mem_free);
+	ocrpt_file_query_free(&json->fq, true);
+	memset(&json->fq, 0, sizeof(ocrpt_file_query));
+}
 
-	ocrpt_mem_free(real_filename);
+/* Feed the next block of the file to the parser */
+static bool ocrpt_json_feed(struct ocrpt_json_results *json) {
+	ssize_t len = read(json->fd, json->buf, OCRPT_JSON_BLOCK);
 
-	if (fd < 0)
-		return NULL;
+	if (len < 0)
+		return false;
 
-	buf = ocrpt_mem_malloc(st.st_size);
-	if (!buf) {
-		close(fd);
-		return NULL;
+	if (len == 0) {
+		json->eof = true;
+		return yajl_complete_parse(json->yhandle) == yajl_status_ok;
 	}
 
-	if (read(fd, buf, st.st_size) != st.st_size) {
-		close(fd);
-		ocrpt_mem_free(buf);
-		return NULL;
+	return yajl_parse(json->yhandle, json->buf, len) == yajl_status_ok;
+}
+
+/*
+ * Parse the file from the beginning until the rows start.
+ * The parsed header is left at the head of fq.rowlist.
+ */
+static bool ocrpt_json_start(struct ocrpt_json_results *json) {
+	ocrpt_json_free_parser(json);
+	json->eof = false;
+
+	if (lseek(json->fd, 0, SEEK_SET) != 0)
+		return false;
+
+	json->yhandle = yajl_alloc(&ocrpt_yajl_cb, &ocrpt_yajl_alloc_funcs, (void *)&json->fq);
+	if (!json->yhandle)
+		return false;
+	yajl_config(json->yhandle, yajl_allow_comments, 1);
+
+	while (!json->eof && !(json->fq.headerset && json->fq.inrows)) {
+		if (!ocrpt_json_feed(json))
+			return false;
 	}
 
-	close(fd);
+	return json->fq.headerset;
+}
 
-	memset(&fq, 0, sizeof(ocrpt_file_query));
+/* Parse blocks until a row is queued or the file ends */
+static void ocrpt_json_fill(struct ocrpt_json_results *json) {
+	while (!json->fq.rowlist && !json->eof) {
+		if (!ocrpt_json_feed(json)) {
+			ocrpt_err_printf("JSON parse error in %s\n", json->filename);
+			json->eof = true;
+			json->error = true;
+		}
+	}
+}
+
+/*
+ * Parse the file again from the beginning. The header is
+ * already known, the parser is pointed to the original
+ * column names.
+ */
+static void ocrpt_json_restart(struct ocrpt_json_results *json) {
+	ocrpt_list_free_deep(json->current, ocrpt_file_query_free_rows);
+	json->current = NULL;
 
-	yhandler = yajl_alloc(&ocrpt_yajl_cb, &ocrpt_yajl_alloc_funcs, (void *) &fq);
-	yajl_config(yhandler, yajl_allow_comments, 1);
+	bool ok = ocrpt_json_start(json) && json->fq.rowlist && json->fq.cols == json->array.cols;
 
-	yajl_stat = yajl_parse(yhandler, (unsigned char *)buf, st.st_size);
-	if (yajl_stat != yajl_status_ok) {
-		ocrpt_file_query_free(&fq, true);
-		yajl_free(yhandler);
-		ocrpt_mem_free(buf);
-		return NULL;
+	for (int32_t i = 0; ok && i < json->array.cols; i++) {
+		ok = (strcmp(json->fq.names[i], json->array.data[i]) == 0);
+		json->fq.names[i] = json->array.data[i];
+	}
+
+	if (ok) {
+		ocrpt_list *header = json->fq.rowlist;
+
+		json->fq.rowlist = header->next;
+		if (!json->fq.rowlist)
+			json->fq.row_last = NULL;
+		header->next = NULL;
+		ocrpt_list_free_deep(header, ocrpt_file_query_free_rows);
+	} else {
+		ocrpt_err_printf("JSON file %s cannot be parsed again\n", json->filename);
+		ocrpt_json_free_parser(json);
+		json->eof = true;
+		json->error = true;
 	}
+}
+
+/*
+ * Move the rest of the rows into a columnar store.
+ * If it fails, the query keeps reading the file.
+ */
+static void ocrpt_json_spool(struct ocrpt_json_results *json, bool restart) {
+	ocrpt_colstore *store;
+	bool ok = true;
 
-	ocrpt_mem_free(buf);
+	if (restart)
+		ocrpt_json_restart(json);
 
-	yajl_free(yhandler);
+	store = ocrpt_colstore_new(json->array.cols);
+	if (!store)
+		return;
 
-	array = ocrpt_mem_malloc(fq.rows * fq.cols * sizeof(char *));
-	if (!array) {
-		ocrpt_file_query_free(&fq, true);
+	while (ok) {
+		ocrpt_list *row;
+		const ocrpt_list *ptr;
+		int32_t i;
+
+		ocrpt_json_fill(json);
+
+		row = json->fq.rowlist;
+		if (!row)
+			break;
+
+		json->fq.rowlist = row->next;
+		if (!json->fq.rowlist)
+			json->fq.row_last = NULL;
+		row->next = NULL;
+
+		for (ptr = row->data, i = 0; ok && i < json->array.cols; i++) {
+			const char *str = (ptr ? ptr->data : NULL);
+
+			ok = ocrpt_colstore_append(store, i, str, str ? strlen(str) : 0);
+			if (ptr)
+				ptr = ptr->next;
+		}
+
+		ok = ok && ocrpt_colstore_end_row(store);
+
+		ocrpt_list_free_deep(row, ocrpt_file_query_free_rows);
+	}
+
+	if (!ok) {
+		ocrpt_err_printf("out of memory while storing the rows of JSON file %s\n", json->filename);
+		ocrpt_colstore_free(store);
+		ocrpt_json_restart(json);
+		return;
+	}
+
+	ocrpt_colstore_finish(store);
+	json->array.store = store;
+	json->array.rows = store->rows;
+
+	ocrpt_json_free_parser(json);
+	close(json->fd);
+	json->fd = -1;
+	ocrpt_mem_free(json->buf);
+	json->buf = NULL;
+}
+
+static void ocrpt_json_rewind(ocrpt_query *query) {
+	struct ocrpt_json_results *json = ocrpt_query_get_private(query);
+
+	if (json == NULL)
+		return;
+
+	/* Rows were read since the parser was (re)started */
+	bool consumed = (json->array.current_row > 0);
+
+	json->array.current_row = 0;
+	json->array.atstart = true;
+	json->array.isdone = false;
+
+	if (json->spooled) {
+		json->current = NULL;
+		return;
+	}
+
+	if (json->array.store)
+		ocrpt_colstore_reset_cache(json->array.store);
+	else if (consumed || (query->leader && query->leader_is_n_1))
+		ocrpt_json_spool(json, consumed);
+
+	if (json->error)
+		ocrpt_query_set_error(query);
+}
+
+static bool ocrpt_json_populate_result(ocrpt_query *query) {
+	struct ocrpt_datasource *source = ocrpt_query_get_source(query);
+	struct ocrpt_json_results *json = ocrpt_query_get_private(query);
+	struct ocrpt_array_results *result = &json->array;
+	const ocrpt_list *ptr;
+	int32_t i;
+
+	if (result->store)
+		return ocrpt_array_populate_result(query);
+
+	if (result->atstart || result->isdone) {
+		ocrpt_query_result_set_values_null(query);
+		return !result->isdone;
+	}
+
+	for (ptr = json->current->data, i = 0; i < result->cols; i++) {
+		const char *str = (ptr ? ptr->data : NULL);
+
+		ocrpt_query_result_set_value(query, i, (str == NULL), ocrpt_datasource_get_private(source), str, str ? strlen(str) : 0);
+		if (ptr)
+			ptr = ptr->next;
+	}
+
+	return true;
+}
+
+static bool ocrpt_json_next(ocrpt_query *query) {
+	struct ocrpt_json_results *json = ocrpt_query_get_private(query);
+
+	if (json == NULL)
+		return false;
+
+	if (json->array.store)
+		return ocrpt_array_next(query);
+
+	if (json->spooled)
+		json->current = (json->array.atstart ? json->fq.rowlist : (json->current ? json->current->next : NULL));
+	else {
+		ocrpt_list_free_deep(json->current, ocrpt_file_query_free_rows);
+
+		ocrpt_json_fill(json);
+		if (json->error)
+			ocrpt_query_set_error(query);
+
+		json->current = json->fq.rowlist;
+		if (json->current) {
+			json->fq.rowlist = json->current->next;
+			if (!json->fq.rowlist)
+				json->fq.row_last = NULL;
+			json->current->next = NULL;
+		}
+	}
+
+	json->array.atstart = false;
+	json->array.current_row++;
+	json->array.isdone = (json->current == NULL);
+
+	return ocrpt_json_populate_result(query);
+}
+
+static void ocrpt_json_free_private(struct ocrpt_json_results *json) {
+	if (!json->spooled)
+		ocrpt_list_free_deep(json->current, ocrpt_file_query_free_rows);
+	ocrpt_json_free_parser(json);
+	ocrpt_list_free_deep(json->header, ocrpt_mem_free);
+	ocrpt_colstore_free(json->array.store);
+
+	if (json->fd >= 0)
+		close(json->fd);
+
+	ocrpt_mem_free(json->array.data);
+	ocrpt_mem_free(json->array.types);
+	ocrpt_mem_free(json->buf);
+	ocrpt_mem_free(json->filename);
+	ocrpt_mem_free(json);
+}
+
+static void ocrpt_json_free(ocrpt_query *query) {
+	if (!query)
+		return;
+
+	ocrpt_json_free_private(ocrpt_query_get_private(query));
+	ocrpt_query_set_private(query, NULL);
+}
+
+static ocrpt_query *ocrpt_json_query_add(ocrpt_datasource *source,
+										const char *name, const char *filename,
+										const int32_t *types,
+										int32_t types_cols) {
+	if (!source || !name || !filename)
+		return NULL;
+
+	char *real_filename = ocrpt_find_file(source->o, filename);
+	if (!real_filename)
+		return NULL;
+
+	struct ocrpt_json_results *json;
+	ocrpt_query *query;
+	const ocrpt_list *ptr;
+	int32_t i;
+	bool ok;
+
+	json = ocrpt_mem_malloc(sizeof(struct ocrpt_json_results));
+	if (!json) {
+		ocrpt_mem_free(real_filename);
 		return NULL;
 	}
 
-	for (rowptr = fq.rowlist, row = 0; rowptr; rowptr = rowptr->next, row++) {
-		const ocrpt_list *colptr;
-		int32_t col;
+	memset(json, 0, sizeof(struct ocrpt_json_results));
+	json->filename = real_filename;
+	json->fd = open(real_filename, O_RDONLY);
+	json->buf = ocrpt_mem_malloc(OCRPT_JSON_BLOCK);
+
+	ok = (json->fd >= 0 && json->buf != NULL && ocrpt_json_start(json) && json->fq.rowlist);
+
+	/* Detach the header from the rows */
+	if (ok) {
+		json->header = (ocrpt_list *)json->fq.rowlist->data;
+		json->fq.rowlist->data = NULL;
+		ptr = json->fq.rowlist;
+		json->fq.rowlist = json->fq.rowlist->next;
+		if (!json->fq.rowlist)
+			json->fq.row_last = NULL;
+		ocrpt_mem_free(ptr);
+
+		json->array.cols = json->fq.cols;
+		json->array.data = ocrpt_mem_malloc(json->fq.cols * sizeof(char *));
+		ok = (json->array.data != NULL);
+		for (ptr = json->header, i = 0; ok && ptr; ptr = ptr->next, i++) {
+			json->array.data[i] = ptr->data;
+			/* The field names must not be NULL */
+			ok = (ptr->data != NULL);
+		}
+	}
 
-		for (colptr = rowptr->data, col = 0; colptr; colptr = colptr->next, col++)
-			array[row * fq.cols + col] = colptr->data;
+	/* A file that fits into a block is parsed completely */
+	if (ok && !json->eof) {
+		struct stat st;
 
-		for (; col < fq.cols; col++)
-			array[row * fq.cols + col] = NULL;
+		if (fstat(json->fd, &st) == 0 && st.st_size <= OCRPT_JSON_BLOCK) {
+			while (ok && !json->eof)
+				ok = ocrpt_json_feed(json);
+		}
 	}
 
-	retval = array_query_add(source, name, array, fq.rows - 1, fq.cols, (fq.coltypesset ? fq.types : types), (fq.coltypesset ? fq.cols : types_cols));
+	if (ok && json->eof) {
+		json->spooled = true;
+		yajl_free(json->yhandle);
+		json->yhandle = NULL;
+		close(json->fd);
+		json->fd = -1;
+	}
 
-	ocrpt_file_query_free(&fq, false);
-	ocrpt_mem_free(fq.types);
+	if (ok && (json->fq.coltypesset || types)) {
+		const int32_t *types_src = (json->fq.coltypesset ? json->fq.types : types);
+		int32_t types_cols_copy = (json->fq.coltypesset ? json->fq.cols : (types_cols > 0 ? types_cols : json->fq.cols));
+		int32_t *types_copy = ocrpt_mem_malloc((types_cols_copy > json->fq.cols ? types_cols_copy : json->fq.cols) * sizeof(int32_t));
+
+		ok = (types_copy != NULL);
+		if (ok) {
+			memcpy(types_copy, types_src, types_cols_copy * sizeof(int32_t));
+			for (i = types_cols_copy; i < json->fq.cols; i++)
+				types_copy[i] = OCRPT_RESULT_STRING;
+			json->array.types = types_copy;
+			json->array.types_cols = types_cols_copy;
+		}
+	}
 
-	return retval;
+	query = (ok ? ocrpt_query_alloc(source, name) : NULL);
+	if (!query) {
+		ocrpt_json_free_private(json);
+		return NULL;
+	}
+
+	json->array.current_row = 0;
+	json->array.atstart = true;
+	json->array.isdone = false;
+	ocrpt_query_set_private(query, json);
+
+	return query;
 }
 
 static const char *ocrpt_json_input_names[] = { "json", NULL };
@@ -833,11 +1703,11 @@ const ocrpt_input ocrpt_json_input = {
 	.connect = ocrpt_array_connect,
 	.query_add_file = ocrpt_json_query_add,
 	.describe = ocrpt_array_describe,
-	.rewind = ocrpt_array_rewind,
-	.next = ocrpt_array_next,
-	.populate_result = ocrpt_array_populate_result,
+	.rewind = ocrpt_json_rewind,
+	.next = ocrpt_json_next,
+	.populate_result = ocrpt_json_populate_result,
 	.isdone = ocrpt_array_isdone,
-	.free = ocrpt_file_free,
+	.free = ocrpt_json_free,
 	.set_encoding = ocrpt_array_set_encoding,
 	.close = ocrpt_array_close
 };
@@ -852,26 +1722,38 @@ static int32_t ocrpt_parse_col_node(opencreport *o, xmlTextReaderPtr reader, ocr
 		len = (value ? strlen((char *)value) : 0);
 	}
 
-	if (fq->inheader || fq->inrows) {
-		char *field = NULL;
+	if (fq->inheader) {
+		char *field;
 
-		if (fq->inheader && !value) {
+		if (!value) {
 			xmlFree(value);
 			return 0;
 		}
-		if (value) {
-			field = ocrpt_mem_malloc(len + 1);
-			if (field) {
-				char *end = stpncpy(field, (char *)value, len + 1);
-				*end = 0;
-			}
+
+		field = ocrpt_mem_malloc(len + 1);
+		if (field) {
+			char *end = stpncpy(field, (char *)value, len + 1);
+			*end = 0;
 		}
 
-		if (fq->inheader) {
-			fq->headerlist = ocrpt_list_end_append(fq->headerlist, &fq->header_last, field);
-			fq->cols++;
-		} else if (fq->inrows) {
-			fq->collist = ocrpt_list_end_append(fq->collist, &fq->col_last, field);
+		fq->headerlist = ocrpt_list_end_append(fq->headerlist, &fq->header_last, field);
+		fq->cols++;
+	} else if (fq->inrows) {
+		int32_t col = fq->current_col++;
+		bool ok = true;
+
+		/*
+		 * Columns over the number of column names are ignored.
+		 * If the names are not known yet, the store gets wider.
+		 */
+		if (!fq->headerset && col >= fq->store->cols)
+			ok = ocrpt_colstore_set_cols(fq->store, col + 1);
+		if (ok && col < fq->store->cols)
+			ok = ocrpt_colstore_append(fq->store, col, (char *)value, len);
+
+		if (!ok) {
+			xmlFree(value);
+			return 0;
 		}
 	} else if (fq->incoltypes) {
 		int32_t type;
@@ -919,6 +1801,8 @@ static int32_t ocrpt_parse_row_node(opencreport *o, xmlTextReaderPtr reader, ocr
 	if (xmlTextReaderIsEmptyElement(reader))
 		return 0;
 
+	fq->current_col = 0;
+
 	depth = xmlTextReaderDepth(reader);
 	err = 0;
 	ret = xmlTextReaderRead(reader);
@@ -928,9 +1812,10 @@ static int32_t ocrpt_parse_row_node(opencreport *o, xmlTextReaderPtr reader, ocr
 
 		if (nodetype == XML_READER_TYPE_END_ELEMENT && depth == xmlTextReaderDepth(reader) && !strcmp((char *)name, "row")) {
 			xmlFree(name);
-			fq->rowlist = ocrpt_list_end_append(fq->rowlist, &fq->row_last, fq->collist);
-			fq->collist = NULL;
-			fq->col_last = NULL;
+			if (!ocrpt_colstore_end_row(fq->store))
+				err = 1;
+			if (!fq->rows)
+				fq->firstrow_cols = fq->current_col;
 			fq->rows++;
 			break;
 		}
@@ -1049,11 +1934,11 @@ static int32_t ocrpt_parse_columns_node(opencreport *o, xmlTextReaderPtr reader,
 
 		if (nodetype == XML_READER_TYPE_END_ELEMENT && depth == xmlTextReaderDepth(reader) && (!strcmp((char *)name, "columns") || !strcmp((char *)name, "fields"))) {
 			xmlFree(name);
-			fq->rowlist = ocrpt_list_prepend(fq->rowlist, fq->headerlist);
-			fq->headerlist = NULL;
-			fq->header_last = NULL;
 			fq->inheader = false;
 			fq->headerset = true;
+			/* Rows before the column names may be wider or narrower */
+			if (!ocrpt_colstore_set_cols(fq->store, fq->cols))
+				err = 1;
 			break;
 		}
 
@@ -1136,12 +2021,12 @@ static ocrpt_query *ocrpt_xml_query_add(ocrpt_datasource *source,
 	if (!real_filename)
 		return NULL;
 
-	const char **array;
+	const char **names;
 	ocrpt_query *retval;
 	ocrpt_file_query fq;
 	xmlTextReaderPtr reader;
-	ocrpt_list *rowptr;
-	int32_t ret, err, row;
+	ocrpt_list *colptr;
+	int32_t ret, err, col;
 
 	reader = xmlReaderForFile(real_filename, NULL, XML_PARSE_RECOVER |
 								XML_PARSE_NOENT | XML_PARSE_NOBLANKS |
@@ -1155,6 +2040,13 @@ static ocrpt_query *ocrpt_xml_query_add(ocrpt_datasource *source,
 
 	memset(&fq, 0, sizeof(ocrpt_file_query));
 
+	/* The values are parsed directly into a columnar store */
+	fq.store = ocrpt_colstore_new(0);
+	if (!fq.store) {
+		xmlFreeTextReader(reader);
+		return NULL;
+	}
+
 	ret = xmlTextReaderRead(reader);
 	err = 0;
 	while (ret == 1) {
@@ -1183,13 +2075,36 @@ static ocrpt_query *ocrpt_xml_query_add(ocrpt_datasource *source,
 
 	xmlFreeTextReader(reader);
 
-	if (err) {
-		ocrpt_file_query_free(&fq, true);
-		return NULL;
+	/* Without <fields>, the first row holds the column names */
+	if (!err && !fq.headerset && fq.store->rows > 0) {
+		for (col = 0; col < fq.firstrow_cols; col++) {
+			size_t len;
+			const char *value = ocrpt_colstore_get(fq.store, 0, col, &len);
+			char *field = ocrpt_mem_malloc(len + 1);
+
+			if (!field) {
+				err = 1;
+				break;
+			}
+
+			if (value)
+				memcpy(field, value, len);
+			field[len] = 0;
+
+			fq.headerlist = ocrpt_list_end_append(fq.headerlist, &fq.header_last, field);
+			fq.cols++;
+		}
+
+		if (!err && !ocrpt_colstore_drop_first_row(fq.store))
+			err = 1;
 	}
 
-	array = ocrpt_mem_malloc((fq.rows + 1) * fq.cols * sizeof(char *));
-	if (!array) {
+	if (!err && !ocrpt_colstore_set_cols(fq.store, fq.cols))
+		err = 1;
+
+	names = (err ? NULL : ocrpt_mem_malloc((fq.cols > 0 ? fq.cols : 1) * sizeof(char *)));
+	if (!names) {
+		ocrpt_colstore_free(fq.store);
 		ocrpt_file_query_free(&fq, true);
 		return NULL;
 	}
@@ -1207,28 +2122,33 @@ static ocrpt_query *ocrpt_xml_query_add(ocrpt_datasource *source,
 			fq.types[col] = OCRPT_RESULT_STRING;
 
 		ocrpt_list_free(fq.coltypeslist);
+		fq.coltypeslist = NULL;
 	}
 
-	for (rowptr = fq.rowlist, row = 0; rowptr; rowptr = rowptr->next, row++) {
-		ocrpt_list *colptr;
-		int32_t col;
-
-		for (colptr = (ocrpt_list *)rowptr->data, col = 0; colptr && col < fq.cols; colptr = colptr->next, col++)
-			array[row * fq.cols + col] = colptr->data;
-
-		for (; col < fq.cols; col++)
-			array[row * fq.cols + col] = NULL;
-
-		for (; colptr; colptr = colptr->next) {
-			ocrpt_mem_free(colptr->data);
+	for (colptr = fq.headerlist, col = 0; col < fq.cols; col++) {
+		names[col] = (colptr ? colptr->data : NULL);
+		if (colptr) {
 			colptr->data = NULL;
+			colptr = colptr->next;
 		}
 	}
 
-	retval = array_query_add(source, name, array, fq.rows, fq.cols, (fq.coltypesset ? fq.types : types), (fq.coltypesset ? fq.cols : types_cols));
+	ocrpt_colstore_finish(fq.store);
+
+	retval = array_query_add(source, name, names, fq.store->rows, fq.cols, (fq.coltypesset ? fq.types : types), (fq.coltypesset ? fq.cols : types_cols));
+
+	if (retval) {
+		struct ocrpt_array_results *result = ocrpt_query_get_private(retval);
+
+		result->store = fq.store;
+	} else {
+		for (col = 0; col < fq.cols; col++)
+			ocrpt_mem_free(names[col]);
+		ocrpt_mem_free(names);
+		ocrpt_colstore_free(fq.store);
+	}
 
-	ocrpt_file_query_free(&fq, false);
-	ocrpt_mem_free(fq.types);
+	ocrpt_file_query_free(&fq, true);
 
 	return retval;
 }
@@ -0,0 +1,400 @@
+/*
+ * Columnar result store
+ *
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "opencreport.h"
+#include "ocrpt-private.h"
+#include "datasource.h"
+#include "colstore.h"
+
+/* Initial number of dictionary slots */
+#define OCRPT_COLSTORE_DICT_SIZE 4096
+
+/*
+ * A column stays dictionary encoded only if its
+ * values are repeated this many times on average.
+ */
+#define OCRPT_COLSTORE_MIN_REPEAT 4
+
+ocrpt_colstore *ocrpt_colstore_new(int32_t cols) {
+	if (cols < 0)
+		return NULL;
+
+	ocrpt_colstore *store = ocrpt_mem_malloc(sizeof(ocrpt_colstore));
+	if (!store)
+		return NULL;
+
+	memset(store, 0, sizeof(ocrpt_colstore));
+
+	if (cols > 0) {
+		store->columns = ocrpt_mem_malloc(cols * sizeof(struct ocrpt_colstore_column));
+		if (!store->columns) {
+			ocrpt_mem_free(store);
+			return NULL;
+		}
+		memset(store->columns, 0, cols * sizeof(struct ocrpt_colstore_column));
+	}
+
+	store->cols = cols;
+
+	for (int32_t i = 0; i < cols; i++)
+		store->columns[i].dictionary = true;
+
+	return store;
+}
+
+static void ocrpt_colstore_free_typed(struct ocrpt_colstore_column *c) {
+	if (!c->typed)
+		return;
+
+	for (uint32_t id = 0; id < c->values; id++)
+		ocrpt_result_free(c->typed[id]);
+
+	ocrpt_mem_free(c->typed);
+	c->typed = NULL;
+}
+
+static void ocrpt_colstore_free_column(struct ocrpt_colstore_column *c) {
+	ocrpt_colstore_free_typed(c);
+	ocrpt_mem_free(c->heap);
+	ocrpt_mem_free(c->offsets);
+	ocrpt_mem_free(c->ids);
+	ocrpt_mem_free(c->dict);
+}
+
+static uint32_t ocrpt_colstore_hash(const char *str, size_t len) {
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ (unsigned char)str[i]) * 16777619u;
+
+	return hash;
+}
+
+static inline size_t ocrpt_colstore_value_len(struct ocrpt_colstore_column *c, uint32_t id) {
+	return c->offsets[id + 1] - c->offsets[id] - 1;
+}
+
+static void ocrpt_colstore_drop_dict(struct ocrpt_colstore_column *c) {
+	ocrpt_mem_free(c->dict);
+	c->dict = NULL;
+	c->dict_mask = 0;
+	c->dictionary = false;
+}
+
+static bool ocrpt_colstore_grow_dict(struct ocrpt_colstore_column *c) {
+	uint32_t size = (c->dict ? (c->dict_mask + 1) * 2 : OCRPT_COLSTORE_DICT_SIZE);
+	uint32_t *dict = ocrpt_mem_malloc(size * sizeof(uint32_t));
+
+	if (!dict)
+		return false;
+
+	memset(dict, 0, size * sizeof(uint32_t));
+
+	for (uint32_t id = 0; id < c->values; id++) {
+		uint32_t slot = ocrpt_colstore_hash(c->heap + c->offsets[id], ocrpt_colstore_value_len(c, id)) & (size - 1);
+
+		while (dict[slot])
+			slot = (slot + 1) & (size - 1);
+		dict[slot] = id + 1;
+	}
+
+	ocrpt_mem_free(c->dict);
+	c->dict = dict;
+	c->dict_mask = size - 1;
+
+	return true;
+}
+
+static bool ocrpt_colstore_add_value(struct ocrpt_colstore_column *c, const char *str, size_t len, uint32_t *id) {
+	if (c->values >= OCRPT_COLSTORE_NULL - 1)
+		return false;
+
+	/* offsets[] has one more element than the number of values */
+	if (c->values + 1 >= c->values_allocated) {
+		uint32_t allocated = (c->values_allocated ? c->values_allocated * 2 : 64);
+		size_t *offsets = ocrpt_mem_realloc(c->offsets, allocated * sizeof(size_t));
+
+		if (!offsets)
+			return false;
+
+		c->offsets = offsets;
+		c->values_allocated = allocated;
+	}
+
+	if (c->heap_len + len + 1 > c->heap_allocated) {
+		size_t allocated = (c->heap_allocated ? c->heap_allocated * 2 : 4096);
+		char *heap;
+
+		if (allocated < c->heap_len + len + 1)
+			allocated = c->heap_len + len + 1;
+
+		heap = ocrpt_mem_realloc(c->heap, allocated);
+		if (!heap)
+			return false;
+
+		c->heap = heap;
+		c->heap_allocated = allocated;
+	}
+
+	memcpy(c->heap + c->heap_len, str, len);
+	c->heap[c->heap_len + len] = 0;
+
+	c->offsets[c->values] = c->heap_len;
+	c->heap_len += len + 1;
+	c->offsets[c->values + 1] = c->heap_len;
+	*id = c->values++;
+
+	return true;
+}
+
+static bool ocrpt_colstore_intern(struct ocrpt_colstore_column *c, const char *str, size_t len, uint32_t *id) {
+	uint32_t slot;
+
+	if (c->dictionary && !c->dict && !ocrpt_colstore_grow_dict(c))
+		ocrpt_colstore_drop_dict(c);
+
+	if (!c->dictionary)
+		return ocrpt_colstore_add_value(c, str, len, id);
+
+	for (slot = ocrpt_colstore_hash(str, len) & c->dict_mask; c->dict[slot]; slot = (slot + 1) & c->dict_mask) {
+		uint32_t v = c->dict[slot] - 1;
+
+		if (ocrpt_colstore_value_len(c, v) == len && memcmp(c->heap + c->offsets[v], str, len) == 0) {
+			*id = v;
+			return true;
+		}
+	}
+
+	if (!ocrpt_colstore_add_value(c, str, len, id))
+		return false;
+
+	c->dict[slot] = *id + 1;
+
+	/* Keep the load factor at most 50% or stop if the values are mostly unique */
+	if (c->values * 2 > c->dict_mask + 1) {
+		if ((uint64_t)c->values * OCRPT_COLSTORE_MIN_REPEAT > (uint64_t)c->rows + 1 || !ocrpt_colstore_grow_dict(c))
+			ocrpt_colstore_drop_dict(c);
+	}
+
+	return true;
+}
+
+static bool ocrpt_colstore_reserve_row(struct ocrpt_colstore_column *c) {
+	if (c->rows < c->rows_allocated)
+		return true;
+
+	uint32_t allocated = (c->rows_allocated ? c->rows_allocated * 2 : 1024);
+	uint32_t *ids = ocrpt_mem_realloc(c->ids, allocated * sizeof(uint32_t));
+
+	if (!ids)
+		return false;
+
+	c->ids = ids;
+	c->rows_allocated = allocated;
+
+	return true;
+}
+
+bool ocrpt_colstore_set_cols(ocrpt_colstore *store, int32_t cols) {
+	if (!store || cols < 0)
+		return false;
+
+	if (cols < store->cols) {
+		for (int32_t i = cols; i < store->cols; i++)
+			ocrpt_colstore_free_column(&store->columns[i]);
+		store->cols = cols;
+		return true;
+	}
+
+	if (cols == store->cols)
+		return true;
+
+	struct ocrpt_colstore_column *columns = ocrpt_mem_realloc(store->columns, cols * sizeof(struct ocrpt_colstore_column));
+	if (!columns)
+		return false;
+
+	memset(columns + store->cols, 0, (cols - store->cols) * sizeof(struct ocrpt_colstore_column));
+	store->columns = columns;
+
+	for (int32_t i = store->cols; i < cols; i++) {
+		struct ocrpt_colstore_column *c = &columns[i];
+
+		c->dictionary = true;
+
+		/* The column is NULL in the rows before it was added */
+		while (c->rows < (uint32_t)store->rows) {
+			if (!ocrpt_colstore_reserve_row(c)) {
+				for (int32_t j = store->cols; j <= i; j++)
+					ocrpt_colstore_free_column(&columns[j]);
+				return false;
+			}
+			c->ids[c->rows++] = OCRPT_COLSTORE_NULL;
+		}
+	}
+
+	store->cols = cols;
+
+	return true;
+}
+
+bool ocrpt_colstore_drop_first_row(ocrpt_colstore *store) {
+	if (!store || store->rows <= 0)
+		return false;
+
+	for (int32_t i = 0; i < store->cols; i++) {
+		struct ocrpt_colstore_column *c = &store->columns[i];
+
+		if (c->rows > 0) {
+			memmove(c->ids, c->ids + 1, (c->rows - 1) * sizeof(uint32_t));
+			c->rows--;
+		}
+	}
+
+	store->rows--;
+
+	return true;
+}
+
+bool ocrpt_colstore_append(ocrpt_colstore *store, int32_t col, const char *str, size_t len) {
+	if (!store || col < 0 || col >= store->cols)
+		return false;
+
+	struct ocrpt_colstore_column *c = &store->columns[col];
+	uint32_t id = OCRPT_COLSTORE_NULL;
+
+	/* The column is already set in the current row */
+	if (c->rows != (uint32_t)store->rows)
+		return false;
+
+	if (!ocrpt_colstore_reserve_row(c))
+		return false;
+
+	if (str && !ocrpt_colstore_intern(c, str, len, &id))
+		return false;
+
+	c->ids[c->rows++] = id;
+
+	return true;
+}
+
+bool ocrpt_colstore_end_row(ocrpt_colstore *store) {
+	if (!store || store->rows == INT32_MAX)
+		return false;
+
+	for (int32_t i = 0; i < store->cols; i++) {
+		if (store->columns[i].rows == (uint32_t)store->rows && !ocrpt_colstore_append(store, i, NULL, 0))
+			return false;
+	}
+
+	store->rows++;
+
+	return true;
+}
+
+void ocrpt_colstore_finish(ocrpt_colstore *store) {
+	if (!store)
+		return;
+
+	for (int32_t i = 0; i < store->cols; i++) {
+		struct ocrpt_colstore_column *c = &store->columns[i];
+
+		ocrpt_mem_free(c->dict);
+		c->dict = NULL;
+		c->dict_mask = 0;
+
+		/* Caching the converted values of mostly unique values is not worth it */
+		if ((uint64_t)c->values * OCRPT_COLSTORE_MIN_REPEAT > (uint64_t)c->rows)
+			c->dictionary = false;
+
+		if (c->heap_len && c->heap_len < c->heap_allocated) {
+			char *heap = ocrpt_mem_realloc(c->heap, c->heap_len);
+
+			if (heap) {
+				c->heap = heap;
+				c->heap_allocated = c->heap_len;
+			}
+		}
+
+		if (c->rows && c->rows < c->rows_allocated) {
+			uint32_t *ids = ocrpt_mem_realloc(c->ids, c->rows * sizeof(uint32_t));
+
+			if (ids) {
+				c->ids = ids;
+				c->rows_allocated = c->rows;
+			}
+		}
+	}
+}
+
+const char *ocrpt_colstore_get(ocrpt_colstore *store, int32_t row, int32_t col, size_t *len) {
+	if (len)
+		*len = 0;
+
+	if (!store || row < 0 || row >= store->rows || col < 0 || col >= store->cols)
+		return NULL;
+
+	struct ocrpt_colstore_column *c = &store->columns[col];
+	uint32_t id = c->ids[row];
+
+	if (id == OCRPT_COLSTORE_NULL)
+		return NULL;
+
+	if (len)
+		*len = ocrpt_colstore_value_len(c, id);
+
+	return c->heap + c->offsets[id];
+}
+
+void ocrpt_colstore_populate_result(ocrpt_query *q, ocrpt_colstore *store, int32_t row, iconv_t conv) {
+	for (int32_t i = 0; i < store->cols && i < q->cols; i++) {
+		struct ocrpt_colstore_column *c = &store->columns[i];
+		uint32_t id = c->ids[row];
+
+		if (id == OCRPT_COLSTORE_NULL) {
+			ocrpt_query_result_set_value(q, i, true, conv, NULL, 0);
+			continue;
+		}
+
+		const char *str = c->heap + c->offsets[id];
+		size_t len = ocrpt_colstore_value_len(c, id);
+
+		if (c->dictionary && !c->typed) {
+			c->typed = ocrpt_mem_malloc(c->values * sizeof(ocrpt_result *));
+			if (c->typed)
+				memset(c->typed, 0, c->values * sizeof(ocrpt_result *));
+		}
+
+		if (c->dictionary && c->typed)
+			ocrpt_query_result_set_value_cached(q, i, conv, str, len, &c->typed[id]);
+		else
+			ocrpt_query_result_set_value(q, i, false, conv, str, len);
+	}
+}
+
+void ocrpt_colstore_reset_cache(ocrpt_colstore *store) {
+	if (!store)
+		return;
+
+	for (int32_t i = 0; i < store->cols; i++)
+		ocrpt_colstore_free_typed(&store->columns[i]);
+}
+
+void ocrpt_colstore_free(ocrpt_colstore *store) {
+	if (!store)
+		return;
+
+	for (int32_t i = 0; i < store->cols; i++)
+		ocrpt_colstore_free_column(&store->columns[i]);
+
+	ocrpt_mem_free(store->columns);
+	ocrpt_mem_free(store);
+}
@@ -0,0 +1,97 @@
+/*
+ * Columnar result store
+ *
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+#ifndef __OCRPT_COLSTORE_H__
+#define __OCRPT_COLSTORE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <iconv.h>
+
+#include "opencreport.h"
+
+/* Value id of NULL values */
+#define OCRPT_COLSTORE_NULL UINT32_MAX
+
+/*
+ * The values of a column are kept NUL terminated in one
+ * contiguous heap. The rows only store a value id.
+ *
+ * While the column is dictionary encoded, equal values
+ * are stored once and the converted value of every
+ * distinct value is cached. Columns with mostly unique
+ * values stop using the dictionary during loading.
+ */
+struct ocrpt_colstore_column {
+	char *heap;
+	size_t heap_len;
+	size_t heap_allocated;
+	/* Value N is at heap + offsets[N], offsets[values] is heap_len */
+	size_t *offsets;
+	uint32_t values;
+	uint32_t values_allocated;
+	/* Value id of every row */
+	uint32_t *ids;
+	uint32_t rows;
+	uint32_t rows_allocated;
+	/* Open addressing hash of the values, storing value id + 1 */
+	uint32_t *dict;
+	uint32_t dict_mask;
+	/* Converted values per value id, allocated on first use */
+	ocrpt_result **typed;
+	bool dictionary:1;
+};
+
+struct ocrpt_colstore {
+	struct ocrpt_colstore_column *columns;
+	int32_t cols;
+	int32_t rows;
+};
+typedef struct ocrpt_colstore ocrpt_colstore;
+
+ocrpt_colstore *ocrpt_colstore_new(int32_t cols);
+
+/*
+ * Change the number of columns while loading. Added columns
+ * are NULL in the rows already stored, removed columns
+ * are dropped with their values.
+ */
+bool ocrpt_colstore_set_cols(ocrpt_colstore *store, int32_t cols);
+
+/*
+ * Add the value of a column to the current row.
+ * str == NULL stores a NULL value.
+ */
+bool ocrpt_colstore_append(ocrpt_colstore *store, int32_t col, const char *str, size_t len);
+
+/* Finish the current row, the missing columns are NULL */
+bool ocrpt_colstore_end_row(ocrpt_colstore *store);
+
+/*
+ * Remove the first row, e.g. when it turns out to
+ * hold the column names. Its values stay in the heaps.
+ */
+bool ocrpt_colstore_drop_first_row(ocrpt_colstore *store);
+
+/* Release the memory only needed while loading */
+void ocrpt_colstore_finish(ocrpt_colstore *store);
+
+/* Return the value or NULL, the length is stored in *len */
+const char *ocrpt_colstore_get(ocrpt_colstore *store, int32_t row, int32_t col, size_t *len);
+
+/* Set the query results from a row of the store */
+void ocrpt_colstore_populate_result(ocrpt_query *q, ocrpt_colstore *store, int32_t row, iconv_t conv);
+
+/*
+ * Drop the cached converted values. The conversion depends
+ * on the report settings, so it's done when the query is rewound.
+ */
+void ocrpt_colstore_reset_cache(ocrpt_colstore *store);
+
+void ocrpt_colstore_free(ocrpt_colstore *store);
+
+#endif
@@ -8,6 +8,7 @@
 #include <config.h>
 
 #include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -238,6 +239,8 @@ DLL_EXPORT_SYM ocrpt_query *ocrpt_query_alloc(const ocrpt_datasource *source, co
 		return NULL;
 	}
 
+	o->resolve_epoch++;
+
 	return q;
 }
 
@@ -261,6 +264,11 @@ DLL_EXPORT_SYM void *ocrpt_query_get_private(const ocrpt_query *query) {
 	return (query ? query->priv : NULL);
 }
 
+DLL_EXPORT_SYM void ocrpt_query_set_error(ocrpt_query *query) {
+	if (query)
+		query->error = true;
+}
+
 DLL_EXPORT_SYM ocrpt_query *ocrpt_query_add_data(ocrpt_datasource *source, const char *name, const void *data, int32_t rows, int32_t cols, const int32_t *types, int32_t types_cols) {
 	if (!source || !name || !data || !source->o || source->o->executing)
 		return NULL;
@@ -378,6 +386,33 @@ DLL_EXPORT_SYM void ocrpt_query_free(ocrpt_query *q) {
 	ocrpt_query_free0(q);
 
 	o->queries = ocrpt_list_remove(o->queries, q);
+	o->resolve_epoch++;
+}
+
+/*
+ * Get the result array from the input and allocate the private
+ * state of the result slots with it. Returns false if the query
+ * has no columns.
+ */
+bool ocrpt_query_describe(ocrpt_query *q) {
+	if (!q->result) {
+		q->source->input->describe(q, &q->result, &q->cols);
+		if (q->result && q->cols > 0) {
+			q->changed = ocrpt_mem_malloc(OCRPT_EXPR_RESULTS * q->cols * sizeof(bool));
+			q->pending = ocrpt_mem_malloc(OCRPT_EXPR_RESULTS * q->cols * sizeof(bool));
+			q->referenced = ocrpt_mem_malloc(q->cols * sizeof(bool));
+			if (q->changed && q->pending && q->referenced) {
+				memset(q->changed, 0, OCRPT_EXPR_RESULTS * q->cols * sizeof(bool));
+				memset(q->pending, 0, OCRPT_EXPR_RESULTS * q->cols * sizeof(bool));
+				memset(q->referenced, 0, q->cols * sizeof(bool));
+			} else
+				ocrpt_query_result_free(q);
+		}
+		if (!q->result)
+			q->cols = 0;
+	}
+
+	return q->result && q->cols > 0;
 }
 
 DLL_EXPORT_SYM ocrpt_query_result *ocrpt_query_get_result(ocrpt_query *q, int32_t *cols) {
@@ -387,16 +422,77 @@ DLL_EXPORT_SYM ocrpt_query_result *ocrpt_query_get_result(ocrpt_query *q, int32_
 		return NULL;
 	}
 
-	if (!q->result) {
-		q->source->input->describe(q, &q->result, &q->cols);
-		if (!q->result)
-			q->cols = 0;
+	/*
+	 * The caller may access any column directly,
+	 * so none of them may be left unconverted.
+	 */
+	if (ocrpt_query_describe(q)) {
+		for (int32_t i = 0; i < q->cols; i++)
+			ocrpt_query_result_set_referenced(q, i);
 	}
 	if (cols)
 		*cols = q->cols;
 	return (q->result ? &q->result[q->source->o->residx * q->cols] : NULL);
 }
 
+static bool ocrpt_result_differs(ocrpt_result *r, ocrpt_result *prev) {
+	if (r->isnull != prev->isnull)
+		return true;
+	if (r->isnull)
+		return false;
+	if (r->type != prev->type)
+		return true;
+
+	switch (r->type) {
+	case OCRPT_RESULT_NUMBER:
+		return !prev->number_initialized || !mpfr_equal_p(r->number, prev->number);
+	case OCRPT_RESULT_DATETIME:
+		return r->date_valid != prev->date_valid ||
+				r->time_valid != prev->time_valid ||
+				r->interval != prev->interval ||
+				r->day_carry != prev->day_carry ||
+				r->datetime.tm_year != prev->datetime.tm_year ||
+				r->datetime.tm_mon != prev->datetime.tm_mon ||
+				r->datetime.tm_mday != prev->datetime.tm_mday ||
+				r->datetime.tm_hour != prev->datetime.tm_hour ||
+				r->datetime.tm_min != prev->datetime.tm_min ||
+				r->datetime.tm_sec != prev->datetime.tm_sec;
+	case OCRPT_RESULT_STRING:
+	case OCRPT_RESULT_ERROR:
+	default:
+		if (!r->string || !prev->string)
+			return r->string != prev->string;
+		return r->string->len != prev->string->len || memcmp(r->string->str, prev->string->str, r->string->len) != 0;
+	}
+}
+
+/*
+ * Compare the value of a column to the one in the previous row.
+ * The first row after rewinding the query is always considered changed.
+ */
+static void ocrpt_query_result_set_changed(ocrpt_query *q, int32_t i) {
+	opencreport *o = q->source->o;
+	int32_t idx = o->residx * q->cols + i;
+	int32_t prev_idx = ocrpt_expr_prev_residx(o->residx) * q->cols + i;
+	ocrpt_query_result *qr = &q->result[idx];
+	ocrpt_query_result *prev = &q->result[prev_idx];
+	bool changed;
+
+	if (q->current_row < 0)
+		changed = true;
+	else if (!q->pending[idx] && !q->pending[prev_idx])
+		changed = ocrpt_result_differs(&qr->result, &prev->result);
+	else if (q->pending[idx] && q->pending[prev_idx]) {
+		/* Only the raw values can be compared */
+		ocrpt_string *s = qr->result.string, *ps = prev->result.string;
+
+		changed = s->len != ps->len || memcmp(s->str, ps->str, s->len) != 0;
+	} else
+		changed = true;
+
+	q->changed[idx] = changed;
+}
+
 DLL_EXPORT_SYM void ocrpt_query_result_set_values_null(ocrpt_query *q) {
 	opencreport *o = q->source->o;
 	int32_t base = o->residx * q->cols;
@@ -405,19 +501,61 @@ DLL_EXPORT_SYM void ocrpt_query_result_set_values_null(ocrpt_query *q) {
 	for (i = 0; i < q->cols; i++) {
 		q->result[base + i].result.type = q->result[base + i].result.orig_type;
 		q->result[base + i].result.isnull = true;
+		q->pending[base + i] = false;
+		ocrpt_query_result_set_changed(q, i);
 	}
 }
 
-DLL_EXPORT_SYM void ocrpt_query_result_set_value(ocrpt_query *q, int32_t i, bool isnull, iconv_t conv, const char *str, size_t len) {
+/*
+ * Set a number from a plain integer or fixed-point decimal string.
+ * The digits are collected into an integer which is divided by
+ * the power of 10 for the fractional digits. This rounds only once,
+ * so the result is the same as with mpfr_set_str().
+ * Returns false for anything else, e.g. exponent notation or too
+ * many digits, the caller should use mpfr_set_str() then.
+ */
+static bool ocrpt_number_set_str_fast(opencreport *o, mpfr_ptr x, const char *str) {
+	const char *s = str;
+	unsigned long mant = 0, scale = 1;
+	bool neg = false, frac = false;
+
+	if (*s == '-' || *s == '+')
+		neg = (*s++ == '-');
+
+	if (*s < '0' || *s > '9')
+		return false;
+
+	for (; *s; s++) {
+		if (*s >= '0' && *s <= '9') {
+			if (mant > (ULONG_MAX - 9) / 10)
+				return false;
+			mant = mant * 10 + (*s - '0');
+			if (frac) {
+				if (scale > ULONG_MAX / 10)
+					return false;
+				scale *= 10;
+			}
+		} else if (*s == '.' && !frac && s[1] >= '0' && s[1] <= '9')
+			frac = true;
+		else
+			return false;
+	}
+
+	/* The integer must be exact in the current precision */
+	if (mpfr_set_ui(x, mant, o->rndmode))
+		return false;
+	if (neg)
+		mpfr_neg(x, x, o->rndmode);
+	if (scale > 1)
+		mpfr_div_ui(x, x, scale, o->rndmode);
+
+	return true;
+}
+
+static void ocrpt_query_result_convert(ocrpt_query *q, int32_t i, ocrpt_result *r, iconv_t conv, const char *str, size_t len) {
 	opencreport *o = q->source->o;
-	int32_t base = o->residx * q->cols;
-	ocrpt_result *r = &q->result[base + i].result;
 	ocrpt_string *rstring;
 
-	r->isnull = isnull;
-	if (isnull)
-		return;
-
 	if (conv != (iconv_t)-1) {
 		int32_t converted_len = (o->converted ? o->converted->allocated_len - 1 : len);
 		ocrpt_string *string = NULL;
@@ -478,15 +616,22 @@ DLL_EXPORT_SYM void ocrpt_query_result_set_value(ocrpt_query *q, int32_t i, bool
 			mpfr_init2(r->number, o->prec);
 			r->number_initialized = true;
 		}
-		if (!strcmp(str, "yes") || !strcmp(str, "true") || !strcmp(str, "t"))
-			str = "1";
-		if (!strcmp(str, "no") || !strcmp(str, "false") || !strcmp(str, "f"))
-			str = "0";
-		mpfr_set_str(r->number, str, 10, o->rndmode);
+		if (!ocrpt_number_set_str_fast(o, r->number, str)) {
+			if (!strcmp(str, "yes") || !strcmp(str, "true") || !strcmp(str, "t"))
+				str = "1";
+			if (!strcmp(str, "no") || !strcmp(str, "false") || !strcmp(str, "f"))
+				str = "0";
+			mpfr_set_str(r->number, str, 10, o->rndmode);
+		}
 		r->type = type;
 		break;
 	case OCRPT_RESULT_DATETIME:
-		if (ocrpt_parse_datetime(o, str, len, r)) {
+		if (!q->datetime_hints) {
+			q->datetime_hints = ocrpt_mem_malloc(q->cols * sizeof(ocrpt_datetime_hint));
+			if (q->datetime_hints)
+				memset(q->datetime_hints, 0, q->cols * sizeof(ocrpt_datetime_hint));
+		}
+		if (ocrpt_parse_datetime(o, str, len, r, q->datetime_hints ? &q->datetime_hints[i] : NULL)) {
 			r->type = type;
 			break;
 		} else if (ocrpt_parse_interval(o, str, len, r)) {
@@ -515,6 +660,118 @@ DLL_EXPORT_SYM void ocrpt_query_result_set_value(ocrpt_query *q, int32_t i, bool
 	}
 }
 
+/*
+ * Convert the raw value of a column that was stored
+ * by ocrpt_query_result_set_value() without conversion.
+ */
+static void ocrpt_query_result_convert_pending(ocrpt_query *q, int32_t idx) {
+	ocrpt_query_result *qr = &q->result[idx];
+	int32_t i = idx % q->cols;
+	ocrpt_string *raw = qr->result.string;
+
+	/* The converted value may be a string, don't convert it in place */
+	qr->result.string = NULL;
+	qr->result.string_owned = false;
+	q->pending[idx] = false;
+
+	ocrpt_query_result_convert(q, i, &qr->result, q->pending_conv, raw->str, raw->len);
+
+	if (qr->result.string)
+		ocrpt_mem_string_free(raw, true);
+	else {
+		raw->len = 0;
+		raw->str[0] = 0;
+		qr->result.string = raw;
+		qr->result.string_owned = true;
+	}
+}
+
+void ocrpt_query_result_set_referenced(ocrpt_query *q, int32_t col) {
+	int32_t j;
+
+	if (q->referenced[col])
+		return;
+
+	q->referenced[col] = true;
+
+	for (j = 0; j < OCRPT_EXPR_RESULTS; j++) {
+		if (q->pending[j * q->cols + col])
+			ocrpt_query_result_convert_pending(q, j * q->cols + col);
+	}
+}
+
+DLL_EXPORT_SYM void ocrpt_query_result_set_value(ocrpt_query *q, int32_t i, bool isnull, iconv_t conv, const char *str, size_t len) {
+	opencreport *o = q->source->o;
+	int32_t idx = o->residx * q->cols + i;
+	ocrpt_result *r = &q->result[idx].result;
+
+	q->pending[idx] = false;
+	r->isnull = isnull;
+	if (isnull) {
+		ocrpt_query_result_set_changed(q, i);
+		return;
+	}
+
+	/*
+	 * Columns that no expression uses are only copied,
+	 * they are converted when an expression starts to use them.
+	 */
+	if (!q->referenced[i] && (conv != (iconv_t)-1 || r->orig_type != OCRPT_RESULT_STRING)) {
+		ocrpt_string *rstring = ocrpt_mem_string_resize(r->string, len);
+
+		if (rstring) {
+			if (!r->string) {
+				r->string = rstring;
+				r->string_owned = true;
+			}
+			rstring->len = 0;
+			ocrpt_mem_string_append_len(rstring, str, len);
+			r->type = r->orig_type;
+			q->pending[idx] = true;
+			q->pending_conv = conv;
+			ocrpt_query_result_set_changed(q, i);
+			return;
+		}
+	}
+
+	ocrpt_query_result_convert(q, i, r, conv, str, len);
+	ocrpt_query_result_set_changed(q, i);
+}
+
+/*
+ * Set the value of a column from a value that is shared by
+ * many rows. The converted value is kept in *cached, so
+ * the same string is only converted once.
+ */
+void ocrpt_query_result_set_value_cached(ocrpt_query *q, int32_t i, iconv_t conv, const char *str, size_t len, ocrpt_result **cached) {
+	opencreport *o = q->source->o;
+	int32_t idx = o->residx * q->cols + i;
+	ocrpt_result *r = &q->result[idx].result;
+
+	/* Unreferenced columns are converted lazily and plain strings are only copied */
+	if (!q->referenced[i] || (conv == (iconv_t)-1 && r->orig_type == OCRPT_RESULT_STRING)) {
+		ocrpt_query_result_set_value(q, i, false, conv, str, len);
+		return;
+	}
+
+	q->pending[idx] = false;
+	r->isnull = false;
+
+	if (*cached)
+		ocrpt_result_copy(r, *cached);
+	else {
+		ocrpt_query_result_convert(q, i, r, conv, str, len);
+
+		*cached = ocrpt_result_new(o);
+		if (*cached) {
+			(*cached)->orig_type = r->orig_type;
+			ocrpt_result_copy(*cached, r);
+		}
+	}
+
+	ocrpt_query_result_set_changed(q, i);
+}
+
 void ocrpt_query_result_free(ocrpt_query *q) {
 	ocrpt_query_result *result = q->result;
 	int32_t cols = q->cols, i;
@@ -536,9 +793,93 @@ void ocrpt_query_result_free(ocrpt_query *q) {
 
 	ocrpt_mem_free(result);
 	q->result = NULL;
+	ocrpt_mem_free(q->changed);
+	q->changed = NULL;
+	ocrpt_mem_free(q->pending);
+	q->pending = NULL;
+	ocrpt_mem_free(q->referenced);
+	q->referenced = NULL;
+	ocrpt_mem_free(q->datetime_hints);
+	q->datetime_hints = NULL;
+	ocrpt_mem_free(q->colindex);
+	q->colindex = NULL;
+	q->colindex_result = NULL;
 	q->cols = 0;
 }
 
+static uint32_t ocrpt_query_column_hash(const char *name) {
+	uint32_t hash = 2166136261u;
+
+	for (const char *c = name; *c; c++)
+		hash = (hash ^ (unsigned char)*c) * 16777619u;
+
+	return hash;
+}
+
+static bool ocrpt_query_build_colindex(ocrpt_query *q) {
+	uint32_t size = 16, i;
+	int32_t col;
+
+	while (size < 2 * (uint32_t)q->cols)
+		size <<= 1;
+
+	ocrpt_mem_free(q->colindex);
+	q->colindex_result = NULL;
+	q->colindex = ocrpt_mem_malloc(size * sizeof(int32_t));
+	if (!q->colindex)
+		return false;
+
+	memset(q->colindex, 0, size * sizeof(int32_t));
+	q->colindex_mask = size - 1;
+
+	for (col = 0; col < q->cols; col++) {
+		const char *name = q->result[col].name;
+
+		if (!name)
+			continue;
+
+		/* Duplicate column names resolve to the first one */
+		for (i = ocrpt_query_column_hash(name) & q->colindex_mask; q->colindex[i]; i = (i + 1) & q->colindex_mask)
+			if (strcmp(q->result[q->colindex[i] - 1].name, name) == 0)
+				break;
+
+		if (!q->colindex[i])
+			q->colindex[i] = col + 1;
+	}
+
+	q->colindex_result = q->result;
+
+	return true;
+}
+
+/*
+ * Return the index of the named column in the query
+ * or -1 if there's no such column.
+ */
+int32_t ocrpt_query_find_column(ocrpt_query *q, const char *name) {
+	uint32_t i;
+
+	/* ocrpt_query_get_result() cannot be used here, we need the whole array */
+	if (!ocrpt_query_describe(q))
+		return -1;
+
+	if (q->colindex_result != q->result && !ocrpt_query_build_colindex(q)) {
+		for (int32_t col = 0; col < q->cols; col++)
+			if (q->result[col].name && strcmp(q->result[col].name, name) == 0)
+				return col;
+		return -1;
+	}
+
+	for (i = ocrpt_query_column_hash(name) & q->colindex_mask; q->colindex[i]; i = (i + 1) & q->colindex_mask) {
+		int32_t col = q->colindex[i] - 1;
+
+		if (strcmp(q->result[col].name, name) == 0)
+			return col;
+	}
+
+	return -1;
+}
+
 static bool ocrpt_query_follower_circular(ocrpt_query *leader, ocrpt_query *follower) {
 	ocrpt_list *ptr;
 
@@ -56,6 +56,29 @@ struct ocrpt_query {
 	char *name;
 	const ocrpt_datasource *source;
 	ocrpt_query_result *result;
+	/* Per-column datetime formats of the previous row */
+	struct ocrpt_datetime_hint *datetime_hints;
+	/*
+	 * Open addressing hash index of the column names,
+	 * storing column index + 1. It's rebuilt if the
+	 * result array is not the one it was built for.
+	 */
+	int32_t *colindex;
+	const ocrpt_query_result *colindex_result;
+	uint32_t colindex_mask;
+	/* Character set converter for the pending column values */
+	iconv_t pending_conv;
+	/*
+	 * Private state of the result slots, indexed
+	 * the same way as the result array:
+	 * - the value differs from the one in the previous row
+	 * - the raw value is stored in result.string, it's
+	 *   converted when an expression starts to use the column
+	 */
+	bool *changed;
+	bool *pending;
+	/* The column is used by an expression, it's converted for every row */
+	bool *referenced;
 	void *priv;
 
 	/*
@@ -87,12 +110,21 @@ struct ocrpt_query {
 	bool n_to_1_empty:1;	/* shortcut to track 0-row resultsets */
 	bool n_to_1_started:1;	/* track rows in n:1 followers */
 	bool n_to_1_matched:1;
+	bool error:1;			/* the input failed to read all the rows */
 };
 
 void ocrpt_query_free0(ocrpt_query *q);
 
 void ocrpt_query_result_free(ocrpt_query *q);
 
+bool ocrpt_query_describe(ocrpt_query *q);
+
+int32_t ocrpt_query_find_column(ocrpt_query *q, const char *name);
+
+void ocrpt_query_result_set_referenced(ocrpt_query *q, int32_t col);
+
+void ocrpt_query_result_set_value_cached(ocrpt_query *q, int32_t i, iconv_t conv, const char *str, size_t len, ocrpt_result **cached);
+
 void ocrpt_query_finalize_followers(ocrpt_query *q);
 
 #endif /* _DATASOURCE_H_ */
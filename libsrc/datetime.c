@@ -19,16 +19,218 @@
 #include "exprutil.h"
 #include "ocrpt-datetime.h"
 
-bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, ocrpt_result *result) {
+static const int ocrpt_mon_yday[2][12] = {
+	{ 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 },
+	{ 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335 }
+};
+
+static const int ocrpt_wday_offset[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+
+static inline int ocrpt_parse_digits(const char *s, int n) {
+	int i, val = 0;
+
+	for (i = 0; i < n; i++) {
+		if (s[i] < '0' || s[i] > '9')
+			return -1;
+		val = val * 10 + s[i] - '0';
+	}
+
+	return val;
+}
+
+/*
+ * Allocation-free parser for the forms databases emit:
+ * YYYY-MM-DD, optionally followed by 'T' and/or spaces,
+ * HH:MM[:SS][.fff], spaces and a [+-]HH[[:]MM] zone.
+ * It fills the same fields as strptime() would with "%F %T%z".
+ * Anything else returns false and is left to strptime().
+ */
+static bool ocrpt_parse_datetime_iso(const char *s, int len, struct tm *tm, bool *parsed_time, bool *parsed_zone) {
+	int pos, year, mon, mday, hour, min, sec = 0, y;
+
+	if (len < 10 || s[4] != '-' || s[7] != '-')
+		return false;
+
+	year = ocrpt_parse_digits(s, 4);
+	mon = ocrpt_parse_digits(s + 5, 2);
+	mday = ocrpt_parse_digits(s + 8, 2);
+	if (year < 1 || mon < 1 || mon > 12 || mday < 1 || mday > 31)
+		return false;
+
+	memset(tm, 0, sizeof(struct tm));
+	tm->tm_isdst = -1;
+	tm->tm_gmtoff = timezone;
+	tm->tm_year = year - 1900;
+	tm->tm_mon = mon - 1;
+	tm->tm_mday = mday;
+	tm->tm_yday = ocrpt_mon_yday[ocrpt_leap_year(year)][mon - 1] + mday - 1;
+	y = year - (mon < 3);
+	tm->tm_wday = (y + y / 4 - y / 100 + y / 400 + ocrpt_wday_offset[mon - 1] + mday) % 7;
+
+	*parsed_time = false;
+	*parsed_zone = false;
+
+	pos = 10;
+	if (pos < len && s[pos] == 'T')
+		pos++;
+	while (pos < len && s[pos] == ' ')
+		pos++;
+	if (pos == len)
+		return true;
+
+	/* Time part, a trailing 'p' (RLIB PM marker) is left to strptime() */
+	if (len - pos < 5 || s[pos + 2] != ':')
+		return false;
+	hour = ocrpt_parse_digits(s + pos, 2);
+	min = ocrpt_parse_digits(s + pos + 3, 2);
+	pos += 5;
+	if (pos < len && s[pos] == ':') {
+		if (len - pos < 3)
+			return false;
+		sec = ocrpt_parse_digits(s + pos + 1, 2);
+		pos += 3;
+	}
+	if (hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 61)
+		return false;
+
+	tm->tm_hour = hour;
+	tm->tm_min = min;
+	tm->tm_sec = sec;
+	*parsed_time = true;
+
+	/* Ignore fractional seconds */
+	if (pos < len && s[pos] == '.') {
+		pos++;
+		while (pos < len && s[pos] >= '0' && s[pos] <= '9')
+			pos++;
+	}
+	while (pos < len && s[pos] == ' ')
+		pos++;
+	if (pos == len)
+		return true;
+
+	/* Timezone */
+	if (s[pos] == '+' || s[pos] == '-') {
+		bool neg = (s[pos] == '-');
+		int zh, zm = 0;
+
+		zh = ocrpt_parse_digits(s + pos + 1, 2);
+		if (zh < 0)
+			return false;
+		pos += 3;
+		if (pos < len) {
+			if (s[pos] == ':')
+				pos++;
+			zm = ocrpt_parse_digits(s + pos, 2);
+			if (zm < 0 || zm > 59)
+				return false;
+			pos += 2;
+		}
+		if (pos != len)
+			return false;
+
+		tm->tm_gmtoff = zh * 3600 + zm * 60;
+		if (neg)
+			tm->tm_gmtoff = -tm->tm_gmtoff;
+		*parsed_zone = true;
+		return true;
+	}
+
+	return false;
+}
+
+static void ocrpt_parse_datetime_result(ocrpt_result *result, struct tm *tm, bool parsed_date, bool parsed_time, bool parsed_zone, bool time_pm) {
+	if (parsed_zone) {
+		time_t gmtoff = tm->tm_gmtoff;
+		tm->tm_isdst = -1;
+		time_t ts = mktime(tm);
+		ts -= gmtoff - tm->tm_gmtoff;
+		localtime_r(&ts, &result->datetime);
+	} else {
+		if (time_pm)
+			tm->tm_hour += 12;
+		result->datetime = *tm;
+	}
+
+	result->date_valid = parsed_date;
+	result->time_valid = parsed_time;
+	result->interval = false;
+	result->day_carry = 0;
+	result->isnull = false;
+}
+
+static const char *ocrpt_parse_date_format(opencreport *o, int i) {
+	switch (i) {
+	case 0:
+		return "%d/%m/%y";
+	case 1:
+		return "%d/%m/%Y";
+	case 2:
+		return "%F";
+	case 3:
+		return nl_langinfo_l(D_FMT, o->locale);
+	default:
+		return NULL;
+	}
+}
+
+static const char *ocrpt_parse_time_format(opencreport *o, int i) {
+	switch (i) {
+	case 0:
+		return "%Tp";
+	case 1:
+		return "%T";
+	case 2:
+		return "%Rp";
+	case 3:
+		return "%R";
+	case 4:
+		return nl_langinfo_l(T_FMT, o->locale);
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * The format that parsed the previous value of the column is
+ * tried first. It's only accepted if none of the formats before
+ * it in the list could have parsed the value, so the result is
+ * the same as scanning the list. E.g. "%d/%m/%Y" must not take
+ * "05/05/80" that "%d/%m/%y" parses first.
+ * The locale specific formats are not remembered, they are
+ * not distinguishable from the generic ones.
+ */
+static bool ocrpt_parse_date_hint_ok(int i, const char *start, const char *ret) {
+	if (*ret && *ret != 'T' && *ret != ' ')
+		return false;
+
+	switch (i) {
+	case 0:
+	case 2:
+		return true;
+	case 1:
+		/* "%d/%m/%y" would have been a short read */
+		return ret - start >= 3 && isdigit(ret[-1]) && isdigit(ret[-2]) && isdigit(ret[-3]);
+	default:
+		return false;
+	}
+}
+
+static bool ocrpt_parse_time_hint_ok(int i, const char *ret) {
+	/* Not a PM marker or seconds that an earlier format would take */
+	if (*ret && *ret != '.' && *ret != ' ' && *ret != '+' && *ret != '-')
+		return false;
+
+	return i < 4;
+}
+
+bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, ocrpt_result *result, ocrpt_datetime_hint *hint) {
+	char fts_buf[64];
 	char *final_time_string, *fts_last;
 	char final_fmt[64] = "", *ffmt_last = final_fmt;
 	char *rest = NULL, *ret = NULL;
-	char *tfmt = nl_langinfo_l(T_FMT, o->locale);
-	char *dfmt = nl_langinfo_l(D_FMT, o->locale);
 	struct tm tm;
-	char *datefmts[] = { "%d/%m/%y", "%d/%m/%Y", "%F", dfmt, NULL };
-	char *timefmts[] = { "%Tp", "%T", "%Rp" ,"%R", tfmt, NULL };
-	char *fmt;
+	const char *fmt;
 	int i;
 	bool parsed_date = false;
 	bool parsed_time = false;
@@ -36,9 +238,18 @@ bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, o
 	bool allnums = true;
 	bool time_pm = false;
 
-	final_time_string = malloc(ts_len + 10);
-	if (!final_time_string)
-		goto end_error;
+	if (ocrpt_parse_datetime_iso(time_string, ts_len, &tm, &parsed_time, &parsed_zone)) {
+		ocrpt_parse_datetime_result(result, &tm, true, parsed_time, parsed_zone, false);
+		return true;
+	}
+
+	if (ts_len + 10 <= (int)sizeof(fts_buf))
+		final_time_string = fts_buf;
+	else {
+		final_time_string = malloc(ts_len + 10);
+		if (!final_time_string)
+			return false;
+	}
 
 	memset(final_time_string, 0, ts_len + 10);
 	fts_last = final_time_string;
@@ -101,16 +312,29 @@ bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, o
 		}
 	}
 
-	/* Parse date part */
-	for (i = 0, fmt = datefmts[i]; fmt; i++, fmt = datefmts[i]) {
+	/* Parse date part, try the format of the previous value first */
+	fmt = NULL;
+	if (hint && hint->date_fmt) {
+		i = hint->date_fmt - 1;
+		fmt = ocrpt_parse_date_format(o, i);
 		memset(&tm, 0, sizeof(struct tm));
 		tm.tm_isdst = -1;
 		ret = strptime(time_string, fmt, &tm);
-		if (ret) {
-			/* Short read on %y, try again with %Y */
-			if (i == 0 && *ret >= '0' && *ret <= '9')
-				continue;
-			break;
+		if (!ret || !ocrpt_parse_date_hint_ok(i, time_string, ret))
+			fmt = NULL;
+	}
+
+	if (!fmt) {
+		for (i = 0, fmt = ocrpt_parse_date_format(o, i); fmt; i++, fmt = ocrpt_parse_date_format(o, i)) {
+			memset(&tm, 0, sizeof(struct tm));
+			tm.tm_isdst = -1;
+			ret = strptime(time_string, fmt, &tm);
+			if (ret) {
+				/* Short read on %y, try again with %Y */
+				if (i == 0 && *ret >= '0' && *ret <= '9')
+					continue;
+				break;
+			}
 		}
 	}
 
@@ -120,7 +344,10 @@ bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, o
 		ffmt_last = stpcpy(final_fmt, fmt);
 		*ffmt_last = 0;
 		parsed_date = true;
-	}
+		if (hint)
+			hint->date_fmt = (i < 3 ? i + 1 : 0);
+	} else if (hint)
+		hint->date_fmt = 0;
 
 	if (!ret)
 		ret = (char *)time_string;
@@ -142,23 +369,35 @@ bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, o
 
 	rest = ret;
 
-	/* Parse time part */
-	for (i = 0, fmt = timefmts[i]; fmt; i++, fmt = timefmts[i]) {
+	/* Parse time part, try the format of the previous value first */
+	fmt = NULL;
+	if (hint && hint->time_fmt) {
+		i = hint->time_fmt - 1;
+		fmt = ocrpt_parse_time_format(o, i);
 		memset(&tm, 0, sizeof(struct tm));
 		tm.tm_isdst = -1;
 		ret = strptime(rest, fmt, &tm);
-		if (ret) {
-			if (i == 0 || i == 2) {
-				if (tm.tm_hour < 12) {
-					time_pm = true;
-					break;
-				} else
-					goto end_error;
-			}
-			break;
+		if (!ret || !ocrpt_parse_time_hint_ok(i, ret))
+			fmt = NULL;
+	}
+
+	if (!fmt) {
+		for (i = 0, fmt = ocrpt_parse_time_format(o, i); fmt; i++, fmt = ocrpt_parse_time_format(o, i)) {
+			memset(&tm, 0, sizeof(struct tm));
+			tm.tm_isdst = -1;
+			ret = strptime(rest, fmt, &tm);
+			if (ret)
+				break;
 		}
 	}
 
+	if (ret && fmt && (i == 0 || i == 2)) {
+		if (tm.tm_hour < 12)
+			time_pm = true;
+		else
+			goto end_error;
+	}
+
 	if (ret && fmt) {
 		fts_last = stpncpy(fts_last, rest, ret - rest);
 		*fts_last = 0;
@@ -166,6 +405,8 @@ bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, o
 		*ffmt_last = 0;
 
 		parsed_time = true;
+		if (hint)
+			hint->time_fmt = (i < 4 ? i + 1 : 0);
 
 		/* Ignore fractional seconds */
 		if (*ret == '.') {
@@ -205,7 +446,8 @@ bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, o
 
 			parsed_zone = true;
 		}
-	}
+	} else if (hint)
+		hint->time_fmt = 0;
 
 	end:
 
@@ -220,27 +462,12 @@ bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, o
 			goto end_error;
 		}
 
-		if (parsed_zone) {
-			time_t gmtoff = tm.tm_gmtoff;
-			tm.tm_isdst = -1;
-			time_t ts = mktime(&tm);
-			ts -= gmtoff - tm.tm_gmtoff;
-			localtime_r(&ts, &result->datetime);
-		} else {
-			if (time_pm)
-				tm.tm_hour += 12;
-			result->datetime = tm;
-		}
-
-		result->date_valid = parsed_date;
-		result->time_valid = parsed_time;
-		result->interval = false;
-		result->day_carry = 0;
-		result->isnull = false;
+		ocrpt_parse_datetime_result(result, &tm, parsed_date, parsed_time, parsed_zone, time_pm);
 	}
 
 	end_error:
-	free(final_time_string);
+	if (final_time_string != fts_buf)
+		free(final_time_string);
 
 	return parsed_date || parsed_time;
 }
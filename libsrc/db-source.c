@@ -25,6 +25,7 @@
 #include "ocrpt-private.h"
 #include "listutil.h"
 #include "datasource.h"
+#include "colstore.h"
 
 #if HAVE_POSTGRESQL
 #include <libpq-fe.h>
@@ -929,8 +930,8 @@ typedef struct ocrpt_odbc_private ocrpt_odbc_private;
 struct ocrpt_odbc_results {
 	ocrpt_query_result *result;
 	SQLHSTMT stmt;
-	ocrpt_list *rows;
-	ocrpt_list *cur_row;
+	ocrpt_colstore *store;
+	int32_t cur_row;
 	ocrpt_string *coldata;
 	int32_t cols;
 	bool atstart:1;
@@ -1080,7 +1081,6 @@ static ocrpt_query_result *ocrpt_odbc_describe_early(ocrpt_query *query) {
 	ocrpt_datasource *source = ocrpt_query_get_source(query);
 	opencreport *o = ocrpt_datasource_get_opencreport(source);
 	ocrpt_query_result *qr;
-	ocrpt_list *last_row;
 	int32_t i;
 	SQLSMALLINT cols;
 	SQLRETURN ret;
@@ -1200,28 +1200,39 @@ static ocrpt_query_result *ocrpt_odbc_describe_early(ocrpt_query *query) {
 
 	result->result = qr;
 
-	while ((ret = SQLFetchScroll(result->stmt, SQL_FETCH_NEXT, 0)) == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
-		ocrpt_list *col = NULL, *last_col;
+	/* The rows are fetched into a columnar store */
+	result->store = ocrpt_colstore_new(result->cols);
+	if (!result->store) {
+		SQLFreeHandle(SQL_HANDLE_STMT, result->stmt);
+		return qr;
+	}
 
+	while ((ret = SQLFetchScroll(result->stmt, SQL_FETCH_NEXT, 0)) == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
 		for (i = 0; i < result->cols; i++) {
 			SQLLEN len_or_null;
 
 			ret = SQLGetData(result->stmt, i + 1, SQL_C_CHAR, result->coldata->str, result->coldata->allocated_len, &len_or_null);
 			if (ret == SQL_SUCCESS_WITH_INFO || ret == SQL_SUCCESS) {
-				ocrpt_string *coldata;
-
 				if (len_or_null == SQL_NULL_DATA)
-					coldata = NULL;
-				else
-					coldata = ocrpt_mem_string_new_with_len(result->coldata->str, len_or_null);
-				col = ocrpt_list_end_append(col, &last_col, coldata);
+					ocrpt_colstore_append(result->store, i, NULL, 0);
+				else {
+					/* The value may be truncated to the buffer size */
+					size_t len = (len_or_null >= 0 && (size_t)len_or_null < result->coldata->allocated_len ? (size_t)len_or_null : strlen(result->coldata->str));
+
+					ocrpt_colstore_append(result->store, i, result->coldata->str, len);
+				}
 			} else
 				ocrpt_odbc_print_diag(query, "SQLGetData", ret);
 		}
 
-		result->rows = ocrpt_list_end_append(result->rows, &last_row, col);
+		if (!ocrpt_colstore_end_row(result->store)) {
+			ocrpt_err_printf("storing the query result failed\n");
+			break;
+		}
 	}
 
+	ocrpt_colstore_finish(result->store);
+
 	SQLFreeHandle(SQL_HANDLE_STMT, result->stmt);
 
 	return qr;
@@ -1263,6 +1274,7 @@ static ocrpt_query *ocrpt_odbc_query_add(ocrpt_datasource *source, const char *n
 	memset(result, 0, sizeof(ocrpt_odbc_results));
 
 	result->stmt = stmt;
+	result->cur_row = -1;
 	result->atstart = true;
 	ocrpt_query_set_private(query, result);
 
@@ -1291,26 +1303,22 @@ static void ocrpt_odbc_rewind(ocrpt_query *query) {
 
 	result->atstart = true;
 	result->isdone = false;
-	result->cur_row = NULL;
+	result->cur_row = -1;
+
+	ocrpt_colstore_reset_cache(result->store);
 }
 
 static bool ocrpt_odbc_populate_result(ocrpt_query *query) {
 	ocrpt_odbc_results *result = ocrpt_query_get_private(query);
 	ocrpt_datasource *source = ocrpt_query_get_source(query);
 	ocrpt_odbc_private *priv = ocrpt_datasource_get_private(source);
-	int32_t i;
-	ocrpt_list *cur_col;
 
 	if (result->atstart || result->isdone) {
 		ocrpt_query_result_set_values_null(query);
 		return !result->isdone;
 	}
 
-	for (i = 0, cur_col = (ocrpt_list *)result->cur_row->data; i < result->cols; i++, cur_col = cur_col->next) {
-		ocrpt_string *str = (ocrpt_string *)cur_col->data;
-
-		ocrpt_query_result_set_value(query, i, (str == NULL), priv->encoder, str ? str->str : NULL, str ? str->len : 0);
-	}
+	ocrpt_colstore_populate_result(query, result->store, result->cur_row, priv->encoder);
 
 	return true;
 }
@@ -1321,12 +1329,9 @@ static bool ocrpt_odbc_next(ocrpt_query *query) {
 	if (result->isdone)
 		return false;
 
-	if (result->atstart) {
-		result->atstart = false;
-		result->cur_row = result->rows;
-	} else if (result->cur_row)
-		result->cur_row = result->cur_row->next;
-	result->isdone = (result->cur_row == NULL);
+	result->atstart = false;
+	result->cur_row++;
+	result->isdone = (!result->store || result->cur_row >= result->store->rows);
 	return ocrpt_odbc_populate_result(query);
 }
 
@@ -1338,23 +1343,8 @@ static bool ocrpt_odbc_isdone(ocrpt_query *query) {
 
 static void ocrpt_odbc_free(ocrpt_query *query) {
 	ocrpt_odbc_results *result = ocrpt_query_get_private(query);
-	ocrpt_list *row;
-
-	for (row = (ocrpt_list *)result->rows; row; row = row->next) {
-		ocrpt_list *col;
-
-		for (col = (ocrpt_list *)row->data; col; col = col->next) {
-			ocrpt_string *data = (ocrpt_string *)col->data;
-
-			if (data)
-				ocrpt_mem_string_free(data, true);
-		}
-
-		ocrpt_list_free((ocrpt_list *)row->data);
-	}
-
-	ocrpt_list_free((ocrpt_list *)result->rows);
 
+	ocrpt_colstore_free(result->store);
 	ocrpt_mem_string_free(result->coldata, true);
 	ocrpt_mem_free(result);
 }
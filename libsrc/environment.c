@@ -73,6 +73,9 @@ DLL_EXPORT_SYM void ocrpt_set_mvariable(opencreport *o, const char *name, const
 		e->value = ocrpt_mem_strdup(value);
 		o->mvarlist = ocrpt_list_end_append(o->mvarlist, &o->mvarlist_end, e);
 	}
+
+	/* m. variables are resolved to their values */
+	o->resolve_epoch++;
 }
 
 ocrpt_result *ocrpt_find_mvariable(opencreport *o, const char *name) {
@@ -11,11 +11,13 @@
 #include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <mpfr.h>
+#include <pthread.h>
 
 #include "opencreport.h"
 #include "ocrpt-private.h"
@@ -240,6 +242,9 @@ DLL_EXPORT_SYM void ocrpt_result_copy(ocrpt_result *dst, ocrpt_result *src) {
 				dst->isnull = true;
 				break;
 			}
+			/* A copy is never a view, reset it without reading the borrowed buffer */
+			if (ocrpt_mem_string_is_view(dst->string))
+				ocrpt_mem_string_view(dst->string, "", 0);
 			if (!dst->string) {
 				dst->string = ocrpt_mem_string_new_with_len(src->string->str, src->string->len);
 				dst->string_owned = true;
@@ -351,6 +356,283 @@ DLL_EXPORT_SYM int32_t ocrpt_expr_nodes(ocrpt_expr *e) {
 	return nodes;
 }
 
+#ifdef USE_PROFILING
+static inline uint64_t ocrpt_profile_now(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void ocrpt_expr_call_profiled(ocrpt_expr *e, ocrpt_function_call func, void *user_data) {
+	/* Only user defined functions are profiled and they are not in the constant table */
+	ocrpt_function *f = (ocrpt_function *)e->func;
+	uint64_t start = ocrpt_profile_now();
+
+	func(e, user_data);
+
+	f->profile_ns += ocrpt_profile_now() - start;
+	f->profile_calls++;
+}
+
+#endif
+
+static inline void ocrpt_expr_call_direct(ocrpt_expr *e, ocrpt_function_call func, void *user_data) {
+#ifdef USE_PROFILING
+	if (e->o->profiling && e->func->user_defined) {
+		ocrpt_expr_call_profiled(e, func, user_data);
+		return;
+	}
+#endif
+	func(e, user_data);
+}
+
+static inline uint32_t ocrpt_expr_hash_add(uint32_t hash, uint64_t value) {
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+
+	return hash * 31 + (uint32_t)value;
+}
+
+static uint32_t ocrpt_result_memo_hash(uint32_t hash, ocrpt_result *r) {
+	hash = ocrpt_expr_hash_add(hash, ((uint64_t)r->type << 1) | r->isnull);
+	if (r->isnull)
+		return hash;
+
+	switch (r->type) {
+	case OCRPT_RESULT_ERROR:
+	case OCRPT_RESULT_STRING:
+		if (r->string) {
+			for (size_t i = 0; i < r->string->len; i++)
+				hash = hash * 31 + (unsigned char)r->string->str[i];
+		}
+		break;
+	case OCRPT_RESULT_NUMBER: {
+		/* Equal numbers are also equal after rounding */
+		double d = mpfr_get_d(r->number, MPFR_RNDN);
+		uint64_t bits;
+
+		memcpy(&bits, &d, sizeof(bits));
+		hash = ocrpt_expr_hash_add(hash, bits);
+		break;
+	}
+	case OCRPT_RESULT_DATETIME:
+		hash = ocrpt_expr_hash_add(hash, ((uint64_t)r->datetime.tm_year << 32) | (r->datetime.tm_mon << 27) | (r->datetime.tm_mday << 22) |
+											(r->datetime.tm_hour * 3600 + r->datetime.tm_min * 60 + r->datetime.tm_sec));
+		break;
+	}
+
+	return hash;
+}
+
+static bool ocrpt_result_memo_equal(ocrpt_result *a, ocrpt_result *b) {
+	if (a->type != b->type || a->isnull != b->isnull)
+		return false;
+	if (a->isnull)
+		return true;
+
+	switch (a->type) {
+	case OCRPT_RESULT_ERROR:
+	case OCRPT_RESULT_STRING:
+		if (!a->string || !b->string)
+			return !a->string && !b->string;
+		return a->string->len == b->string->len && memcmp(a->string->str, b->string->str, a->string->len) == 0;
+	case OCRPT_RESULT_NUMBER:
+		/* 0 and -0 compare equal but they may give different results */
+		return mpfr_equal_p(a->number, b->number) && mpfr_signbit(a->number) == mpfr_signbit(b->number);
+	case OCRPT_RESULT_DATETIME: {
+		const struct tm *ta = &a->datetime, *tb = &b->datetime;
+
+		return a->date_valid == b->date_valid && a->time_valid == b->time_valid &&
+				a->interval == b->interval && a->day_carry == b->day_carry &&
+				ta->tm_year == tb->tm_year && ta->tm_mon == tb->tm_mon && ta->tm_mday == tb->tm_mday &&
+				ta->tm_hour == tb->tm_hour && ta->tm_min == tb->tm_min && ta->tm_sec == tb->tm_sec &&
+				ta->tm_wday == tb->tm_wday && ta->tm_yday == tb->tm_yday && ta->tm_isdst == tb->tm_isdst &&
+				ta->tm_gmtoff == tb->tm_gmtoff &&
+				(ta->tm_zone == tb->tm_zone || (ta->tm_zone && tb->tm_zone && strcmp(ta->tm_zone, tb->tm_zone) == 0));
+	}
+	}
+
+	return false;
+}
+
+static void ocrpt_expr_memo_clear(struct ocrpt_expr_memo *memo) {
+	for (uint32_t i = 0; i < OCRPT_EXPR_MEMO_SIZE; i++) {
+		struct ocrpt_expr_memo_entry *entry = &memo->entries[i];
+
+		if (entry->ops) {
+			for (uint32_t j = 0; j < memo->n_ops; j++)
+				ocrpt_result_free(entry->ops[j]);
+			ocrpt_mem_free(entry->ops);
+		}
+		ocrpt_result_free(entry->result);
+	}
+
+	memset(memo->entries, 0, sizeof(memo->entries));
+	memo->disabled = false;
+}
+
+void ocrpt_expr_memo_free(struct ocrpt_expr_memo *memo) {
+	if (!memo)
+		return;
+
+	ocrpt_expr_memo_clear(memo);
+	ocrpt_mem_free(memo);
+}
+
+static inline bool ocrpt_result_memo_too_long(ocrpt_result *r) {
+	return !r->isnull && (r->type == OCRPT_RESULT_STRING || r->type == OCRPT_RESULT_ERROR) &&
+			r->string && r->string->len > OCRPT_EXPR_MEMO_MAX_STRING;
+}
+
+static bool ocrpt_expr_memo_entry_match(ocrpt_expr *e, struct ocrpt_expr_memo_entry *entry, uint32_t hash) {
+	if (!entry->used || entry->hash != hash)
+		return false;
+
+	for (uint32_t i = 0; i < e->n_ops; i++)
+		if (!ocrpt_result_memo_equal(entry->ops[i], EXPR_RESULT(e->ops[i])))
+			return false;
+
+	return true;
+}
+
+static bool ocrpt_expr_memo_entry_store(ocrpt_expr *e, struct ocrpt_expr_memo_entry *entry) {
+	opencreport *o = e->o;
+
+	if (!entry->ops) {
+		entry->ops = ocrpt_mem_malloc(e->n_ops * sizeof(ocrpt_result *));
+		if (!entry->ops)
+			return false;
+		memset(entry->ops, 0, e->n_ops * sizeof(ocrpt_result *));
+	}
+
+	for (uint32_t i = 0; i < e->n_ops; i++) {
+		if (!entry->ops[i] && !(entry->ops[i] = ocrpt_result_pool_get(o)))
+			return false;
+		ocrpt_result_copy(entry->ops[i], EXPR_RESULT(e->ops[i]));
+	}
+
+	if (!entry->result && !(entry->result = ocrpt_result_pool_get(o)))
+		return false;
+	ocrpt_result_copy(entry->result, EXPR_RESULT(e));
+
+	return true;
+}
+
+/*
+ * Call a pure function through the memo of the expression node.
+ * If the operand values are the same as in a previous call that
+ * is still in the memo, its result is copied instead of calling
+ * the function. Otherwise the function is called and its result
+ * replaces the least recently used entry of the two entries
+ * that the hash of the operand values selects.
+ */
+static void ocrpt_expr_call_memo(ocrpt_expr *e, ocrpt_function_call func, void *user_data) {
+	opencreport *o = e->o;
+	struct ocrpt_expr_memo *memo = e->memo;
+	struct ocrpt_expr_memo_entry *set, *entry;
+	uint32_t hash = 0, idx, i;
+
+	if (memo && (memo->epoch != o->memo_epoch || memo->n_ops != e->n_ops)) {
+		ocrpt_expr_memo_clear(memo);
+		memo->epoch = o->memo_epoch;
+		memo->n_ops = e->n_ops;
+	}
+
+	/* The result is copied into the result slot owned by the node */
+	if ((memo && memo->disabled) || (EXPR_RESULT(e) && !ocrpt_expr_get_result_owned(e, o->residx))) {
+		ocrpt_expr_call_direct(e, func, user_data);
+		return;
+	}
+
+	for (i = 0; i < e->n_ops; i++) {
+		ocrpt_result *op = EXPR_RESULT(e->ops[i]);
+
+		if (!op || ocrpt_result_memo_too_long(op)) {
+			ocrpt_expr_call_direct(e, func, user_data);
+			return;
+		}
+		hash = ocrpt_result_memo_hash(hash, op);
+	}
+
+	if (!memo) {
+		memo = ocrpt_mem_malloc(sizeof(struct ocrpt_expr_memo));
+		if (!memo) {
+			ocrpt_expr_call_direct(e, func, user_data);
+			return;
+		}
+		memset(memo, 0, sizeof(struct ocrpt_expr_memo));
+		memo->epoch = o->memo_epoch;
+		memo->n_ops = e->n_ops;
+		e->memo = memo;
+	}
+
+	/* The low bits of the string hashes are weak, mix them */
+	idx = hash;
+	idx ^= idx >> 16;
+	idx *= 0x85ebca6bU;
+	idx ^= idx >> 13;
+	set = &memo->entries[idx & (OCRPT_EXPR_MEMO_SIZE - 2)];
+
+	for (i = 0; i < 2; i++) {
+		entry = &set[i];
+		if (ocrpt_expr_memo_entry_match(e, entry, hash) && ocrpt_expr_init_result(e, entry->result->type)) {
+			ocrpt_result_copy(EXPR_RESULT(e), entry->result);
+			entry->last_used = ++memo->clock;
+			memo->hits++;
+			return;
+		}
+	}
+
+	ocrpt_expr_call_direct(e, func, user_data);
+	memo->misses++;
+
+	if (memo->misses >= OCRPT_EXPR_MEMO_PROBE && memo->hits < memo->misses / 4) {
+		ocrpt_expr_memo_clear(memo);
+		memo->disabled = true;
+		return;
+	}
+
+	if (!EXPR_RESULT(e) || !ocrpt_expr_get_result_owned(e, o->residx) || ocrpt_result_memo_too_long(EXPR_RESULT(e)))
+		return;
+
+	if (!set[0].used)
+		entry = &set[0];
+	else if (!set[1].used)
+		entry = &set[1];
+	else
+		entry = (set[0].last_used <= set[1].last_used ? &set[0] : &set[1]);
+
+	entry->used = ocrpt_expr_memo_entry_store(e, entry);
+	entry->hash = hash;
+	entry->last_used = ++memo->clock;
+}
+
+static inline void ocrpt_expr_call(ocrpt_expr *e, ocrpt_function_call func, void *user_data) {
+	if (e->func->memoize && e->n_ops)
+		ocrpt_expr_call_memo(e, func, user_data);
+	else
+		ocrpt_expr_call_direct(e, func, user_data);
+}
+
+/*
+ * A function with lazily evaluated operands is also constant
+ * if all the operands it would evaluate are constants,
+ * e.g. iif(1, 'a', x) or 0 && x
+ */
+static bool ocrpt_expr_lazy_operands_const(ocrpt_expr *e) {
+	if (!e->func || !e->func->next_operand || !e->n_ops)
+		return false;
+
+	for (int32_t i = 0; i >= 0 && i < e->n_ops; i = e->func->next_operand(e, i))
+		if (!ocrpt_expr_is_const(e->ops[i]))
+			return false;
+
+	return true;
+}
+
 /*
  * Optimize the expression as much as possible
  * Implememented ideas:
@@ -396,7 +678,7 @@ static void ocrpt_expr_optimize_worker(ocrpt_expr *e) {
 		if (ocrpt_expr_is_dtconst(e->ops[i]))
 			dtconst++, nconst++;
 	}
-	if (nconst == e->n_ops) {
+	if (nconst == e->n_ops || ocrpt_expr_lazy_operands_const(e)) {
 		/*
 		 * Fully constant expression, precompute it.
 		 */
@@ -490,7 +772,8 @@ static void ocrpt_expr_optimize_worker(ocrpt_expr *e) {
 			}
 
 			if (e->func->func && !e->func->dont_optimize) {
-				e->func->func(e, e->func->user_data);
+				/* Constant calls are evaluated only once, don't memoize them */
+				ocrpt_expr_call_direct(e, e->func->func, e->func->user_data);
 				for (i = 0; i < e->n_ops; i++)
 					ocrpt_expr_free(e->ops[i]);
 				ocrpt_mem_free(e->ops);
@@ -622,13 +905,340 @@ DLL_EXPORT_SYM void ocrpt_expr_optimize(ocrpt_expr *e) {
 	if (!e)
 		return;
 
+	/*
+	 * The optimizer may rewrite the tree, the program is rebuilt afterwards.
+	 * It may also free shared subexpressions, so stop sharing them.
+	 */
+	ocrpt_report_unshare_expressions(e->r);
+	ocrpt_expr_program_free(e);
 	ocrpt_expr_optimize_worker(e);
+	ocrpt_expr_compile(e);
+	ocrpt_expr_deps_build(e);
+}
+
+static const struct {
+	const char *name;
+	enum ocrpt_rvar_kind kind;
+} ocrpt_rvar_names[] = {
+	{ "baseexpr", OCRPT_RVAR_BASEEXPR },
+	{ "detailcnt", OCRPT_RVAR_DETAILCNT },
+	{ "format", OCRPT_RVAR_FORMAT },
+	{ "ignoreexpr", OCRPT_RVAR_IGNOREEXPR },
+	{ "intermed2expr", OCRPT_RVAR_INTERMED2EXPR },
+	{ "intermedexpr", OCRPT_RVAR_INTERMEDEXPR },
+	{ "lineno", OCRPT_RVAR_LINENO },
+	{ "matched", OCRPT_RVAR_MATCHED },
+	{ "pageno", OCRPT_RVAR_PAGENO },
+	{ "self", OCRPT_RVAR_SELF },
+	{ "totpages", OCRPT_RVAR_TOTPAGES },
+	{ "value", OCRPT_RVAR_VALUE },
+};
+
+static enum ocrpt_rvar_kind ocrpt_expr_rvar_kind(ocrpt_expr *e) {
+	if (e->rvar_kind == OCRPT_RVAR_UNRESOLVED) {
+		uint32_t i;
+
+		e->rvar_kind = OCRPT_RVAR_UNKNOWN;
+		for (i = 0; i < sizeof(ocrpt_rvar_names) / sizeof(ocrpt_rvar_names[0]); i++) {
+			if (strcmp(e->name->str, ocrpt_rvar_names[i].name) == 0) {
+				e->rvar_kind = ocrpt_rvar_names[i].kind;
+				break;
+			}
+		}
+	}
+
+	return e->rvar_kind;
+}
+
+/*
+ * The result pointers of r.totpages, r.pageno, r.format,
+ * r.matched, r.detailcnt and r.ignoreexpr are set up by
+ * ocrpt_expr_resolve(), there's nothing to do for them
+ * at evaluation time.
+ */
+static bool ocrpt_expr_rvar_needs_eval(ocrpt_expr *e) {
+	switch (e->rvar_kind) {
+	case OCRPT_RVAR_TOTPAGES:
+	case OCRPT_RVAR_PAGENO:
+	case OCRPT_RVAR_FORMAT:
+	case OCRPT_RVAR_MATCHED:
+	case OCRPT_RVAR_DETAILCNT:
+	case OCRPT_RVAR_IGNOREEXPR:
+		return false;
+	default:
+		return true;
+	}
+}
+
+/*
+ * Static type inference.
+ *
+ * The result type of a node is known before evaluation if it's
+ * a constant, a query column, a report variable of a known type
+ * or a function with a type-specialised variant matching the
+ * static types of its operands. Everything else, e.g. m. variables,
+ * eval() or user functions, is unknown and the generic function
+ * variants are used for them.
+ */
+static const struct ocrpt_function_typed *ocrpt_expr_typed_func(ocrpt_expr *e) {
+	const struct ocrpt_function_typed *t;
+
+	if (e->type != OCRPT_EXPR || !e->func || !e->func->typed || !e->n_ops)
+		return NULL;
+
+	for (t = e->func->typed; t->func; t++) {
+		uint32_t i;
+
+		for (i = 0; i < e->n_ops; i++)
+			if (!e->ops[i] || !e->ops[i]->static_type_known || e->ops[i]->static_type != t->op_type)
+				break;
+
+		if (i == e->n_ops)
+			return t;
+	}
+
+	return NULL;
+}
+
+void ocrpt_expr_infer_types(ocrpt_expr *e) {
+	const struct ocrpt_function_typed *t;
+
+	if (!e)
+		return;
+
+	e->static_type_known = false;
+
+	switch (e->type) {
+	case OCRPT_EXPR_STRING:
+	case OCRPT_EXPR_NUMBER:
+	case OCRPT_EXPR_DATETIME:
+		e->static_type = (enum ocrpt_result_type)e->type;
+		e->static_type_known = true;
+		break;
+	case OCRPT_EXPR_IDENT:
+		/* Query column */
+		if (e->q && e->result[0]) {
+			e->static_type = e->result[0]->orig_type;
+			e->static_type_known = true;
+		}
+		break;
+	case OCRPT_EXPR_VVAR:
+		if (!e->var)
+			break;
+
+		switch (e->var->type) {
+		case OCRPT_VARIABLE_EXPRESSION:
+			if (e->var->resultexpr && e->var->resultexpr->static_type_known) {
+				e->static_type = e->var->resultexpr->static_type;
+				e->static_type_known = true;
+			}
+			break;
+		case OCRPT_VARIABLE_COUNT:
+		case OCRPT_VARIABLE_COUNTALL:
+		case OCRPT_VARIABLE_SUM:
+		case OCRPT_VARIABLE_AVERAGE:
+		case OCRPT_VARIABLE_AVERAGEALL:
+			e->static_type = OCRPT_RESULT_NUMBER;
+			e->static_type_known = true;
+			break;
+		case OCRPT_VARIABLE_LOWEST:
+		case OCRPT_VARIABLE_HIGHEST:
+		case OCRPT_VARIABLE_CUSTOM:
+			e->static_type = e->var->basetype;
+			e->static_type_known = true;
+			break;
+		default:
+			break;
+		}
+		break;
+	case OCRPT_EXPR_RVAR:
+		switch (ocrpt_expr_rvar_kind(e)) {
+		case OCRPT_RVAR_TOTPAGES:
+		case OCRPT_RVAR_PAGENO:
+		case OCRPT_RVAR_LINENO:
+		case OCRPT_RVAR_DETAILCNT:
+			e->static_type = OCRPT_RESULT_NUMBER;
+			e->static_type_known = true;
+			break;
+		case OCRPT_RVAR_FORMAT:
+			e->static_type = OCRPT_RESULT_STRING;
+			e->static_type_known = true;
+			break;
+		default:
+			break;
+		}
+		break;
+	case OCRPT_EXPR:
+		for (uint32_t i = 0; i < e->n_ops; i++)
+			ocrpt_expr_infer_types(e->ops[i]);
+
+		t = ocrpt_expr_typed_func(e);
+		if (t) {
+			e->static_type = t->result_type;
+			e->static_type_known = true;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Lowering an expression tree into a program.
+ *
+ * The tree is flattened in post-order, i.e. the operands of
+ * a function come before the function itself. Executing the
+ * instructions in order is then equivalent to the recursive
+ * ocrpt_expr_eval_worker(), without following the ops[]
+ * pointers, type checks on constant nodes and recursion.
+ *
+ * Trees that cannot be lowered fall back to the tree walker:
+ * - unknown functions (impossible, it is caught by the parser),
+ * - subexpressions that are iterative on their own.
+ */
+static bool ocrpt_expr_compile_count(ocrpt_expr *e, ocrpt_expr *orig_e, uint32_t *n_insns, uint32_t *n_op_ends) {
+	if (!e)
+		return false;
+
+	if (e != orig_e && e->iterative)
+		return false;
+
+	/* Shared subexpressions are evaluated separately. */
+	if (e != orig_e && e->shared) {
+		(*n_insns)++;
+		return true;
+	}
+
+	switch (e->type) {
+	case OCRPT_EXPR:
+		if (!e->func || !e->func->func)
+			return false;
+		for (uint32_t i = 0; i < e->n_ops; i++)
+			if (!ocrpt_expr_compile_count(e->ops[i], orig_e, n_insns, n_op_ends))
+				return false;
+		if (e->func->next_operand)
+			(*n_op_ends) += e->n_ops;
+		(*n_insns)++;
+		break;
+	case OCRPT_EXPR_VVAR:
+		(*n_insns)++;
+		break;
+	case OCRPT_EXPR_RVAR:
+		if (ocrpt_expr_rvar_needs_eval(e))
+			(*n_insns)++;
+		break;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+static void ocrpt_expr_compile_emit(ocrpt_expr *e, ocrpt_expr *orig_e, struct ocrpt_expr_program *prg, struct ocrpt_expr_insn **insn, uint32_t **op_ends) {
+	if (e != orig_e && e->shared) {
+		(*insn)->opcode = OCRPT_OP_SHARED;
+		(*insn)->node = e;
+		(*insn)++;
+		return;
+	}
+
+	switch (e->type) {
+	case OCRPT_EXPR:
+		if (e->func->next_operand) {
+			/*
+			 * Functions with lazily evaluated operands come first,
+			 * followed by the code of the operands. The instruction
+			 * runs the code of the operands selected by the function
+			 * descriptor, then jumps over the rest.
+			 */
+			struct ocrpt_expr_insn *lazy = (*insn)++;
+
+			lazy->opcode = OCRPT_OP_LAZY_CALL;
+			lazy->node = e;
+			lazy->func = e->func->func;
+			lazy->user_data = e->func->user_data;
+			lazy->op_ends = *op_ends;
+			(*op_ends) += e->n_ops;
+
+			for (uint32_t i = 0; i < e->n_ops; i++) {
+				ocrpt_expr_compile_emit(e->ops[i], orig_e, prg, insn, op_ends);
+				lazy->op_ends[i] = *insn - prg->insns;
+			}
+			break;
+		}
+
+		for (uint32_t i = 0; i < e->n_ops; i++)
+			ocrpt_expr_compile_emit(e->ops[i], orig_e, prg, insn, op_ends);
+
+		const struct ocrpt_function_typed *t = ocrpt_expr_typed_func(e);
+
+		(*insn)->opcode = OCRPT_OP_CALL;
+		(*insn)->node = e;
+		(*insn)->func = t ? t->func : e->func->func;
+		(*insn)->user_data = e->func->user_data;
+		(*insn)++;
+		break;
+	case OCRPT_EXPR_VVAR:
+		(*insn)->opcode = OCRPT_OP_VVAR;
+		(*insn)->node = e;
+		(*insn)++;
+		break;
+	case OCRPT_EXPR_RVAR:
+		if (!ocrpt_expr_rvar_needs_eval(e))
+			break;
+		(*insn)->opcode = OCRPT_OP_RVAR;
+		(*insn)->node = e;
+		(*insn)++;
+		break;
+	default:
+		break;
+	}
+}
+
+void ocrpt_expr_program_free(ocrpt_expr *e) {
+	if (!e)
+		return;
+
+	ocrpt_mem_free(e->program);
+	e->program = NULL;
+}
+
+bool ocrpt_expr_compile(ocrpt_expr *e) {
+	if (!e)
+		return false;
+
+	ocrpt_expr_program_free(e);
+	ocrpt_expr_infer_types(e);
+
+	uint32_t n_insns = 0, n_op_ends = 0;
+
+	if (!ocrpt_expr_compile_count(e, e, &n_insns, &n_op_ends))
+		return false;
+
+	/* Constants and plain identifiers are cheap in the tree walker. */
+	if (!n_insns)
+		return false;
+
+	struct ocrpt_expr_program *prg = ocrpt_mem_malloc(sizeof(struct ocrpt_expr_program) + n_insns * sizeof(struct ocrpt_expr_insn) + n_op_ends * sizeof(uint32_t));
+	if (!prg)
+		return false;
+
+	struct ocrpt_expr_insn *insn = prg->insns;
+	uint32_t *op_ends = (uint32_t *)(prg->insns + n_insns);
+
+	prg->n_insns = n_insns;
+	ocrpt_expr_compile_emit(e, e, prg, &insn, &op_ends);
+	assert(insn == prg->insns + n_insns);
+	assert(op_ends == (uint32_t *)(prg->insns + n_insns) + n_op_ends);
+
+	e->program = prg;
+
+	return true;
 }
 
 static bool ocrpt_resolve_ident(ocrpt_expr *e, ocrpt_query *q, bool set_query) {
-	ocrpt_query_result *qr = NULL;
 	ocrpt_list *ql;
-	int32_t cols, i;
+	int32_t i;
 	bool found = false;
 
 	/*
@@ -637,21 +1247,16 @@ static bool ocrpt_resolve_ident(ocrpt_expr *e, ocrpt_query *q, bool set_query) {
 	 * try to resolve the identifier name in this query.
 	 */
 	if (!e->query || strcmp(e->query->str, q->name) == 0) {
-		/* ocrpt_query_get_result() cannot be used here, we need the whole array */
-		if (!q->result)
-			q->source->input->describe(q, &q->result, &q->cols);
-		qr = q->result;
-		cols = (q->result ? q->cols : 0);
-
-		for (i = 0; i < cols; i++) {
-			if (!strcmp(e->name->str, qr[i].name)) {
-				for (int j = 0; set_query && j < OCRPT_EXPR_RESULTS; j++)
-					if (!e->result[j])
-						e->result[j] = &qr[j * cols + i].result;
-				found = true;
-				if (set_query)
-					e->q = q;
-				break;
+		i = ocrpt_query_find_column(q, e->name->str);
+
+		if (i >= 0) {
+			for (int j = 0; set_query && j < OCRPT_EXPR_RESULTS; j++)
+				if (!e->result[j])
+					e->result[j] = &q->result[j * q->cols + i].result;
+			found = true;
+			if (set_query) {
+				e->q = q;
+				ocrpt_query_result_set_referenced(q, i);
 			}
 		}
 	}
@@ -736,7 +1341,8 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 			if (e->resolved)
 				break;
 
-			if (strcmp(e->name->str, "self") == 0) {
+			switch (ocrpt_expr_rvar_kind(e)) {
+			case OCRPT_RVAR_SELF:
 				/* Don't assert(var) here because unit tests use r.self to test basic behaviour. */
 				e->var = var;
 				/*
@@ -758,7 +1364,8 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 						ocrpt_expr_set_result_owned(e, i, false);
 					}
 				}
-			} else if (strcmp(e->name->str, "baseexpr") == 0) {
+				break;
+			case OCRPT_RVAR_BASEEXPR:
 				if (var && (orig_e == var->ignoreexpr || orig_e == var->intermedexpr || orig_e == var->intermed2expr || orig_e == var->resultexpr)) {
 					e->var = var;
 					if (var->baseexpr) {
@@ -773,7 +1380,8 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 					}
 				} else
 					assert(!"illegal reference to r.baseexpr");
-			} else if (strcmp(e->name->str, "ignoreexpr") == 0) {
+				break;
+			case OCRPT_RVAR_IGNOREEXPR:
 				if (var && (orig_e == var->intermedexpr || orig_e == var->intermed2expr || orig_e == var->resultexpr)) {
 					e->var = var;
 					if (var->ignoreexpr) {
@@ -788,7 +1396,8 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 					}
 				} else
 					assert(!"illegal reference to r.ignoreexpr");
-			} else if (strcmp(e->name->str, "intermedexpr") == 0) {
+				break;
+			case OCRPT_RVAR_INTERMEDEXPR:
 				if (var && (orig_e == var->intermed2expr || orig_e == var->resultexpr)) {
 					e->var = var;
 					if (var->intermedexpr) {
@@ -803,7 +1412,8 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 					}
 				} else
 					assert(!"illegal reference to r.intermedexpr");
-			} else if (strcmp(e->name->str, "intermed2expr") == 0) {
+				break;
+			case OCRPT_RVAR_INTERMED2EXPR:
 				if (var && orig_e == var->resultexpr) {
 					e->var = var;
 					if (var->intermed2expr) {
@@ -818,7 +1428,8 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 					}
 				} else
 					assert(!"illegal reference to r.intermed2expr");
-			} else if (strcmp(e->name->str, "value") == 0) {
+				break;
+			case OCRPT_RVAR_VALUE:
 				if (orig_e->rvalue) {
 					for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
 						if (!e->result[i] && orig_e->rvalue->result[i]) {
@@ -827,7 +1438,8 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 						}
 					}
 				}
-			} else if (strcmp(e->name->str, "totpages") == 0) {
+				break;
+			case OCRPT_RVAR_TOTPAGES:
 				for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
 					if (!e->result[i]) {
 						e->result[i] = e->o->totpages;
@@ -836,23 +1448,16 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 				}
 				if (e->r)
 					e->r->have_delayed_expr = true;
-			} else if (strcmp(e->name->str, "pageno") == 0) {
+				break;
+			case OCRPT_RVAR_PAGENO:
 				for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
 					if (!e->result[i]) {
 						e->result[i] = e->o->pageno;
 						ocrpt_expr_set_result_owned(e, i, false);
 					}
 				}
-			} else if (strcmp(e->name->str, "lineno") == 0 && e->r) {
-				if (e->r->query && e->r->query->rownum) {
-					for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
-						if (!e->result[i] && e->r->query->rownum->result[i]) {
-							e->result[i] = e->r->query->rownum->result[i];
-							ocrpt_expr_set_result_owned(e, i, false);
-						}
-					}
-				}
-			} else if (strcmp(e->name->str, "detailcnt") == 0) {
+				break;
+			case OCRPT_RVAR_DETAILCNT:
 				if (e->r) {
 					ocrpt_list *l;
 
@@ -871,14 +1476,16 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 					}
 				} else
 					ocrpt_expr_make_error_result(e, "invalid usage of r.detailcnt");
-			} else if (strcmp(e->name->str, "format") == 0) {
+				break;
+			case OCRPT_RVAR_FORMAT:
 				for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
 					if (!e->result[i]) {
 						e->result[i] = orig_e->o->rptformat;
 						ocrpt_expr_set_result_owned(e, i, false);
 					}
 				}
-			} else if (strcmp(e->name->str, "matched") == 0) {
+				break;
+			case OCRPT_RVAR_MATCHED:
 				for (i = 0; i < OCRPT_EXPR_RESULTS; i++)  {
 					if (!e->result[i]) {
 						if (orig_e->r)
@@ -888,11 +1495,28 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 						ocrpt_expr_set_result_owned(e, i, false);
 					}
 				}
-			} else {
+				break;
+			case OCRPT_RVAR_LINENO:
+				if (e->r) {
+					if (e->r->query && e->r->query->rownum) {
+						for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
+							if (!e->result[i] && e->r->query->rownum->result[i]) {
+								e->result[i] = e->r->query->rownum->result[i];
+								ocrpt_expr_set_result_owned(e, i, false);
+							}
+						}
+					}
+					break;
+				}
+				/* r.lineno is unknown outside of a report, fall through */
+			default:
 				if (unresolved)
 					*unresolved = true;
 				/* No such identifier, turn it into a string. */
 				ocrpt_expr_convert_to_string_const(e, "r", ".", e->name->str, warn);
+				/* The lowered program may contain an instruction for it. */
+				ocrpt_expr_program_free(orig_e);
+				break;
 			}
 
 			e->resolved = true;
@@ -926,6 +1550,8 @@ void ocrpt_expr_resolve_worker(ocrpt_expr *e, ocrpt_query *query, ocrpt_expr *or
 						*unresolved = true;
 					/* No such identifier, turn it into a string. */
 					ocrpt_expr_convert_to_string_const(e, "v", ".", e->name->str, warn);
+					/* The lowered program may contain an instruction for it. */
+					ocrpt_expr_program_free(orig_e);
 				}
 
 				e->resolved = true;
@@ -981,6 +1607,7 @@ DLL_EXPORT_SYM void ocrpt_expr_resolve(ocrpt_expr *e) {
 
 	ocrpt_expr_resolve_worker(e, NULL, e, NULL, 0, true, NULL);
 	e->resolved = true;
+	ocrpt_expr_infer_types(e);
 }
 
 DLL_EXPORT_SYM void ocrpt_expr_resolve_from_query(ocrpt_expr *e, ocrpt_query *q) {
@@ -989,6 +1616,7 @@ DLL_EXPORT_SYM void ocrpt_expr_resolve_from_query(ocrpt_expr *e, ocrpt_query *q)
 
 	ocrpt_expr_resolve_worker(e, q, e, NULL, 0, true, NULL);
 	e->resolved = true;
+	ocrpt_expr_infer_types(e);
 }
 
 DLL_EXPORT_SYM void ocrpt_expr_resolve_exclude(ocrpt_expr *e, int32_t varref_exclude_mask) {
@@ -997,6 +1625,7 @@ DLL_EXPORT_SYM void ocrpt_expr_resolve_exclude(ocrpt_expr *e, int32_t varref_exc
 
 	ocrpt_expr_resolve_worker(e, NULL, e, NULL, varref_exclude_mask, true, NULL);
 	e->resolved = true;
+	ocrpt_expr_infer_types(e);
 }
 
 bool ocrpt_expr_reference_worker(ocrpt_expr *e, uint32_t varref_include_mask, uint32_t *varref_vartype_mask, ocrpt_list **var_list, bool indirect_vars) {
@@ -1059,8 +1688,7 @@ bool ocrpt_expr_reference_worker(ocrpt_expr *e, uint32_t varref_include_mask, ui
 
 			for (ptr = e->o->queries; ptr; ptr = ptr->next) {
 				ocrpt_query *q = (ocrpt_query *)ptr->data;
-				ocrpt_query_result *qr = NULL;
-				int32_t cols;
+				int32_t i;
 
 				/* Identifier is domain-qualified and it doesn't match the query name */
 				if (e->query) {
@@ -1069,20 +1697,13 @@ bool ocrpt_expr_reference_worker(ocrpt_expr *e, uint32_t varref_include_mask, ui
 					domain_found = true;
 				}
 
-				/* ocrpt_query_get_result() cannot be used here, we need the whole array */
-				if (!q->result)
-					q->source->input->describe(q, &q->result, &q->cols);
-				qr = q->result;
-				cols = (q->result ? q->cols : 0);
-
-				for (int32_t i = 0; i < cols; i++) {
-					if (!strcmp(e->name->str, qr[i].name)) {
-						for (int j = 0; j < OCRPT_EXPR_RESULTS; j++)
-							if (!e->result[j])
-								e->result[j] = &qr[j * cols + i].result;
-						ident_found = true;
-						break;
-					}
+				i = ocrpt_query_find_column(q, e->name->str);
+				if (i >= 0) {
+					for (int j = 0; j < OCRPT_EXPR_RESULTS; j++)
+						if (!e->result[j])
+							e->result[j] = &q->result[j * q->cols + i].result;
+					ocrpt_query_result_set_referenced(q, i);
+					ident_found = true;
 				}
 			}
 			if (!ident_found || (e->query && e->query->len > 0 && !domain_found)) {
@@ -1110,127 +1731,290 @@ bool ocrpt_expr_references(ocrpt_expr *e, int32_t varref_include_mask, uint32_t
 	return ocrpt_expr_reference_worker(e, varref_include_mask, varref_vartype_mask, NULL, false);
 }
 
-void ocrpt_expr_eval_worker(ocrpt_expr *e, ocrpt_expr *orig_e, ocrpt_var *var, uint32_t precalc_round) {
-	if (!e || !orig_e)
-		return;
+static inline void ocrpt_expr_eval_vvar(ocrpt_expr *e, uint32_t precalc_round) {
+	assert(e->var);
 
-	/* If:
-	 * - the expression has a self-reference,
-	 * - it's the first time it's evaluated, and
-	 * - the expression should return the initial value the first time,
-	 * then indicate that the next time it should be evaluated.
-	 */
-	if (e->iterative && e->iterative_init && e->iterative_start_with_init) {
-		e->iterative_init = false;
-		return;
+	if (e->var->precalculate && e->var->precalc_rptr)
+		EXPR_RESULT(e) = (ocrpt_result *)e->var->precalc_rptr->data;
+	else {
+		ocrpt_var *v = e->var;
+
+		if (!ocrpt_expr_get_result_evaluated(v->resultexpr, e->o->residx)) {
+			if (v->native && v->baseexpr && v->type != OCRPT_VARIABLE_COUNTALL)
+				ocrpt_expr_eval_worker(v->baseexpr, v->baseexpr, v, precalc_round);
+			if (!(v->native && ocrpt_variable_native_evaluate(v, precalc_round)))
+				ocrpt_expr_eval_worker(v->resultexpr, v->resultexpr, v, precalc_round);
+		}
+
+		if (!EXPR_RESULT(e)) {
+			assert(EXPR_RESULT(e->var->resultexpr));
+			EXPR_RESULT(e) = EXPR_RESULT(e->var->resultexpr);
+		}
 	}
+}
 
+static inline void ocrpt_expr_eval_rvar(ocrpt_expr *e, ocrpt_expr *orig_e, uint32_t precalc_round) {
 	int32_t i;
 
-	switch (e->type) {
-	case OCRPT_EXPR:
-		for (i = 0; i < e->n_ops; i++)
-			ocrpt_expr_eval_worker(e->ops[i], orig_e, var, precalc_round);
-
-		if (e->func && e->func->func)
-			e->func->func(e, e->func->user_data);
-		else
-			ocrpt_err_printf("function is unknown (impossible, it is caught by the parser)\n");
+	switch (ocrpt_expr_rvar_kind(e)) {
+	case OCRPT_RVAR_LINENO:
+		if (!e->r) {
+			for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
+				if (!e->result[i]) {
+					e->result[i] = e->o->one;
+					ocrpt_expr_set_result_owned(e, i, false);
+				}
+			}
+		} else if (e->r->query && e->r->query->rownum) {
+			for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
+				if (!e->result[i] && e->r->query->rownum->result[i]) {
+					e->result[i] = e->r->query->rownum->result[i];
+					ocrpt_expr_set_result_owned(e, i, false);
+				}
+			}
+		}
 		break;
-
-	case OCRPT_EXPR_VVAR:
+	case OCRPT_RVAR_VALUE:
+		if (orig_e->rvalue) {
+			for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
+				if (!e->result[i] && orig_e->rvalue->result[i]) {
+					e->result[i] = orig_e->rvalue->result[i];
+					ocrpt_expr_set_result_owned(e, i, false);
+				}
+			}
+		} else {
+			ocrpt_expr_make_error_result(e, "invalid usage of r.value");
+		}
+		break;
+	case OCRPT_RVAR_SELF:
+		orig_e->iterative = true;
+		if (!EXPR_RESULT(e) && EXPR_PREV_RESULT(orig_e)) {
+			EXPR_RESULT(e) = EXPR_PREV_RESULT(orig_e);
+			ocrpt_expr_set_result_owned(e, e->o->residx, false);
+		}
+		break;
+	case OCRPT_RVAR_BASEEXPR:
 		assert(e->var);
-
-		if (e->var->precalculate && e->var->precalc_rptr)
-			EXPR_RESULT(e) = (ocrpt_result *)e->var->precalc_rptr->data;
-		else {
-			if (!ocrpt_expr_get_result_evaluated(e->var->resultexpr, e->o->residx))
-				ocrpt_expr_eval_worker(e->var->resultexpr, e->var->resultexpr, e->var, precalc_round);
+		if (e->var->baseexpr) {
+			ocrpt_expr_eval_worker(e->var->baseexpr, e->var->baseexpr, e->var, precalc_round);
 
 			if (!EXPR_RESULT(e)) {
-				assert(EXPR_RESULT(e->var->resultexpr));
-				EXPR_RESULT(e) = EXPR_RESULT(e->var->resultexpr);
+				assert(EXPR_RESULT(e->var->baseexpr));
+				EXPR_RESULT(e) = EXPR_RESULT(e->var->baseexpr);
 			}
 		}
 		break;
+	case OCRPT_RVAR_INTERMEDEXPR:
+		assert(e->var);
+		if (e->var->intermedexpr) {
+			ocrpt_expr_eval_worker(e->var->intermedexpr, e->var->intermedexpr, e->var, precalc_round);
 
-	case OCRPT_EXPR_RVAR:
-		if (strcmp(e->name->str, "lineno") == 0) {
-			if (!e->r) {
-				for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
-					if (!e->result[i]) {
-						e->result[i] = e->o->one;
-						ocrpt_expr_set_result_owned(e, i, false);
-					}
-				}
-			} else if (e->r->query && e->r->query->rownum) {
-				for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
-					if (!e->result[i] && e->r->query->rownum->result[i]) {
-						e->result[i] = e->r->query->rownum->result[i];
-						ocrpt_expr_set_result_owned(e, i, false);
-					}
-				}
-			}
-		} else if (strcmp(e->name->str, "value") == 0) {
-			if (orig_e->rvalue) {
-				for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
-					if (!e->result[i] && orig_e->rvalue->result[i]) {
-						e->result[i] = orig_e->rvalue->result[i];
-						ocrpt_expr_set_result_owned(e, i, false);
-					}
-				}
-			} else {
-				ocrpt_expr_make_error_result(e, "invalid usage of r.value");
-			}
-		} else if (strcmp(e->name->str, "self") == 0) {
-			orig_e->iterative = true;
-			if (!EXPR_RESULT(e) && EXPR_PREV_RESULT(orig_e)) {
-				EXPR_RESULT(e) = EXPR_PREV_RESULT(orig_e);
-				ocrpt_expr_set_result_owned(e, e->o->residx, false);
-			}
-		} else if (strcmp(e->name->str, "baseexpr") == 0) {
-			assert(e->var);
-			if (e->var->baseexpr) {
-				ocrpt_expr_eval_worker(e->var->baseexpr, e->var->baseexpr, e->var, precalc_round);
-
-				if (!EXPR_RESULT(e)) {
-					assert(EXPR_RESULT(e->var->baseexpr));
-					EXPR_RESULT(e) = EXPR_RESULT(e->var->baseexpr);
-				}
-			}
-		} else if (strcmp(e->name->str, "intermedexpr") == 0) {
-			assert(e->var);
-			if (e->var->intermedexpr) {
-				ocrpt_expr_eval_worker(e->var->intermedexpr, e->var->intermedexpr, e->var, precalc_round);
-
-				if (!EXPR_RESULT(e)) {
-					assert(EXPR_RESULT(e->var->intermedexpr));
-					EXPR_RESULT(e) = EXPR_RESULT(e->var->intermedexpr);
-				}
-			}
-		} else if (strcmp(e->name->str, "intermed2expr") == 0) {
-			assert(e->var);
-			if (e->var->intermed2expr) {
-				ocrpt_expr_eval_worker(e->var->intermed2expr, e->var->intermed2expr, e->var, precalc_round);
-
-				if (!EXPR_RESULT(e)) {
-					assert(EXPR_RESULT(e->var->intermed2expr));
-					EXPR_RESULT(e) = EXPR_RESULT(e->var->intermed2expr);
-				}
+			if (!EXPR_RESULT(e)) {
+				assert(EXPR_RESULT(e->var->intermedexpr));
+				EXPR_RESULT(e) = EXPR_RESULT(e->var->intermedexpr);
 			}
 		}
 		break;
+	case OCRPT_RVAR_INTERMED2EXPR:
+		assert(e->var);
+		if (e->var->intermed2expr) {
+			ocrpt_expr_eval_worker(e->var->intermed2expr, e->var->intermed2expr, e->var, precalc_round);
 
+			if (!EXPR_RESULT(e)) {
+				assert(EXPR_RESULT(e->var->intermed2expr));
+				EXPR_RESULT(e) = EXPR_RESULT(e->var->intermed2expr);
+			}
+		}
+		break;
 	default:
 		break;
 	}
+}
+
+/*
+ * Whether the previous result of the expression can be reused:
+ * it was computed from the row currently in the previous result
+ * slot and none of the query columns changed since.
+ */
+static inline bool ocrpt_expr_deps_unchanged(ocrpt_expr *e) {
+	struct ocrpt_expr_deps *deps = e->deps;
+	opencreport *o = e->o;
+	int32_t residx = o->residx, prev = ocrpt_expr_prev_residx(residx);
+	uint32_t i;
+
+	if (!deps->serial[prev] || deps->serial[prev] != o->residx_serial[prev] || o->residx_serial[prev] > o->residx_serial[residx] || !e->result[prev])
+		return false;
+
+	for (i = 0; i < deps->n_idents; i++) {
+		ocrpt_expr *ident = deps->idents[i];
+		ocrpt_query_result *qr = (ocrpt_query_result *)((char *)ident->result[residx] - offsetof(ocrpt_query_result, result));
+
+		if (ident->q->changed[qr - ident->q->result])
+			return false;
+	}
+
+	return true;
+}
+
+static inline void ocrpt_expr_eval_shared(ocrpt_expr *e, uint32_t precalc_round) {
+	ocrpt_expr *shared = e->shared;
+	int32_t i;
+
+	if (!ocrpt_expr_get_result_evaluated(shared, e->o->residx))
+		ocrpt_expr_eval_worker(shared, shared, NULL, precalc_round);
+
+	if (e != shared) {
+		for (i = 0; i < OCRPT_EXPR_RESULTS; i++)
+			if (!e->result[i])
+				e->result[i] = shared->result[i];
+	}
+}
+
+static void ocrpt_expr_program_run(ocrpt_expr *e, struct ocrpt_expr_insn *insn, struct ocrpt_expr_insn *last, uint32_t precalc_round) {
+	struct ocrpt_expr_insn *insns = e->program->insns;
+
+	while (insn < last) {
+		switch (insn->opcode) {
+		case OCRPT_OP_CALL:
+			ocrpt_expr_call(insn->node, insn->func, insn->user_data);
+			insn++;
+			break;
+		case OCRPT_OP_LAZY_CALL: {
+			ocrpt_expr *node = insn->node;
+			int32_t i;
+
+			for (i = 0; i >= 0 && i < node->n_ops; i = node->func->next_operand(node, i))
+				ocrpt_expr_program_run(e, i ? insns + insn->op_ends[i - 1] : insn + 1, insns + insn->op_ends[i], precalc_round);
+
+			ocrpt_expr_call(node, insn->func, insn->user_data);
+			insn = node->n_ops ? insns + insn->op_ends[node->n_ops - 1] : insn + 1;
+			break;
+		}
+		case OCRPT_OP_VVAR:
+			ocrpt_expr_eval_vvar(insn->node, precalc_round);
+			insn++;
+			break;
+		case OCRPT_OP_RVAR:
+			ocrpt_expr_eval_rvar(insn->node, e, precalc_round);
+			insn++;
+			break;
+		case OCRPT_OP_SHARED:
+			ocrpt_expr_eval_shared(insn->node, precalc_round);
+			insn++;
+			break;
+		}
+	}
+}
+
+static void ocrpt_expr_eval_node(ocrpt_expr *e, ocrpt_expr *orig_e, ocrpt_var *var, uint32_t precalc_round) {
+	/* If:
+	 * - the expression has a self-reference,
+	 * - it's the first time it's evaluated, and
+	 * - the expression should return the initial value the first time,
+	 * then indicate that the next time it should be evaluated.
+	 */
+	if (e->iterative && e->iterative_init && e->iterative_start_with_init) {
+		e->iterative_init = false;
+		return;
+	}
+
+	if (e == orig_e && e->deps && ocrpt_expr_deps_unchanged(e)) {
+		if (EXPR_RESULT(e) != EXPR_PREV_RESULT(e)) {
+			ocrpt_expr_init_result(e, EXPR_PREV_RESULT(e)->type);
+			ocrpt_result_copy(EXPR_RESULT(e), EXPR_PREV_RESULT(e));
+		}
+	} else if (e == orig_e && e->program)
+		ocrpt_expr_program_run(e, e->program->insns, e->program->insns + e->program->n_insns, precalc_round);
+	else {
+		int32_t i;
+
+		switch (e->type) {
+		case OCRPT_EXPR:
+			if (e != orig_e && e->shared) {
+				ocrpt_expr_eval_shared(e, precalc_round);
+				break;
+			}
+
+			if (e->func && e->func->next_operand) {
+				for (i = 0; i >= 0 && i < e->n_ops; i = e->func->next_operand(e, i))
+					ocrpt_expr_eval_node(e->ops[i], orig_e, var, precalc_round);
+			} else {
+				for (i = 0; i < e->n_ops; i++)
+					ocrpt_expr_eval_node(e->ops[i], orig_e, var, precalc_round);
+			}
+
+			if (e->func && e->func->func)
+				ocrpt_expr_call(e, e->func->func, e->func->user_data);
+			else
+				ocrpt_err_printf("function is unknown (impossible, it is caught by the parser)\n");
+			break;
+
+		case OCRPT_EXPR_VVAR:
+			ocrpt_expr_eval_vvar(e, precalc_round);
+			break;
+
+		case OCRPT_EXPR_RVAR:
+			ocrpt_expr_eval_rvar(e, orig_e, precalc_round);
+			break;
+
+		default:
+			break;
+		}
+	}
 
 	if (e == orig_e) {
+		if (e->deps)
+			e->deps->serial[e->o->residx] = e->o->residx_serial[e->o->residx];
 		ocrpt_expr_set_result_evaluated(e, e->o->residx, true);
 		ocrpt_expr_set_result_evaluated(e, ocrpt_expr_next_residx(e->o->residx), false);
 	}
 }
 
+#ifdef USE_PROFILING
+static void ocrpt_expr_eval_profiled(ocrpt_expr *e, ocrpt_var *var, uint32_t precalc_round) {
+	opencreport *o = e->o;
+	uint64_t parent_child_ns = o->profile_child_ns;
+	uint64_t start, elapsed;
+
+	if (!e->profile) {
+		e->profile = ocrpt_mem_malloc(sizeof(struct ocrpt_expr_profile));
+		if (!e->profile) {
+			ocrpt_expr_eval_node(e, e, var, precalc_round);
+			return;
+		}
+		memset(e->profile, 0, sizeof(struct ocrpt_expr_profile));
+	}
+
+	o->profile_child_ns = 0;
+	start = ocrpt_profile_now();
+
+	ocrpt_expr_eval_node(e, e, var, precalc_round);
+
+	elapsed = ocrpt_profile_now() - start;
+	e->profile->calls++;
+	e->profile->total_ns += elapsed;
+	e->profile->self_ns += elapsed - (o->profile_child_ns < elapsed ? o->profile_child_ns : elapsed);
+	o->profile_child_ns = parent_child_ns + elapsed;
+}
+#endif
+
+void ocrpt_expr_eval_worker(ocrpt_expr *e, ocrpt_expr *orig_e, ocrpt_var *var, uint32_t precalc_round) {
+	if (!e || !orig_e)
+		return;
+
+#ifdef USE_PROFILING
+	/*
+	 * Toplevel expressions are profiled. Common subexpressions
+	 * are accounted for in the expression that evaluates them.
+	 */
+	if (e == orig_e && e->o->profiling && e->shared != e) {
+		ocrpt_expr_eval_profiled(e, var, precalc_round);
+		return;
+	}
+#endif
+	ocrpt_expr_eval_node(e, orig_e, var, precalc_round);
+}
+
 DLL_EXPORT_SYM ocrpt_result *ocrpt_expr_eval(ocrpt_expr *e) {
 	if (!e)
 		return NULL;
@@ -1256,86 +2040,315 @@ DLL_EXPORT_SYM ocrpt_result *ocrpt_expr_get_result(ocrpt_expr *e) {
 	}
 }
 
-/*
- * Constification from a query result will take the current result of
- * the query and duplicates it in the expression as a constant result value.
- *
- * It's the caller's responsibility to iterate over a supplementary query,
- * parse and optimize expressions (possibly mixing the report's main and
- * supplementary queries) before calling this or the public API function
- * on the expression.
- */
-static void ocrpt_expr_constify_worker(ocrpt_expr *e, ocrpt_query *constify_from) {
-	int32_t i;
-
-	if (e->type == OCRPT_EXPR) {
-		for (i = 0; i < e->n_ops; i++)
-			ocrpt_expr_constify_worker(e->ops[i], constify_from);
-	} else if (e->type == OCRPT_EXPR_IDENT) {
-		bool found = ocrpt_resolve_ident(e, constify_from, false);
+DLL_EXPORT_SYM bool ocrpt_set_profiling(opencreport *o, bool enabled) {
+	if (!o)
+		return false;
 
-		if (found) {
-			opencreport *o = e->o;
-			ocrpt_result *result = e->result[o->residx];
+#ifdef USE_PROFILING
+	o->profiling = enabled;
+	return true;
+#else
+	return false;
+#endif
+}
 
-			assert(!ocrpt_expr_get_result_owned(e, o->residx));
+DLL_EXPORT_SYM bool ocrpt_get_profiling(opencreport *o) {
+	return o ? o->profiling : false;
+}
 
-			ocrpt_mem_string_free(e->query, true);
-			e->query = NULL;
-			ocrpt_mem_string_free(e->name, true);
-			e->name = NULL;
-			e->var = NULL;
-			e->q = NULL;
+DLL_EXPORT_SYM bool ocrpt_expr_get_profile(ocrpt_expr *e, uint64_t *calls, uint64_t *total_ns, uint64_t *self_ns) {
+	if (!e || !e->profile)
+		return false;
 
-			e->result[o->residx] = ocrpt_result_new(o);
-			ocrpt_result_copy(e->result[o->residx], result);
-			ocrpt_expr_set_result_owned(e, o->residx, true);
+	if (calls)
+		*calls = e->profile->calls;
+	if (total_ns)
+		*total_ns = e->profile->total_ns;
+	if (self_ns)
+		*self_ns = e->profile->self_ns;
 
-			for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
-				if (i == o->residx)
-					continue;
+	return true;
+}
 
-				assert(!ocrpt_expr_get_result_owned(e, i));
-				e->result[i] = e->result[o->residx];
-			}
+DLL_EXPORT_SYM bool ocrpt_function_get_profile(opencreport *o, const char *fname, uint64_t *calls, uint64_t *total_ns) {
+	const ocrpt_function *f = ocrpt_function_get(o, fname);
 
-			e->type = result->type;
-		}
-	}
-}
+	if (!f || !f->user_defined)
+		return false;
 
-DLL_EXPORT_SYM void ocrpt_expr_constify(ocrpt_expr *e, ocrpt_query *constify_from) {
-	if (!e || !e->resolved || !constify_from)
-		return;
+	if (calls)
+		*calls = f->profile_calls;
+	if (total_ns)
+		*total_ns = f->profile_ns;
 
-	ocrpt_expr_constify_worker(e, constify_from);
+	return true;
 }
 
-DLL_EXPORT_SYM int32_t ocrpt_expr_get_num_operands(ocrpt_expr *e) {
+static bool ocrpt_expr_get_memo_stats_worker(ocrpt_expr *e, uint64_t *hits, uint64_t *misses) {
+	bool found = false;
+
 	if (!e)
-		return 0;
+		return false;
 
-	return e->n_ops;
-}
+	/* The shared node does the calls on behalf of this one */
+	if (e->shared && e->shared != e)
+		e = e->shared;
 
-DLL_EXPORT_SYM ocrpt_result *ocrpt_expr_operand_get_result(ocrpt_expr *e, int32_t opnum) {
-	if (!e || opnum < 0 || opnum >= e->n_ops)
-		return NULL;
+	if (e->memo) {
+		*hits += e->memo->hits;
+		*misses += e->memo->misses;
+		found = true;
+	}
 
-	assert(EXPR_VALID(e->ops[opnum]));
-	return EXPR_RESULT(e->ops[opnum]);
+	if (e->type == OCRPT_EXPR) {
+		for (uint32_t i = 0; i < e->n_ops; i++)
+			found |= ocrpt_expr_get_memo_stats_worker(e->ops[i], hits, misses);
+	}
+
+	return found;
 }
 
-DLL_EXPORT_SYM ocrpt_result *ocrpt_expr_make_error_result(ocrpt_expr *e, const char *format, ...) {
-	if (!e)
-		return NULL;
+DLL_EXPORT_SYM bool ocrpt_expr_get_memo_stats(ocrpt_expr *e, uint64_t *hits, uint64_t *misses) {
+	uint64_t h = 0, m = 0;
 
-	ocrpt_result *result = EXPR_RESULT(e);
-	va_list va;
-	size_t len;
+	if (!ocrpt_expr_get_memo_stats_worker(e, &h, &m))
+		return false;
 
-	if (!result) {
-		result = ocrpt_result_new(e->o);
+	if (hits)
+		*hits = h;
+	if (misses)
+		*misses = m;
+
+	return true;
+}
+
+struct ocrpt_profile_entry {
+	ocrpt_expr *e;
+	ocrpt_report *r;
+	int32_t report_index;
+};
+
+static int ocrpt_profile_entry_cmp(const void *a, const void *b) {
+	const struct ocrpt_profile_entry *pa = a, *pb = b;
+
+	if (pa->e->profile->total_ns != pb->e->profile->total_ns)
+		return pa->e->profile->total_ns < pb->e->profile->total_ns ? 1 : -1;
+	if (pa->e->profile->self_ns != pb->e->profile->self_ns)
+		return pa->e->profile->self_ns < pb->e->profile->self_ns ? 1 : -1;
+	if (pa->e->profile->calls != pb->e->profile->calls)
+		return pa->e->profile->calls < pb->e->profile->calls ? 1 : -1;
+	return 0;
+}
+
+static ocrpt_list *ocrpt_profile_collect(ocrpt_list *entries, ocrpt_list *exprs, ocrpt_report *r, int32_t report_index, uint32_t *n_entries) {
+	for (ocrpt_list *l = exprs; l; l = l->next) {
+		ocrpt_expr *e = (ocrpt_expr *)l->data;
+		struct ocrpt_profile_entry *pe;
+
+		if (!e->profile)
+			continue;
+
+		pe = ocrpt_mem_malloc(sizeof(struct ocrpt_profile_entry));
+		if (!pe)
+			continue;
+
+		pe->e = e;
+		pe->r = r;
+		pe->report_index = report_index;
+		entries = ocrpt_list_prepend(entries, pe);
+		(*n_entries)++;
+	}
+
+	return entries;
+}
+
+DLL_EXPORT_SYM void ocrpt_profile_print(opencreport *o) {
+	ocrpt_list *entries = NULL, *l;
+	struct ocrpt_profile_entry *array;
+	uint32_t n_entries = 0, i;
+	int32_t report_index = 0;
+
+	if (!o)
+		return;
+
+	entries = ocrpt_profile_collect(entries, o->exprs, NULL, 0, &n_entries);
+
+	for (ocrpt_list *pl = o->parts; pl; pl = pl->next) {
+		ocrpt_part *p = (ocrpt_part *)pl->data;
+
+		for (ocrpt_list *row = p->rows; row; row = row->next) {
+			ocrpt_part_row *pr = (ocrpt_part_row *)row->data;
+
+			for (ocrpt_list *pdl = pr->pd_list; pdl; pdl = pdl->next) {
+				ocrpt_part_column *pd = (ocrpt_part_column *)pdl->data;
+
+				for (ocrpt_list *rl = pd->reports; rl; rl = rl->next) {
+					ocrpt_report *r = (ocrpt_report *)rl->data;
+
+					entries = ocrpt_profile_collect(entries, r->exprs, r, ++report_index, &n_entries);
+				}
+			}
+		}
+	}
+
+	array = n_entries ? ocrpt_mem_malloc(n_entries * sizeof(struct ocrpt_profile_entry)) : NULL;
+	for (l = entries, i = 0; array && l; l = l->next, i++)
+		array[i] = *(struct ocrpt_profile_entry *)l->data;
+	ocrpt_list_free_deep(entries, ocrpt_mem_free);
+
+	ocrpt_std_printf("%10s %14s %14s  %-20s %s\n", "calls", "total (us)", "self (us)", "report", "expression");
+
+	if (array) {
+		qsort(array, n_entries, sizeof(struct ocrpt_profile_entry), ocrpt_profile_entry_cmp);
+
+		for (i = 0; i < n_entries; i++) {
+			struct ocrpt_profile_entry *pe = &array[i];
+			char report[32];
+
+			if (!pe->r)
+				strcpy(report, "-");
+			else if (pe->r->query)
+				snprintf(report, sizeof(report), "#%d %s", pe->report_index, pe->r->query->name);
+			else
+				snprintf(report, sizeof(report), "#%d", pe->report_index);
+
+			ocrpt_std_printf("%10" PRIu64 " %14.3f %14.3f  %-20s %s\n",
+								pe->e->profile->calls,
+								pe->e->profile->total_ns / 1000.0,
+								pe->e->profile->self_ns / 1000.0,
+								report,
+								pe->e->expr_string ? pe->e->expr_string : "(internal)");
+		}
+
+		ocrpt_mem_free(array);
+	}
+
+	for (i = 0; i < (uint32_t)o->n_functions; i++) {
+		ocrpt_function *f = o->functions[i];
+
+		if (i == 0)
+			ocrpt_std_printf("\n%10s %14s  %s\n", "calls", "total (us)", "user function");
+
+		ocrpt_std_printf("%10" PRIu64 " %14.3f  %s\n", f->profile_calls, f->profile_ns / 1000.0, f->fname);
+	}
+}
+
+static void ocrpt_profile_reset_list(ocrpt_list *exprs) {
+	for (ocrpt_list *l = exprs; l; l = l->next) {
+		ocrpt_expr *e = (ocrpt_expr *)l->data;
+
+		if (e->profile)
+			memset(e->profile, 0, sizeof(struct ocrpt_expr_profile));
+	}
+}
+
+DLL_EXPORT_SYM void ocrpt_profile_reset(opencreport *o) {
+	if (!o)
+		return;
+
+	ocrpt_profile_reset_list(o->exprs);
+
+	for (ocrpt_list *pl = o->parts; pl; pl = pl->next) {
+		ocrpt_part *p = (ocrpt_part *)pl->data;
+
+		for (ocrpt_list *row = p->rows; row; row = row->next) {
+			ocrpt_part_row *pr = (ocrpt_part_row *)row->data;
+
+			for (ocrpt_list *pdl = pr->pd_list; pdl; pdl = pdl->next) {
+				ocrpt_part_column *pd = (ocrpt_part_column *)pdl->data;
+
+				for (ocrpt_list *rl = pd->reports; rl; rl = rl->next)
+					ocrpt_profile_reset_list(((ocrpt_report *)rl->data)->exprs);
+			}
+		}
+	}
+
+	for (int32_t i = 0; i < o->n_functions; i++) {
+		o->functions[i]->profile_calls = 0;
+		o->functions[i]->profile_ns = 0;
+	}
+}
+
+/*
+ * Constification from a query result will take the current result of
+ * the query and duplicates it in the expression as a constant result value.
+ *
+ * It's the caller's responsibility to iterate over a supplementary query,
+ * parse and optimize expressions (possibly mixing the report's main and
+ * supplementary queries) before calling this or the public API function
+ * on the expression.
+ */
+static void ocrpt_expr_constify_worker(ocrpt_expr *e, ocrpt_query *constify_from) {
+	int32_t i;
+
+	if (e->type == OCRPT_EXPR) {
+		for (i = 0; i < e->n_ops; i++)
+			ocrpt_expr_constify_worker(e->ops[i], constify_from);
+	} else if (e->type == OCRPT_EXPR_IDENT) {
+		bool found = ocrpt_resolve_ident(e, constify_from, false);
+
+		if (found) {
+			opencreport *o = e->o;
+			ocrpt_result *result = e->result[o->residx];
+
+			assert(!ocrpt_expr_get_result_owned(e, o->residx));
+
+			ocrpt_mem_string_free(e->query, true);
+			e->query = NULL;
+			ocrpt_mem_string_free(e->name, true);
+			e->name = NULL;
+			e->var = NULL;
+			e->q = NULL;
+
+			e->result[o->residx] = ocrpt_result_pool_get(o);
+			ocrpt_result_copy(e->result[o->residx], result);
+			ocrpt_expr_set_result_owned(e, o->residx, true);
+
+			for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
+				if (i == o->residx)
+					continue;
+
+				assert(!ocrpt_expr_get_result_owned(e, i));
+				e->result[i] = e->result[o->residx];
+			}
+
+			e->type = result->type;
+		}
+	}
+}
+
+DLL_EXPORT_SYM void ocrpt_expr_constify(ocrpt_expr *e, ocrpt_query *constify_from) {
+	if (!e || !e->resolved || !constify_from)
+		return;
+
+	ocrpt_expr_constify_worker(e, constify_from);
+}
+
+DLL_EXPORT_SYM int32_t ocrpt_expr_get_num_operands(ocrpt_expr *e) {
+	if (!e)
+		return 0;
+
+	return e->n_ops;
+}
+
+DLL_EXPORT_SYM ocrpt_result *ocrpt_expr_operand_get_result(ocrpt_expr *e, int32_t opnum) {
+	if (!e || opnum < 0 || opnum >= e->n_ops)
+		return NULL;
+
+	assert(EXPR_VALID(e->ops[opnum]));
+	return EXPR_RESULT(e->ops[opnum]);
+}
+
+DLL_EXPORT_SYM ocrpt_result *ocrpt_expr_make_error_result(ocrpt_expr *e, const char *format, ...) {
+	if (!e)
+		return NULL;
+
+	ocrpt_result *result = EXPR_RESULT(e);
+	va_list va;
+	size_t len;
+
+	if (!result) {
+		result = ocrpt_result_pool_get(e->o);
 		if (!result)
 			return NULL;
 
@@ -1599,108 +2612,590 @@ void ocrpt_report_expressions_add_delayed_results(ocrpt_report *r) {
 		ocrpt_expr *e = (ocrpt_expr *)ptr->data;
 
 		if (e->delayed && !e->delayed_result) {
-			ocrpt_result *dst = ocrpt_result_new(e->o);
+			ocrpt_result *dst = ocrpt_result_pool_get(e->o);
 			ocrpt_result_copy(dst, EXPR_RESULT(e));
 			e->delayed_result = dst;
 		}
 	}
 }
 
-DLL_EXPORT_SYM void ocrpt_expr_set_field_expr(ocrpt_expr *e, ocrpt_expr *rvalue) {
-	if (!e || (rvalue && (e->o != rvalue->o || e->r != rvalue->r)))
-		return;
+/*
+ * Common subexpression elimination across the expressions of a report.
+ *
+ * Identical subtrees of the report's expressions are evaluated once
+ * per row: every occurrence points to the first one via e->shared.
+ * The first occurrence is evaluated as if it was a toplevel expression
+ * on behalf of all of them, its result_evaluated* flags tell whether it
+ * was already done for the current row. The other occurrences borrow
+ * its result pointers.
+ *
+ * These are never merged:
+ * - subtrees with r. variables, their values depend on the toplevel
+ *   expression (r.self, r.value) or on the output state (r.pageno),
+ * - subtrees with volatile functions, i.e. the ones not declared pure
+ *   like random(), now() or most user defined functions,
+ * - operands of functions with lazily evaluated operands, they may
+ *   be skipped for some rows which would make the result_evaluated*
+ *   flags stale,
+ * - subtrees of delayed and precalculated expressions, these are
+ *   evaluated at different times than the others.
+ */
+struct ocrpt_expr_share_table {
+	ocrpt_expr **nodes;
+	uint32_t *hashes;
+	uint32_t mask;
+};
 
-	e->rvalue = rvalue;
+/*
+ * Volatile functions' results may depend on more
+ * than the current values of their operands.
+ * Only functions declared pure are not volatile.
+ */
+static inline bool ocrpt_function_is_volatile(const ocrpt_function *f) {
+	return !f->pure;
 }
 
-DLL_EXPORT_SYM ocrpt_result *ocrpt_result_new(opencreport *o) {
-	if (!o)
-		return NULL;
+/*
+ * Compute the fingerprint of a subtree.
+ * Returns false if the subtree must not be shared.
+ */
+static bool ocrpt_expr_share_hash(ocrpt_expr *e, uint32_t *hash) {
+	ocrpt_result *rs = e->result[0];
+	uint32_t h = ocrpt_expr_hash_add(0, e->type);
+	int32_t i;
 
-	ocrpt_result *result = ocrpt_mem_malloc(sizeof(ocrpt_result));
+	switch (e->type) {
+	case OCRPT_EXPR_STRING:
+		if (!rs)
+			return false;
+		if (!rs->isnull && rs->string) {
+			for (size_t j = 0; j < rs->string->len; j++)
+				h = h * 31 + (unsigned char)rs->string->str[j];
+		}
+		break;
+	case OCRPT_EXPR_NUMBER:
+		if (!rs)
+			return false;
+		if (!rs->isnull && rs->number_initialized) {
+			double d = mpfr_get_d(rs->number, MPFR_RNDN);
+			uint64_t bits;
 
-	memset(result, 0, sizeof(ocrpt_result));
-	result->o = o;
+			memcpy(&bits, &d, sizeof(bits));
+			h = ocrpt_expr_hash_add(h, bits);
+		}
+		break;
+	case OCRPT_EXPR_DATETIME:
+	case OCRPT_EXPR_IDENT:
+		/* Only the same constant or the same query column. */
+		if (!rs)
+			return false;
+		h = ocrpt_expr_hash_add(h, (uintptr_t)rs);
+		break;
+	case OCRPT_EXPR_VVAR:
+		if (!e->var)
+			return false;
+		h = ocrpt_expr_hash_add(h, (uintptr_t)e->var);
+		break;
+	case OCRPT_EXPR:
+		if (!e->func || !e->func->func || e->iterative || ocrpt_function_is_volatile(e->func))
+			return false;
+		h = ocrpt_expr_hash_add(h, (uintptr_t)e->func);
+		h = ocrpt_expr_hash_add(h, e->n_ops);
+		for (i = 0; i < e->n_ops; i++) {
+			uint32_t oph;
 
-	return result;
+			if (!ocrpt_expr_share_hash(e->ops[i], &oph))
+				return false;
+			h = ocrpt_expr_hash_add(h, oph);
+		}
+		break;
+	default:
+		return false;
+	}
+
+	*hash = h;
+	return true;
 }
 
-DLL_EXPORT_SYM enum ocrpt_result_type ocrpt_result_get_type(ocrpt_result *result) {
-	if (!result)
-		return OCRPT_RESULT_ERROR;
+static bool ocrpt_expr_share_equal(ocrpt_expr *a, ocrpt_expr *b) {
+	ocrpt_result *ra = a->result[0], *rb = b->result[0];
+	int32_t i;
 
-	return result->type;
-}
+	if (a->type != b->type)
+		return false;
 
-DLL_EXPORT_SYM bool ocrpt_result_isnull(ocrpt_result *result) {
-	if (!result)
+	switch (a->type) {
+	case OCRPT_EXPR_STRING:
+		if (ra->isnull || rb->isnull)
+			return ra->isnull == rb->isnull;
+		if (!ra->string || !rb->string)
+			return ra->string == rb->string;
+		return ra->string->len == rb->string->len && memcmp(ra->string->str, rb->string->str, ra->string->len) == 0;
+	case OCRPT_EXPR_NUMBER:
+		if (ra->isnull || rb->isnull)
+			return ra->isnull == rb->isnull;
+		if (!ra->number_initialized || !rb->number_initialized)
+			return ra == rb;
+		return mpfr_equal_p(ra->number, rb->number);
+	case OCRPT_EXPR_DATETIME:
+		return ra == rb;
+	case OCRPT_EXPR_IDENT:
+		for (i = 0; i < OCRPT_EXPR_RESULTS; i++)
+			if (a->result[i] != b->result[i])
+				return false;
 		return true;
-
-	return result->isnull;
+	case OCRPT_EXPR_VVAR:
+		return a->var == b->var;
+	case OCRPT_EXPR:
+		if (a->func != b->func || a->n_ops != b->n_ops || a->q != b->q || a->br != b->br)
+			return false;
+		for (i = 0; i < a->n_ops; i++)
+			if (!ocrpt_expr_share_equal(a->ops[i], b->ops[i]))
+				return false;
+		return true;
+	default:
+		return false;
+	}
 }
 
-DLL_EXPORT_SYM void ocrpt_result_set_isnull(ocrpt_result *result, bool isnull) {
-	if (!result)
-		return;
+static ocrpt_expr *ocrpt_expr_share_lookup(struct ocrpt_expr_share_table *t, ocrpt_expr *e, uint32_t hash) {
+	uint32_t i;
 
-	result->isnull = isnull;
-}
+	for (i = hash & t->mask; t->nodes[i]; i = (i + 1) & t->mask) {
+		if (t->hashes[i] == hash && ocrpt_expr_share_equal(t->nodes[i], e))
+			return t->nodes[i];
+	}
 
-DLL_EXPORT_SYM bool ocrpt_result_isnumber(ocrpt_result *result) {
-	if (!result)
-		return false;
+	t->nodes[i] = e;
+	t->hashes[i] = hash;
 
-	return result->type == OCRPT_RESULT_NUMBER && result->number_initialized;
+	return e;
 }
 
-DLL_EXPORT_SYM mpfr_ptr ocrpt_result_get_number(ocrpt_result *result) {
-	if (!result || result->isnull || result->type != OCRPT_RESULT_NUMBER || !result->number_initialized)
-		return NULL;
+static void ocrpt_expr_share_node(ocrpt_expr *e, ocrpt_expr *shared) {
+	int32_t i;
 
-	return result->number;
+	for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
+		if (ocrpt_expr_get_result_owned(e, i))
+			ocrpt_result_free(e->result[i]);
+		e->result[i] = NULL;
+		ocrpt_expr_set_result_owned(e, i, false);
+	}
+	e->shared = shared;
+
+	if (!shared->shared) {
+		shared->shared = shared;
+		for (i = 0; i < OCRPT_EXPR_RESULTS; i++)
+			ocrpt_expr_set_result_evaluated(shared, i, false);
+	}
 }
 
-DLL_EXPORT_SYM ocrpt_string *ocrpt_result_get_number_as_string(ocrpt_result *result, const char *format) {
-	if (!result || result->isnull || result->type != OCRPT_RESULT_NUMBER || !result->number_initialized)
-		return NULL;
+static void ocrpt_expr_share_worker(ocrpt_expr *e, ocrpt_expr *orig_e, struct ocrpt_expr_share_table *t, bool *found) {
+	uint32_t hash;
+	int32_t i;
 
-	if (!format)
-		format = "%RF";
+	if (e->type != OCRPT_EXPR)
+		return;
 
-	size_t len = mpfr_snprintf(NULL, 0, format, result->number);
-	ocrpt_string *s = ocrpt_mem_string_new_with_len("", len + 1);
-	mpfr_snprintf(s->str, s->len, "%RF", result->number);
+	if (e != orig_e && ocrpt_expr_share_hash(e, &hash)) {
+		ocrpt_expr *shared = ocrpt_expr_share_lookup(t, e, hash);
 
-	return s;
-}
+		if (shared != e) {
+			ocrpt_expr_share_node(e, shared);
+			*found = true;
+			return;
+		}
+	}
 
-DLL_EXPORT_SYM void ocrpt_result_set_long(ocrpt_result *result, long value) {
-	if (!result)
+	if (e->func && e->func->next_operand)
 		return;
 
-	result->type = OCRPT_RESULT_NUMBER;
-	result->isnull = false;
-	if (!result->number_initialized) {
-		result->number_initialized = true;
-		mpfr_init2(result->number, result->o->prec);
-	}
+	for (i = 0; i < e->n_ops; i++)
+		ocrpt_expr_share_worker(e->ops[i], orig_e, t, found);
+}
 
-	mpfr_set_si(result->number, value, result->o->rndmode);
+static bool ocrpt_report_expr_shareable(ocrpt_expr *e) {
+	return e->type == OCRPT_EXPR && !e->delayed && !ocrpt_expr_get_precalculate(e);
 }
 
-DLL_EXPORT_SYM void ocrpt_result_set_double(ocrpt_result *result, double value) {
-	if (!result)
+void ocrpt_report_share_expressions(ocrpt_report *r) {
+	struct ocrpt_expr_share_table t;
+	ocrpt_list *ptr;
+	uint32_t size = 1, nodes = 0, i;
+	bool found = false;
+
+	if (!r)
 		return;
 
-	result->type = OCRPT_RESULT_NUMBER;
-	result->isnull = false;
-	if (!result->number_initialized) {
-		result->number_initialized = true;
-		mpfr_init2(result->number, result->o->prec);
-	}
+	ocrpt_report_unshare_expressions(r);
 
-	mpfr_set_d(result->number, value, result->o->rndmode);
-}
+	for (ptr = r->exprs; ptr; ptr = ptr->next) {
+		ocrpt_expr *e = (ocrpt_expr *)ptr->data;
+
+		if (ocrpt_report_expr_shareable(e))
+			nodes += ocrpt_expr_nodes(e);
+	}
+
+	if (!nodes)
+		return;
+
+	while (size < 2 * nodes)
+		size <<= 1;
+
+	t.nodes = ocrpt_mem_malloc(size * sizeof(ocrpt_expr *));
+	t.hashes = ocrpt_mem_malloc(size * sizeof(uint32_t));
+	t.mask = size - 1;
+
+	if (!t.nodes || !t.hashes) {
+		ocrpt_mem_free(t.nodes);
+		ocrpt_mem_free(t.hashes);
+		return;
+	}
+
+	memset(t.nodes, 0, size * sizeof(ocrpt_expr *));
+
+	for (ptr = r->exprs; ptr; ptr = ptr->next) {
+		ocrpt_expr *e = (ocrpt_expr *)ptr->data;
+
+		if (ocrpt_report_expr_shareable(e))
+			ocrpt_expr_share_worker(e, e, &t, &found);
+	}
+
+	if (found) {
+		/* The programs must evaluate shared subexpressions separately. */
+		for (i = 0; i < size; i++) {
+			if (t.nodes[i] && t.nodes[i]->shared == t.nodes[i]) {
+				ocrpt_expr_compile(t.nodes[i]);
+				ocrpt_expr_deps_build(t.nodes[i]);
+			}
+		}
+
+		for (ptr = r->exprs; ptr; ptr = ptr->next) {
+			ocrpt_expr *e = (ocrpt_expr *)ptr->data;
+
+			if (ocrpt_report_expr_shareable(e)) {
+				ocrpt_expr_compile(e);
+				ocrpt_expr_deps_build(e);
+			}
+		}
+
+		r->exprs_shared = true;
+	}
+
+	ocrpt_mem_free(t.nodes);
+	ocrpt_mem_free(t.hashes);
+}
+
+static void ocrpt_expr_unshare_worker(ocrpt_expr *e) {
+	int32_t i;
+
+	if (e->type != OCRPT_EXPR)
+		return;
+
+	if (e->shared) {
+		if (e->shared != e) {
+			for (i = 0; i < OCRPT_EXPR_RESULTS; i++)
+				if (!ocrpt_expr_get_result_owned(e, i))
+					e->result[i] = NULL;
+			e->shared = NULL;
+			return;
+		}
+
+		ocrpt_expr_program_free(e);
+		ocrpt_mem_free(e->deps);
+		e->deps = NULL;
+		e->shared = NULL;
+	}
+
+	for (i = 0; i < e->n_ops; i++)
+		ocrpt_expr_unshare_worker(e->ops[i]);
+}
+
+void ocrpt_report_unshare_expressions(ocrpt_report *r) {
+	ocrpt_list *ptr;
+
+	if (!r || !r->exprs_shared)
+		return;
+
+	for (ptr = r->exprs; ptr; ptr = ptr->next) {
+		ocrpt_expr *e = (ocrpt_expr *)ptr->data;
+
+		ocrpt_expr_unshare_worker(e);
+		if (e->program)
+			ocrpt_expr_compile(e);
+		ocrpt_expr_deps_build(e);
+	}
+
+	r->exprs_shared = false;
+}
+
+/*
+ * Collect the query columns an expression depends on.
+ *
+ * Returns false if the expression depends on anything else
+ * that may change between rows: r. and v. variables, volatile
+ * functions or shared subexpressions, which are evaluated
+ * on behalf of other expressions, too.
+ */
+static bool ocrpt_expr_deps_collect(ocrpt_expr *e, ocrpt_expr *orig_e, struct ocrpt_expr_deps *deps) {
+	ocrpt_query *q;
+	uint32_t i;
+
+	switch (e->type) {
+	case OCRPT_EXPR_STRING:
+	case OCRPT_EXPR_NUMBER:
+	case OCRPT_EXPR_DATETIME:
+		return true;
+	case OCRPT_EXPR_IDENT:
+		q = e->q;
+		if (!q || !q->result)
+			return false;
+		for (i = 0; i < OCRPT_EXPR_RESULTS; i++) {
+			ocrpt_query_result *qr = (ocrpt_query_result *)((char *)e->result[i] - offsetof(ocrpt_query_result, result));
+
+			if (!e->result[i] || qr < q->result || qr >= q->result + OCRPT_EXPR_RESULTS * q->cols)
+				return false;
+		}
+		for (i = 0; i < deps->n_idents; i++)
+			if (deps->idents[i]->result[0] == e->result[0])
+				return true;
+		deps->idents[deps->n_idents++] = e;
+		return true;
+	case OCRPT_EXPR:
+		if (e != orig_e && e->shared)
+			return false;
+		if (!e->func || !e->func->func || ocrpt_function_is_volatile(e->func))
+			return false;
+		for (i = 0; i < e->n_ops; i++)
+			if (!ocrpt_expr_deps_collect(e->ops[i], orig_e, deps))
+				return false;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ocrpt_expr_deps_build(ocrpt_expr *e) {
+	struct ocrpt_expr_deps *deps;
+
+	if (!e)
+		return;
+
+	ocrpt_mem_free(e->deps);
+	e->deps = NULL;
+
+	/* Plain identifiers and constants are cheaper to evaluate than to copy. */
+	if (e->type != OCRPT_EXPR || e->iterative || e->delayed)
+		return;
+
+	deps = ocrpt_mem_malloc(sizeof(struct ocrpt_expr_deps) + ocrpt_expr_nodes(e) * sizeof(ocrpt_expr *));
+	if (!deps)
+		return;
+
+	memset(deps, 0, sizeof(struct ocrpt_expr_deps));
+
+	if (!ocrpt_expr_deps_collect(e, e, deps) || !deps->n_idents) {
+		ocrpt_mem_free(deps);
+		return;
+	}
+
+	e->deps = deps;
+}
+
+DLL_EXPORT_SYM void ocrpt_expr_set_field_expr(ocrpt_expr *e, ocrpt_expr *rvalue) {
+	if (!e || (rvalue && (e->o != rvalue->o || e->r != rvalue->r)))
+		return;
+
+	e->rvalue = rvalue;
+}
+
+DLL_EXPORT_SYM ocrpt_result *ocrpt_result_new(opencreport *o) {
+	if (!o)
+		return NULL;
+
+	ocrpt_result *result = ocrpt_mem_malloc(sizeof(ocrpt_result));
+
+	memset(result, 0, sizeof(ocrpt_result));
+	result->o = o;
+
+	return result;
+}
+
+/*
+ * Internally owned results (expression result slots, delayed
+ * and precalculated results) are allocated from a per-opencreport
+ * pool instead of one by one. The pool hands out entries from
+ * slabs and recycles the released ones, so their mpfr_t limbs
+ * (at o->prec) and their string buffers are kept across reuse.
+ * The slabs are released in ocrpt_free() via ocrpt_result_pool_free().
+ */
+ocrpt_result *ocrpt_result_pool_get(opencreport *o) {
+	ocrpt_result *result;
+
+	if (!o)
+		return NULL;
+
+	if (o->result_pool_n_free)
+		result = o->result_pool_free[--o->result_pool_n_free];
+	else {
+		ocrpt_result_slab *slab = o->result_slabs;
+
+		if (!slab || slab->used == OCRPT_RESULT_SLAB_SIZE) {
+			slab = ocrpt_mem_malloc(sizeof(ocrpt_result_slab));
+			if (!slab)
+				return NULL;
+			memset(slab, 0, sizeof(ocrpt_result_slab));
+			slab->next = o->result_slabs;
+			o->result_slabs = slab;
+		}
+
+		result = &slab->results[slab->used++];
+		result->o = o;
+		result->pooled = true;
+	}
+
+	if (!result->number_initialized) {
+		mpfr_init2(result->number, o->prec);
+		result->number_initialized = true;
+	} else if (mpfr_get_prec(result->number) != o->prec)
+		mpfr_set_prec(result->number, o->prec);
+
+	return result;
+}
+
+void ocrpt_result_pool_put(ocrpt_result *result) {
+	opencreport *o = result->o;
+
+	/* Only owned string buffers can be reused */
+	if (result->string) {
+		if (result->string_owned && !ocrpt_mem_string_is_view(result->string)) {
+			result->string->len = 0;
+			result->string->str[0] = 0;
+		} else {
+			ocrpt_mem_string_free(result->string, result->string_owned);
+			result->string = NULL;
+		}
+	}
+
+	memset(&result->datetime, 0, sizeof(result->datetime));
+	result->type = OCRPT_RESULT_STRING;
+	result->orig_type = OCRPT_RESULT_STRING;
+	result->date_valid = false;
+	result->time_valid = false;
+	result->interval = false;
+	result->isnull = false;
+	result->day_carry = 0;
+
+	if (o->result_pool_n_free == o->result_pool_free_size) {
+		uint32_t size = o->result_pool_free_size ? 2 * o->result_pool_free_size : OCRPT_RESULT_SLAB_SIZE;
+		ocrpt_result **free_list = ocrpt_mem_realloc(o->result_pool_free, size * sizeof(ocrpt_result *));
+
+		/* The entry is not reused but it's still released by ocrpt_result_pool_free() */
+		if (!free_list)
+			return;
+
+		o->result_pool_free = free_list;
+		o->result_pool_free_size = size;
+	}
+
+	o->result_pool_free[o->result_pool_n_free++] = result;
+}
+
+void ocrpt_result_pool_free(opencreport *o) {
+	ocrpt_result_slab *slab, *next;
+
+	for (slab = o->result_slabs; slab; slab = next) {
+		uint32_t i;
+
+		next = slab->next;
+		for (i = 0; i < slab->used; i++)
+			ocrpt_result_free_data(&slab->results[i]);
+		ocrpt_mem_free(slab);
+	}
+	o->result_slabs = NULL;
+
+	ocrpt_mem_free(o->result_pool_free);
+	o->result_pool_free = NULL;
+	o->result_pool_n_free = 0;
+	o->result_pool_free_size = 0;
+}
+
+DLL_EXPORT_SYM enum ocrpt_result_type ocrpt_result_get_type(ocrpt_result *result) {
+	if (!result)
+		return OCRPT_RESULT_ERROR;
+
+	return result->type;
+}
+
+DLL_EXPORT_SYM bool ocrpt_result_isnull(ocrpt_result *result) {
+	if (!result)
+		return true;
+
+	return result->isnull;
+}
+
+DLL_EXPORT_SYM void ocrpt_result_set_isnull(ocrpt_result *result, bool isnull) {
+	if (!result)
+		return;
+
+	result->isnull = isnull;
+}
+
+DLL_EXPORT_SYM bool ocrpt_result_isnumber(ocrpt_result *result) {
+	if (!result)
+		return false;
+
+	return result->type == OCRPT_RESULT_NUMBER && result->number_initialized;
+}
+
+DLL_EXPORT_SYM mpfr_ptr ocrpt_result_get_number(ocrpt_result *result) {
+	if (!result || result->isnull || result->type != OCRPT_RESULT_NUMBER || !result->number_initialized)
+		return NULL;
+
+	return result->number;
+}
+
+DLL_EXPORT_SYM ocrpt_string *ocrpt_result_get_number_as_string(ocrpt_result *result, const char *format) {
+	if (!result || result->isnull || result->type != OCRPT_RESULT_NUMBER || !result->number_initialized)
+		return NULL;
+
+	if (!format)
+		format = "%RF";
+
+	size_t len = mpfr_snprintf(NULL, 0, format, result->number);
+	ocrpt_string *s = ocrpt_mem_string_new_with_len("", len + 1);
+	mpfr_snprintf(s->str, s->len, "%RF", result->number);
+
+	return s;
+}
+
+DLL_EXPORT_SYM void ocrpt_result_set_long(ocrpt_result *result, long value) {
+	if (!result)
+		return;
+
+	result->type = OCRPT_RESULT_NUMBER;
+	result->isnull = false;
+	if (!result->number_initialized) {
+		result->number_initialized = true;
+		mpfr_init2(result->number, result->o->prec);
+	}
+
+	mpfr_set_si(result->number, value, result->o->rndmode);
+}
+
+DLL_EXPORT_SYM void ocrpt_result_set_double(ocrpt_result *result, double value) {
+	if (!result)
+		return;
+
+	result->type = OCRPT_RESULT_NUMBER;
+	result->isnull = false;
+	if (!result->number_initialized) {
+		result->number_initialized = true;
+		mpfr_init2(result->number, result->o->prec);
+	}
+
+	mpfr_set_d(result->number, value, result->o->rndmode);
+}
 
 DLL_EXPORT_SYM void ocrpt_result_set_number(ocrpt_result *result, mpfr_ptr value) {
 	if (!result)
@@ -1844,7 +3339,7 @@ static bool ocrpt_expr_is_plain_iterative_worker(ocrpt_expr *e, ocrpt_expr *orig
 		break;
 
 	case OCRPT_EXPR_RVAR:
-		if (strcmp(e->name->str, "self") == 0) {
+		if (ocrpt_expr_rvar_kind(e) == OCRPT_RVAR_SELF) {
 			bool self_is_plain = (e->var == NULL);
 			ret = ret || self_is_plain;
 		}
@@ -1882,3 +3377,547 @@ void ocrpt_expr_set_plain_iterative_to_null(ocrpt_report *r) {
 DLL_EXPORT_SYM const char *ocrpt_expr_get_expr_string(ocrpt_expr *e) {
 	return e ? e->expr_string : NULL;
 }
+
+/*
+ * Parsed expression cache
+ *
+ * Report descriptions contain the same expressions many times
+ * and the same reports are loaded over and over again by a
+ * long running process. The cache is shared by every opencreport
+ * instance in the process and it stores unresolved parse trees
+ * keyed by the expression string and the numeric precision and
+ * rounding mode the numeric constants were converted with.
+ *
+ * Instances with user defined functions bypass the cache
+ * because the parse tree depends on the set of function names.
+ *
+ * The cache outlives any opencreport instance and the
+ * allocator set by ocrpt_mem_set_alloc_funcs() may be valid
+ * only for a shorter time. So the cached trees use malloc().
+ */
+struct ocrpt_expr_template {
+	const ocrpt_function *func;
+	char *query;
+	char *name;
+	/* String constant or the exact decimal form of a numeric constant */
+	char *value;
+	size_t value_len;
+	struct ocrpt_expr_template **ops;
+	uint32_t n_ops;
+	enum ocrpt_expr_type type:4;
+	bool parenthesized:1;
+	bool dotprefixed:1;
+};
+
+struct ocrpt_parse_cache_entry {
+	char *expr_string;
+	struct ocrpt_expr_template *tmpl;
+	mpfr_prec_t prec;
+	mpfr_rnd_t rndmode;
+	uint32_t hash;
+};
+
+#define OCRPT_PARSE_CACHE_DEFAULT_SIZE (4096)
+#define OCRPT_PARSE_CACHE_MIN_SLOTS (64)
+
+static struct {
+	pthread_mutex_t mutex;
+	struct ocrpt_parse_cache_entry **slots;
+	uint32_t mask;
+	uint32_t n_entries;
+	uint32_t max_entries;
+	uint64_t hits;
+	uint64_t misses;
+} parse_cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.max_entries = OCRPT_PARSE_CACHE_DEFAULT_SIZE,
+};
+
+static void ocrpt_expr_template_free(struct ocrpt_expr_template *t) {
+	if (!t)
+		return;
+
+	for (uint32_t i = 0; i < t->n_ops; i++)
+		ocrpt_expr_template_free(t->ops[i]);
+	free(t->ops);
+	free(t->query);
+	free(t->name);
+	free(t->value);
+	free(t);
+}
+
+static struct ocrpt_expr_template *ocrpt_expr_template_new(ocrpt_expr *e) {
+	struct ocrpt_expr_template *t = calloc(1, sizeof(struct ocrpt_expr_template));
+	mpfr_exp_t exp;
+	char *digits;
+	uint32_t i;
+
+	if (!t)
+		return NULL;
+
+	t->type = e->type;
+	t->parenthesized = e->parenthesized;
+	t->dotprefixed = e->dotprefixed;
+
+	switch (e->type) {
+	case OCRPT_EXPR_STRING:
+		t->value_len = EXPR_STRING(e)->len;
+		t->value = malloc(t->value_len + 1);
+		if (!t->value)
+			goto fail;
+		memcpy(t->value, EXPR_STRING(e)->str, t->value_len);
+		t->value[t->value_len] = '\0';
+		break;
+	case OCRPT_EXPR_NUMBER:
+		if (!mpfr_number_p(EXPR_NUMERIC(e)))
+			goto fail;
+		/* Enough digits to read back the same value with the same precision */
+		digits = mpfr_get_str(NULL, &exp, 10, 0, EXPR_NUMERIC(e), MPFR_RNDN);
+		if (!digits)
+			goto fail;
+		t->value_len = strlen(digits) + 32;
+		t->value = malloc(t->value_len);
+		if (t->value)
+			t->value_len = snprintf(t->value, t->value_len, "%s0.%se%" PRId64,
+									digits[0] == '-' ? "-" : "", digits[0] == '-' ? digits + 1 : digits, (int64_t)exp);
+		mpfr_free_str(digits);
+		if (!t->value)
+			goto fail;
+		break;
+	case OCRPT_EXPR_MVAR:
+	case OCRPT_EXPR_RVAR:
+	case OCRPT_EXPR_VVAR:
+	case OCRPT_EXPR_IDENT:
+		if (e->query && !(t->query = strdup(e->query->str)))
+			goto fail;
+		if (e->name && !(t->name = strdup(e->name->str)))
+			goto fail;
+		break;
+	case OCRPT_EXPR:
+		t->func = e->func;
+		if (e->n_ops) {
+			t->ops = calloc(e->n_ops, sizeof(struct ocrpt_expr_template *));
+			if (!t->ops)
+				goto fail;
+		}
+		for (i = 0; i < e->n_ops; i++) {
+			t->n_ops = i + 1;
+			t->ops[i] = ocrpt_expr_template_new(e->ops[i]);
+			if (!t->ops[i])
+				goto fail;
+		}
+		break;
+	default:
+		/* The parser doesn't create anything else */
+		goto fail;
+	}
+
+	return t;
+
+	fail:
+	ocrpt_expr_template_free(t);
+	return NULL;
+}
+
+static ocrpt_expr *ocrpt_expr_template_instantiate(opencreport *o, ocrpt_report *r, const struct ocrpt_expr_template *t) {
+	ocrpt_expr *e = newblankexpr(o, r, t->type, t->n_ops);
+	uint32_t i;
+
+	if (!e)
+		return NULL;
+
+	e->parenthesized = t->parenthesized;
+	e->dotprefixed = t->dotprefixed;
+
+	switch (t->type) {
+	case OCRPT_EXPR_STRING:
+		ocrpt_expr_init_result(e, OCRPT_RESULT_STRING);
+		if (EXPR_STRING_OWNED(e))
+			ocrpt_mem_string_free(EXPR_STRING(e), true);
+		EXPR_STRING(e) = ocrpt_mem_string_new_with_len(t->value, t->value_len);
+		EXPR_STRING_OWNED(e) = true;
+		EXPR_NEXT_RESULT(e) = EXPR_RESULT(e);
+		EXPR_PREV_RESULT(e) = EXPR_RESULT(e);
+		break;
+	case OCRPT_EXPR_NUMBER:
+		ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
+		mpfr_set_str(EXPR_NUMERIC(e), t->value, 10, MPFR_RNDN);
+		EXPR_NEXT_RESULT(e) = EXPR_RESULT(e);
+		EXPR_PREV_RESULT(e) = EXPR_RESULT(e);
+		break;
+	case OCRPT_EXPR:
+		e->func = t->func;
+		for (i = 0; i < t->n_ops; i++) {
+			e->ops[i] = ocrpt_expr_template_instantiate(o, r, t->ops[i]);
+			if (!e->ops[i]) {
+				e->n_ops = i;
+				ocrpt_expr_free(e);
+				return NULL;
+			}
+		}
+		break;
+	default:
+		e->query = t->query ? ocrpt_mem_string_new(t->query, true) : NULL;
+		e->name = t->name ? ocrpt_mem_string_new(t->name, true) : NULL;
+		break;
+	}
+
+	return e;
+}
+
+static uint32_t ocrpt_parse_cache_hash(const char *expr_string, mpfr_prec_t prec, mpfr_rnd_t rndmode) {
+	uint32_t hash = 0;
+
+	for (const char *c = expr_string; *c; c++)
+		hash = hash * 31 + (unsigned char)*c;
+
+	hash = ocrpt_expr_hash_add(hash, prec);
+	return ocrpt_expr_hash_add(hash, rndmode);
+}
+
+/* Must be called with the cache mutex held */
+static uint32_t ocrpt_parse_cache_find(const char *expr_string, mpfr_prec_t prec, mpfr_rnd_t rndmode, uint32_t hash) {
+	uint32_t i;
+
+	for (i = hash & parse_cache.mask; parse_cache.slots[i]; i = (i + 1) & parse_cache.mask) {
+		struct ocrpt_parse_cache_entry *ce = parse_cache.slots[i];
+
+		if (ce->hash == hash && ce->prec == prec && ce->rndmode == rndmode && strcmp(ce->expr_string, expr_string) == 0)
+			break;
+	}
+
+	return i;
+}
+
+/* Must be called with the cache mutex held */
+static void ocrpt_parse_cache_clear_locked(void) {
+	if (parse_cache.slots) {
+		for (uint32_t i = 0; i <= parse_cache.mask; i++) {
+			struct ocrpt_parse_cache_entry *ce = parse_cache.slots[i];
+
+			if (!ce)
+				continue;
+
+			ocrpt_expr_template_free(ce->tmpl);
+			free(ce->expr_string);
+			free(ce);
+		}
+		free(parse_cache.slots);
+	}
+
+	parse_cache.slots = NULL;
+	parse_cache.mask = 0;
+	parse_cache.n_entries = 0;
+}
+
+/* Must be called with the cache mutex held */
+static bool ocrpt_parse_cache_grow(void) {
+	uint32_t n_slots = parse_cache.slots ? (parse_cache.mask + 1) * 2 : OCRPT_PARSE_CACHE_MIN_SLOTS;
+	struct ocrpt_parse_cache_entry **old_slots = parse_cache.slots;
+	uint32_t old_mask = parse_cache.mask;
+
+	parse_cache.slots = calloc(n_slots, sizeof(struct ocrpt_parse_cache_entry *));
+	if (!parse_cache.slots) {
+		parse_cache.slots = old_slots;
+		return false;
+	}
+	parse_cache.mask = n_slots - 1;
+
+	if (old_slots) {
+		for (uint32_t i = 0; i <= old_mask; i++) {
+			struct ocrpt_parse_cache_entry *ce = old_slots[i];
+			uint32_t j;
+
+			if (!ce)
+				continue;
+
+			for (j = ce->hash & parse_cache.mask; parse_cache.slots[j]; j = (j + 1) & parse_cache.mask)
+				;
+			parse_cache.slots[j] = ce;
+		}
+		free(old_slots);
+	}
+
+	return true;
+}
+
+ocrpt_expr *ocrpt_expr_parse_cache_get(opencreport *o, ocrpt_report *r, const char *expr_string) {
+	ocrpt_expr *e = NULL;
+
+	if (o->n_functions)
+		return NULL;
+
+	pthread_mutex_lock(&parse_cache.mutex);
+
+	if (parse_cache.max_entries) {
+		if (parse_cache.slots) {
+			uint32_t hash = ocrpt_parse_cache_hash(expr_string, o->prec, o->rndmode);
+			uint32_t i = ocrpt_parse_cache_find(expr_string, o->prec, o->rndmode, hash);
+
+			if (parse_cache.slots[i])
+				e = ocrpt_expr_template_instantiate(o, r, parse_cache.slots[i]->tmpl);
+		}
+
+		if (e)
+			parse_cache.hits++;
+		else
+			parse_cache.misses++;
+	}
+
+	pthread_mutex_unlock(&parse_cache.mutex);
+
+	return e;
+}
+
+void ocrpt_expr_parse_cache_add(opencreport *o, const char *expr_string, ocrpt_expr *e) {
+	struct ocrpt_expr_template *tmpl;
+	struct ocrpt_parse_cache_entry *ce;
+	uint32_t hash, i;
+
+	if (o->n_functions)
+		return;
+
+	tmpl = ocrpt_expr_template_new(e);
+	if (!tmpl)
+		return;
+
+	ce = malloc(sizeof(struct ocrpt_parse_cache_entry));
+	if (!ce) {
+		ocrpt_expr_template_free(tmpl);
+		return;
+	}
+
+	ce->expr_string = strdup(expr_string);
+	if (!ce->expr_string) {
+		ocrpt_expr_template_free(tmpl);
+		free(ce);
+		return;
+	}
+
+	ce->tmpl = tmpl;
+	ce->prec = o->prec;
+	ce->rndmode = o->rndmode;
+	ce->hash = hash = ocrpt_parse_cache_hash(expr_string, o->prec, o->rndmode);
+
+	pthread_mutex_lock(&parse_cache.mutex);
+
+	/* Keep the hash table at most half full */
+	if (parse_cache.n_entries < parse_cache.max_entries &&
+			(parse_cache.slots || ocrpt_parse_cache_grow()) &&
+			(2 * (parse_cache.n_entries + 1) <= parse_cache.mask + 1 || ocrpt_parse_cache_grow())) {
+		i = ocrpt_parse_cache_find(expr_string, ce->prec, ce->rndmode, hash);
+
+		if (!parse_cache.slots[i]) {
+			parse_cache.slots[i] = ce;
+			parse_cache.n_entries++;
+			ce = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&parse_cache.mutex);
+
+	if (ce) {
+		ocrpt_expr_template_free(ce->tmpl);
+		free(ce->expr_string);
+		free(ce);
+	}
+}
+
+DLL_EXPORT_SYM void ocrpt_expr_parse_cache_set_size(uint32_t max_entries) {
+	pthread_mutex_lock(&parse_cache.mutex);
+
+	parse_cache.max_entries = max_entries;
+	if (parse_cache.n_entries > max_entries)
+		ocrpt_parse_cache_clear_locked();
+
+	pthread_mutex_unlock(&parse_cache.mutex);
+}
+
+DLL_EXPORT_SYM uint32_t ocrpt_expr_parse_cache_get_size(void) {
+	uint32_t max_entries;
+
+	pthread_mutex_lock(&parse_cache.mutex);
+	max_entries = parse_cache.max_entries;
+	pthread_mutex_unlock(&parse_cache.mutex);
+
+	return max_entries;
+}
+
+DLL_EXPORT_SYM void ocrpt_expr_parse_cache_get_stats(uint64_t *hits, uint64_t *misses, uint32_t *entries) {
+	pthread_mutex_lock(&parse_cache.mutex);
+
+	if (hits)
+		*hits = parse_cache.hits;
+	if (misses)
+		*misses = parse_cache.misses;
+	if (entries)
+		*entries = parse_cache.n_entries;
+
+	pthread_mutex_unlock(&parse_cache.mutex);
+}
+
+DLL_EXPORT_SYM void ocrpt_expr_parse_cache_clear(void) {
+	pthread_mutex_lock(&parse_cache.mutex);
+
+	ocrpt_parse_cache_clear_locked();
+	parse_cache.hits = 0;
+	parse_cache.misses = 0;
+
+	pthread_mutex_unlock(&parse_cache.mutex);
+}
+
+static uint32_t ocrpt_eval_cache_hash(const char *expr_string) {
+	uint32_t hash = 0;
+
+	for (const char *c = expr_string; *c; c++)
+		hash = hash * 31 + (unsigned char)*c;
+
+	return hash;
+}
+
+static void ocrpt_eval_cache_expr_free(ocrpt_expr *e) {
+	/*
+	 * The expression is only on the global list,
+	 * and it's never shared with report expressions.
+	 */
+	e->o->exprs = ocrpt_list_end_remove(e->o->exprs, &e->o->exprs_last, e);
+	ocrpt_expr_free_internal(e, false);
+}
+
+static void ocrpt_eval_cache_flush(struct ocrpt_eval_cache *cache) {
+	for (uint32_t i = 0; i < OCRPT_EVAL_CACHE_SIZE; i++) {
+		struct ocrpt_eval_cache_entry *ce = &cache->entries[i];
+
+		if (!ce->e)
+			continue;
+
+		if (ce->busy)
+			ce->stale = true;
+		else {
+			ocrpt_eval_cache_expr_free(ce->e);
+			memset(ce, 0, sizeof(struct ocrpt_eval_cache_entry));
+		}
+	}
+}
+
+void ocrpt_eval_cache_free(struct ocrpt_eval_cache *cache) {
+	if (!cache)
+		return;
+
+	for (uint32_t i = 0; i < OCRPT_EVAL_CACHE_SIZE; i++)
+		if (cache->entries[i].e)
+			ocrpt_eval_cache_expr_free(cache->entries[i].e);
+
+	ocrpt_mem_free(cache);
+}
+
+/*
+ * Return the parsed and resolved form of an expression string
+ * for eval(). It must be released with ocrpt_eval_cache_release().
+ * Returns NULL and sets *err if the expression can't be parsed.
+ */
+ocrpt_expr *ocrpt_eval_cache_get(opencreport *o, ocrpt_report *r, const char *expr_string, char **err) {
+	struct ocrpt_eval_cache **cachep = r ? &r->eval_cache : &o->eval_cache;
+	struct ocrpt_eval_cache *cache = *cachep;
+	struct ocrpt_eval_cache_entry *entry = NULL;
+	uint32_t hash = ocrpt_eval_cache_hash(expr_string), i;
+	ocrpt_expr *e;
+
+	if (cache && cache->epoch != o->resolve_epoch) {
+		ocrpt_eval_cache_flush(cache);
+		cache->epoch = o->resolve_epoch;
+	}
+
+	if (cache) {
+		for (i = 0; i < OCRPT_EVAL_CACHE_SIZE; i++) {
+			struct ocrpt_eval_cache_entry *ce = &cache->entries[i];
+
+			if (ce->e && !ce->stale && ce->hash == hash && strcmp(ce->e->expr_string, expr_string) == 0) {
+				ce->busy++;
+				ce->last_used = ++cache->clock;
+				return ce->e;
+			}
+		}
+	}
+
+	if (r) {
+		/* Keep it off the report's list, it's freed with the cache */
+		bool dont_add_exprs = r->dont_add_exprs;
+
+		r->dont_add_exprs = true;
+		e = ocrpt_report_expr_parse(r, expr_string, err);
+		r->dont_add_exprs = dont_add_exprs;
+	} else
+		e = ocrpt_expr_parse(o, expr_string, err);
+
+	if (!e || (err && *err)) {
+		if (e)
+			ocrpt_eval_cache_expr_free(e);
+		return NULL;
+	}
+
+	/*
+	 * Same as ocrpt_expr_optimize() but the expression is not
+	 * shared, so the report's expressions are left shared.
+	 */
+	ocrpt_expr_resolve_worker(e, NULL, e, NULL, 0, false, NULL);
+	ocrpt_expr_optimize_worker(e);
+	ocrpt_expr_compile(e);
+	ocrpt_expr_deps_build(e);
+
+	if (!cache) {
+		cache = ocrpt_mem_malloc(sizeof(struct ocrpt_eval_cache));
+		if (!cache)
+			return e;
+		memset(cache, 0, sizeof(struct ocrpt_eval_cache));
+		cache->epoch = o->resolve_epoch;
+		*cachep = cache;
+	}
+
+	/* Use an empty entry or replace the least recently used one */
+	for (i = 0; i < OCRPT_EVAL_CACHE_SIZE; i++) {
+		struct ocrpt_eval_cache_entry *ce = &cache->entries[i];
+
+		if (!ce->e) {
+			entry = ce;
+			break;
+		}
+		if (!ce->busy && (!entry || ce->last_used < entry->last_used))
+			entry = ce;
+	}
+
+	if (entry) {
+		if (entry->e)
+			ocrpt_eval_cache_expr_free(entry->e);
+		entry->e = e;
+		entry->hash = hash;
+		entry->busy = 1;
+		entry->stale = false;
+		entry->last_used = ++cache->clock;
+	}
+
+	return e;
+}
+
+void ocrpt_eval_cache_release(opencreport *o, ocrpt_report *r, ocrpt_expr *e) {
+	struct ocrpt_eval_cache *cache = r ? r->eval_cache : o->eval_cache;
+
+	if (cache) {
+		for (uint32_t i = 0; i < OCRPT_EVAL_CACHE_SIZE; i++) {
+			struct ocrpt_eval_cache_entry *ce = &cache->entries[i];
+
+			if (ce->e != e)
+				continue;
+
+			ce->busy--;
+			if (ce->stale && !ce->busy) {
+				ocrpt_eval_cache_expr_free(ce->e);
+				memset(ce, 0, sizeof(struct ocrpt_eval_cache_entry));
+			}
+			return;
+		}
+	}
+
+	/* It didn't fit into the cache */
+	ocrpt_eval_cache_expr_free(e);
+}
@@ -45,6 +45,152 @@ enum ocrpt_expr_type {
 	OCRPT_EXPR,
 };
 
+/*
+ * Internal r. variables, looked up by name once
+ * so evaluation doesn't need to compare strings.
+ */
+enum ocrpt_rvar_kind {
+	OCRPT_RVAR_UNRESOLVED,
+	OCRPT_RVAR_UNKNOWN,
+	OCRPT_RVAR_SELF,
+	OCRPT_RVAR_BASEEXPR,
+	OCRPT_RVAR_IGNOREEXPR,
+	OCRPT_RVAR_INTERMEDEXPR,
+	OCRPT_RVAR_INTERMED2EXPR,
+	OCRPT_RVAR_VALUE,
+	OCRPT_RVAR_TOTPAGES,
+	OCRPT_RVAR_PAGENO,
+	OCRPT_RVAR_LINENO,
+	OCRPT_RVAR_DETAILCNT,
+	OCRPT_RVAR_FORMAT,
+	OCRPT_RVAR_MATCHED,
+};
+
+/*
+ * Instructions of a lowered (compiled) expression.
+ *
+ * Constants, resolved identifiers and m. variables
+ * need no work at evaluation time so they don't get
+ * an instruction.
+ */
+enum ocrpt_expr_opcode {
+	OCRPT_OP_CALL,
+	OCRPT_OP_LAZY_CALL,
+	OCRPT_OP_VVAR,
+	OCRPT_OP_RVAR,
+	OCRPT_OP_SHARED,
+};
+
+/*
+ * The registers of the program are the result slots of
+ * the expression nodes: every instruction computes
+ * node->result[o->residx] from the already computed
+ * result slots of the node's operands.
+ */
+struct ocrpt_expr_insn {
+	ocrpt_expr *node;
+	ocrpt_function_call func;
+	void *user_data;
+	/*
+	 * For OCRPT_OP_LAZY_CALL: end indexes of the operands' code
+	 * following this instruction, one per operand.
+	 */
+	uint32_t *op_ends;
+	enum ocrpt_expr_opcode opcode;
+};
+
+/*
+ * Post-order (operands first) instruction array
+ * of an expression tree, except for functions with
+ * lazily evaluated operands, which precede their operands.
+ */
+struct ocrpt_expr_program {
+	uint32_t n_insns;
+	struct ocrpt_expr_insn insns[];
+};
+
+/*
+ * Query columns a toplevel expression depends on.
+ * If none of them changed since the previous row,
+ * the previous result is reused.
+ */
+struct ocrpt_expr_deps {
+	/* Serial number of the row each result was computed from */
+	uint32_t serial[OCRPT_EXPR_RESULTS];
+	uint32_t n_idents;
+	ocrpt_expr *idents[];
+};
+
+/*
+ * Profiling data of a toplevel expression, see ocrpt_set_profiling().
+ * Self time excludes the time spent evaluating other toplevel
+ * expressions, e.g. the expressions of referenced variables.
+ */
+struct ocrpt_expr_profile {
+	uint64_t calls;
+	uint64_t total_ns;
+	uint64_t self_ns;
+};
+
+/*
+ * Memo of a pure function call. It keeps the results of the
+ * most recent distinct operand values in a two-way set
+ * associative table indexed by the hash of the operand values.
+ * The memo is dropped for the rest of the run if there's less
+ * than one hit per four misses after OCRPT_EXPR_MEMO_PROBE misses.
+ * Calls with string operands or results longer than
+ * OCRPT_EXPR_MEMO_MAX_STRING bytes are not memoized,
+ * hashing and copying them costs more than the call.
+ */
+#define OCRPT_EXPR_MEMO_SIZE 32
+#define OCRPT_EXPR_MEMO_PROBE 256
+#define OCRPT_EXPR_MEMO_MAX_STRING 256
+
+struct ocrpt_expr_memo_entry {
+	/* Copies of the operand values and the result */
+	ocrpt_result **ops;
+	ocrpt_result *result;
+	uint32_t hash;
+	uint32_t last_used;
+	bool used;
+};
+
+struct ocrpt_expr_memo {
+	uint64_t hits;
+	uint64_t misses;
+	/* Value of opencreport::memo_epoch when the entries were stored */
+	uint32_t epoch;
+	uint32_t n_ops;
+	/* Incremented on every hit and store for the LRU replacement */
+	uint32_t clock;
+	bool disabled;
+	struct ocrpt_expr_memo_entry entries[OCRPT_EXPR_MEMO_SIZE];
+};
+
+/*
+ * Expressions parsed and resolved by eval() for expression
+ * strings that are not constants, e.g. they come from a query
+ * column. The least recently used one is replaced if the cache
+ * is full. All of them are dropped if opencreport::resolve_epoch
+ * changes. Entries in use by a running eval() are not replaced.
+ */
+#define OCRPT_EVAL_CACHE_SIZE 32
+
+struct ocrpt_eval_cache_entry {
+	ocrpt_expr *e;
+	uint32_t hash;
+	uint32_t last_used;
+	uint32_t busy;
+	/* Invalidated while it was in use, it's freed when released */
+	bool stale;
+};
+
+struct ocrpt_eval_cache {
+	uint32_t epoch;
+	uint32_t clock;
+	struct ocrpt_eval_cache_entry entries[OCRPT_EVAL_CACHE_SIZE];
+};
+
 struct ocrpt_expr {
 	opencreport *o;
 	ocrpt_report *r;
@@ -86,8 +232,30 @@ struct ocrpt_expr {
 	 */
 	ocrpt_expr *rvalue;
 	ocrpt_expr *format;
+	/*
+	 * Lowered form of the expression tree, only set
+	 * for the toplevel expression. If it's NULL,
+	 * the expression is evaluated by walking the tree.
+	 */
+	struct ocrpt_expr_program *program;
+	/*
+	 * Common subexpression shared with other expressions of the report.
+	 * It points to the node that is evaluated on behalf of all of them,
+	 * for which it points to itself.
+	 */
+	ocrpt_expr *shared;
+	struct ocrpt_expr_deps *deps;
+	struct ocrpt_expr_profile *profile;
+	/* Compiled format string of format(), dtosf() and printf() */
+	struct ocrpt_format_program *format_program;
+	/* Memo of pure function calls */
+	struct ocrpt_expr_memo *memo;
 	unsigned int result_index;
 	enum ocrpt_expr_type type:4;
+	enum ocrpt_rvar_kind rvar_kind:4;
+	/* Result type known before evaluation, see ocrpt_expr_infer_types() */
+	enum ocrpt_result_type static_type:2;
+	bool static_type_known:1;
 	bool result_index_set:1;
 	bool result_owned0:1;
 	bool result_owned1:1;
@@ -140,10 +308,22 @@ void ocrpt_expr_resolve_exclude(ocrpt_expr *e, int32_t varref_exclude_mask);
 bool ocrpt_expr_references(ocrpt_expr *e, int32_t varref_include_mask, uint32_t *varref_vartype_mask);
 bool ocrpt_expr_reference_worker(ocrpt_expr *e, uint32_t varref_include_mask, uint32_t *varref_vartype_mask, ocrpt_list **var_list, bool indirect_vars);
 void ocrpt_expr_eval_worker(ocrpt_expr *e, ocrpt_expr *orig_e, ocrpt_var *var, uint32_t precalc_round);
+bool ocrpt_expr_compile(ocrpt_expr *e);
+void ocrpt_expr_program_free(ocrpt_expr *e);
+void ocrpt_expr_memo_free(struct ocrpt_expr_memo *memo);
+void ocrpt_expr_deps_build(ocrpt_expr *e);
 bool ocrpt_expr_get_precalculate(ocrpt_expr *e);
 void ocrpt_report_expressions_add_delayed_results(ocrpt_report *r);
+void ocrpt_report_share_expressions(ocrpt_report *r);
+void ocrpt_report_unshare_expressions(ocrpt_report *r);
 void ocrpt_expr_init_iterative_results(ocrpt_expr *e, enum ocrpt_result_type type);
 void ocrpt_expr_set_plain_iterative_to_null(ocrpt_report *r);
+void ocrpt_expr_infer_types(ocrpt_expr *e);
+ocrpt_expr *ocrpt_expr_parse_cache_get(opencreport *o, ocrpt_report *r, const char *expr_string);
+void ocrpt_expr_parse_cache_add(opencreport *o, const char *expr_string, ocrpt_expr *e);
+ocrpt_expr *ocrpt_eval_cache_get(opencreport *o, ocrpt_report *r, const char *expr_string, char **err);
+void ocrpt_eval_cache_release(opencreport *o, ocrpt_report *r, ocrpt_expr *e);
+void ocrpt_eval_cache_free(struct ocrpt_eval_cache *cache);
 
 static inline void ocrpt_expr_set_result_owned(ocrpt_expr *e, unsigned int which, bool owned) {
 	switch (which) {
@@ -224,5 +404,8 @@ static inline int ocrpt_expr_prev_residx(int residx) {
 #define EXPR_VALID_ERROR_MAYBE_UNINITIALIZED(e) ((e) && EXPR_RESULT(e) && EXPR_TYPE(e) == OCRPT_RESULT_ERROR)
 
 void ocrpt_result_free_data(ocrpt_result *r);
+ocrpt_result *ocrpt_result_pool_get(opencreport *o);
+void ocrpt_result_pool_put(ocrpt_result *result);
+void ocrpt_result_pool_free(opencreport *o);
 
 #endif
@@ -9,6 +9,8 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <limits.h>
+#include <locale.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -649,6 +651,8 @@ static ocrpt_string *ocrpt_get_next_format_string(const char *fmt, enum ocrpt_fo
 				case OCRPT_FORMAT_NONE:
 				case OCRPT_FORMAT_LITERAL:
 				case OCRPT_FORMAT_MONEY:
+				case OCRPT_FORMAT_ERROR:
+				case OCRPT_FORMAT_DATA_ERROR:
 					break;
 				}
 			}
@@ -700,30 +704,234 @@ void ocrpt_utf8backward(const char *s, int l, int *l2, int blen, int *blen2) {
 		*blen2 = i;
 }
 
-void ocrpt_format_string(opencreport *o, ocrpt_expr *e, ocrpt_string *string0, ocrpt_string *formatstring, ocrpt_expr **expr, int32_t n_expr) {
-	int32_t i, advance;
-	locale_t locale;
+static const unsigned long ocrpt_pow10[] = {
+	1UL,
+	10UL,
+	100UL,
+	1000UL,
+	10000UL,
+	100000UL,
+	1000000UL,
+	10000000UL,
+	100000000UL,
+	1000000000UL,
+#if ULONG_MAX > 0xffffffffUL
+	10000000000UL,
+	100000000000UL,
+	1000000000000UL,
+	10000000000000UL,
+	100000000000000UL,
+	1000000000000000UL,
+	10000000000000000UL,
+	100000000000000000UL,
+	1000000000000000000UL,
+#endif
+};
 
-	/* Use the specified locale, so that thousand separators, etc. work. */
-	locale = uselocale(o->locale);
+/*
+ * Fast path for "%[-0][width].precRf" conversions
+ *
+ * The number is scaled by 10^prec exactly and rounded
+ * to the nearest integer. Numbers too large for an
+ * unsigned long after scaling and exact halfway cases
+ * (where the rounding rule matters) return -1 so the
+ * caller falls back to mpfr_asprintf(). Otherwise the
+ * output is the same, including the decimal point of
+ * the current locale.
+ */
+ssize_t ocrpt_format_fixed(opencreport *o, char *buf, size_t size, mpfr_ptr number, int32_t width, int32_t prec, int32_t flags) {
+	char digits[48];
+	char point = localeconv()->decimal_point[0];
+	mpfr_prec_t tmp_prec = mpfr_get_prec(number) + 8 * sizeof(unsigned long);
+	unsigned long value, ipart;
+	int32_t ndigits, len, pad, i;
+	bool neg;
+	int cmp;
+
+	if (!mpfr_number_p(number) || !point || prec < 0 || prec >= (int32_t)(sizeof(ocrpt_pow10) / sizeof(ocrpt_pow10[0])) || width < 0 || (size_t)width >= size)
+		return -1;
+
+	if (mpfr_get_prec(o->format_tmp) < tmp_prec)
+		mpfr_set_prec(o->format_tmp, tmp_prec);
+
+	/* The product is exact in the extended precision */
+	neg = mpfr_signbit(number);
+	mpfr_mul_ui(o->format_tmp, number, ocrpt_pow10[prec], MPFR_RNDN);
+	mpfr_abs(o->format_tmp, o->format_tmp, MPFR_RNDN);
+	if (!mpfr_fits_ulong_p(o->format_tmp, MPFR_RNDU))
+		return -1;
+
+	value = mpfr_get_ui(o->format_tmp, MPFR_RNDD);
+	mpfr_sub_ui(o->format_tmp, o->format_tmp, value, MPFR_RNDN);
+	cmp = mpfr_cmp_ui_2exp(o->format_tmp, 1, -1);
+	if (cmp == 0)
+		return -1;
+	if (cmp > 0)
+		value++;
+
+	/* Digits in reverse order */
+	ndigits = 0;
+	for (i = 0; i < prec; i++) {
+		digits[ndigits++] = '0' + value % 10;
+		value /= 10;
+	}
+	if (prec)
+		digits[ndigits++] = point;
+	ipart = value;
+	do {
+		digits[ndigits++] = '0' + ipart % 10;
+		ipart /= 10;
+	} while (ipart);
+
+	len = ndigits + neg;
+	pad = (width > len ? width - len : 0);
+	if ((size_t)(len + pad) >= size)
+		return -1;
+
+	i = 0;
+	if (!(flags & (OCRPT_FORMAT_FLAG_LEFTALIGN | OCRPT_FORMAT_FLAG_0PADDED)))
+		for (; pad; pad--)
+			buf[i++] = ' ';
+	if (neg)
+		buf[i++] = '-';
+	if (!(flags & OCRPT_FORMAT_FLAG_LEFTALIGN))
+		for (; pad; pad--)
+			buf[i++] = '0';
+	while (ndigits)
+		buf[i++] = digits[--ndigits];
+	for (; pad; pad--)
+		buf[i++] = ' ';
+	buf[i] = 0;
+
+	return i;
+}
 
-	ocrpt_string *string = ocrpt_mem_string_resize(string0, 16);
-	assert(string);
+/*
+ * Check whether a number conversion of a compiled
+ * format string can use ocrpt_format_fixed()
+ */
+static void ocrpt_format_element_check_fixed(struct ocrpt_format_string_element_t *el) {
+	const char *fmt = el->string->str;
+	int32_t pos = 1, flags = 0, length = 0, prec = 0;
 
-	if (e && !e->result[o->residx]->string) {
-		EXPR_STRING(e) = string;
-		EXPR_STRING_OWNED(e) = true;
+	el->conv = '\0';
+
+	for (;; pos++) {
+		if (fmt[pos] == '-')
+			flags |= OCRPT_FORMAT_FLAG_LEFTALIGN;
+		else if (fmt[pos] == '0')
+			flags |= OCRPT_FORMAT_FLAG_0PADDED;
+		else
+			break;
 	}
-	string->len = 0;
+
+	for (; isdigit(fmt[pos]); pos++)
+		length = length * 10 + fmt[pos] - '0';
+
+	/* The precision must be explicit */
+	if (fmt[pos] != '.')
+		return;
+
+	for (pos++; isdigit(fmt[pos]); pos++)
+		prec = prec * 10 + fmt[pos] - '0';
+
+	if (fmt[pos] != 'R' || fmt[pos + 1] != 'f' || fmt[pos + 2])
+		return;
+
+	el->flags = flags;
+	el->length = length;
+	el->prec = prec;
+	el->conv = 'f';
+}
+
+void ocrpt_format_program_free(ocrpt_format_program *program) {
+	int32_t i;
+
+	if (!program)
+		return;
+
+	for (i = 0; i < program->n_elements; i++)
+		ocrpt_mem_string_free(program->elements[i].string, true);
+	ocrpt_mem_free(program->elements);
+	ocrpt_mem_free(program->types);
+	ocrpt_mem_free(program->fmt);
+	ocrpt_mem_free(program);
+}
+
+static bool ocrpt_format_program_add(ocrpt_format_program *program, int32_t type, int32_t expr_idx, ocrpt_string *string, int32_t length, bool lpadded) {
+	struct ocrpt_format_string_element_t *elements, *el;
+
+	elements = ocrpt_mem_realloc(program->elements, (program->n_elements + 1) * sizeof(struct ocrpt_format_string_element_t));
+	if (!elements) {
+		ocrpt_mem_string_free(string, true);
+		return false;
+	}
+	program->elements = elements;
+
+	el = &elements[program->n_elements++];
+	memset(el, 0, sizeof(*el));
+	el->type = type;
+	el->expr_idx = expr_idx;
+	el->string = string;
+	el->length = length;
+	el->lpadded = lpadded;
+
+	/* Literals are zero-terminated with the terminator included in len */
+	if (type == OCRPT_FORMAT_LITERAL)
+		string->len = strlen(string->str);
+	else if (type == OCRPT_FORMAT_NUMBER)
+		ocrpt_format_element_check_fixed(el);
+
+	return true;
+}
+
+static bool ocrpt_format_program_matches(ocrpt_format_program *program, ocrpt_string *formatstring, ocrpt_result **data, int32_t n_expr) {
+	int32_t i;
+
+	if (!program || program->n_expr != n_expr || program->fmt_len != formatstring->len)
+		return false;
+
+	for (i = 0; i < n_expr; i++)
+		if (program->types[i] != data[i]->type)
+			return false;
+
+	return !memcmp(program->fmt, formatstring->str, formatstring->len);
+}
+
+/*
+ * Split up the format string into literals and conversions
+ * the same way for every row. The sequence only depends on
+ * the format string and the types of the data.
+ */
+static ocrpt_format_program *ocrpt_format_program_compile(ocrpt_string *formatstring, ocrpt_result **data, int32_t n_expr) {
+	ocrpt_format_program *program = ocrpt_mem_malloc(sizeof(ocrpt_format_program));
+	int32_t i, advance;
+
+	if (!program)
+		return NULL;
+
+	memset(program, 0, sizeof(ocrpt_format_program));
+	program->fmt = ocrpt_mem_malloc(formatstring->len + 1);
+	program->types = ocrpt_mem_malloc((n_expr ? n_expr : 1) * sizeof(enum ocrpt_result_type));
+	if (!program->fmt || !program->types) {
+		ocrpt_format_program_free(program);
+		return NULL;
+	}
+
+	memcpy(program->fmt, formatstring->str, formatstring->len);
+	program->fmt[formatstring->len] = 0;
+	program->fmt_len = formatstring->len;
+	program->n_expr = n_expr;
+	for (i = 0; i < n_expr; i++)
+		program->types[i] = data[i]->type;
 
 	advance = 0;
 	for (i = 0; i < n_expr; i++) {
-		ocrpt_result *data = expr[i]->result[o->residx];
 		enum ocrpt_formatstring_type types[2] = { OCRPT_FORMAT_NONE, OCRPT_FORMAT_LITERAL };
 		int32_t type_idx;
 		bool data_handled = false;
 
-		switch (data->type) {
+		switch (data[i]->type) {
 		case OCRPT_RESULT_STRING:
 			types[0] = OCRPT_FORMAT_STRING;
 			break;
@@ -734,22 +942,15 @@ void ocrpt_format_string(opencreport *o, ocrpt_expr *e, ocrpt_string *string0, o
 			types[0] = OCRPT_FORMAT_DATETIME;
 			break;
 		case OCRPT_RESULT_ERROR:
-			if (e)
-				ocrpt_expr_make_error_result(e, data->string->str);
-			else {
-				string->len = 0;
-				ocrpt_mem_string_append(string, data->string->str);
-			}
-			return;
+			ocrpt_format_program_add(program, OCRPT_FORMAT_DATA_ERROR, i, NULL, -1, false);
+			return program;
 		}
 
 		type_idx = 0;
 		while (advance < formatstring->len && formatstring->str[advance]) {
 			ocrpt_string *tmp;
-			char *result;
 			enum ocrpt_formatstring_type type;
 			int32_t adv, length;
-			ssize_t len;
 			bool error, lpadded;
 
 			length = -1;
@@ -758,14 +959,8 @@ void ocrpt_format_string(opencreport *o, ocrpt_expr *e, ocrpt_string *string0, o
 			tmp = ocrpt_get_next_format_string(formatstring->str + advance, types[type_idx], &type, &adv, &error, &length, &lpadded);
 
 			if (error) {
-				if (e)
-					ocrpt_expr_make_error_result(e, tmp->str);
-				else {
-					string->len = 0;
-					ocrpt_mem_string_append(string, tmp->str);
-				}
-				ocrpt_mem_string_free(tmp, true);
-				return;
+				ocrpt_format_program_add(program, OCRPT_FORMAT_ERROR, i, tmp, -1, false);
+				return program;
 			}
 
 			if (types[type_idx] == type || (types[type_idx] == OCRPT_FORMAT_NUMBER && type == OCRPT_FORMAT_MONEY)) {
@@ -775,77 +970,174 @@ void ocrpt_format_string(opencreport *o, ocrpt_expr *e, ocrpt_string *string0, o
 
 			switch (type) {
 			case OCRPT_FORMAT_LITERAL:
-				if (!data_handled || i == (n_expr - 1))
-					ocrpt_mem_string_append(string, tmp->str);
-				else
-					goto end_inner_loop;
-				break;
-			case OCRPT_FORMAT_NUMBER:
-				if (!data->isnull && !mpfr_nan_p(data->number) && mpfr_asprintf(&result, tmp->str, data->number) >= 0) {
-					ocrpt_mem_string_append(string, result);
-					mpfr_free_str(result);
+				if (!data_handled || i == (n_expr - 1)) {
+					if (!ocrpt_format_program_add(program, type, -1, tmp, -1, false)) {
+						ocrpt_format_program_free(program);
+						return NULL;
+					}
+					tmp = NULL;
 				}
-				data_handled = true;
 				break;
+			case OCRPT_FORMAT_NUMBER:
 			case OCRPT_FORMAT_MONEY:
-				if (!data->isnull && !mpfr_nan_p(data->number) && (len = ocrpt_mpfr_strfmon(o, NULL, 0, tmp->str, data->number)) >= 0) {
-					result = ocrpt_mem_malloc(len + 1);
-					ocrpt_mpfr_strfmon(o, result, len, tmp->str, data->number);
-					result[len] = 0;
-					ocrpt_mem_string_append(string, result);
-					ocrpt_mem_free(result);
+			case OCRPT_FORMAT_DATETIME:
+			case OCRPT_FORMAT_STRING:
+				if (!ocrpt_format_program_add(program, type, i, tmp, length, lpadded)) {
+					ocrpt_format_program_free(program);
+					return NULL;
 				}
+				tmp = NULL;
 				data_handled = true;
 				break;
-			case OCRPT_FORMAT_DATETIME:
-				if (!data->isnull) {
-					char dt[256];
+			case OCRPT_FORMAT_NONE:
+			case OCRPT_FORMAT_ERROR:
+			case OCRPT_FORMAT_DATA_ERROR:
+				break;
+			}
 
-					strftime_l(dt, sizeof(dt), tmp->str, &data->datetime, o->locale);
-					ocrpt_mem_string_append(string, dt);
-				}
-				data_handled = true;
+			ocrpt_mem_string_free(tmp, true);
+
+			advance += adv;
+
+			if (data_handled && i != (n_expr - 1))
 				break;
-			case OCRPT_FORMAT_STRING:
-				if (!data->isnull) {
-					int32_t blen = data->string->len;
+		}
+	}
 
-					if (length > 0) {
-						int32_t slen;
-						ocrpt_utf8forward(data->string->str, length, &slen, data->string->len, &blen);
+	return program;
+}
 
-						if (lpadded) {
-							char *padstr;
-							int32_t padlen;
+static void ocrpt_format_program_run(opencreport *o, ocrpt_expr *e, ocrpt_format_program *program, ocrpt_string *string, ocrpt_result **data) {
+	int32_t i;
 
-							padlen = length - slen;
-							padstr = ocrpt_mem_malloc(padlen + 1);
-							memset(padstr, ' ', padlen);
-							padstr[padlen] = 0;
+	for (i = 0; i < program->n_elements; i++) {
+		struct ocrpt_format_string_element_t *el = &program->elements[i];
+		ocrpt_result *d = (el->expr_idx >= 0 ? data[el->expr_idx] : NULL);
+		char *result;
+		ssize_t len;
 
-							ocrpt_mem_string_append(string, padstr);
+		switch (el->type) {
+		case OCRPT_FORMAT_ERROR:
+		case OCRPT_FORMAT_DATA_ERROR: {
+			const char *error = (el->type == OCRPT_FORMAT_ERROR ? el->string->str : d->string->str);
 
-							ocrpt_mem_free(padstr);
-						}
-					}
+			if (e)
+				ocrpt_expr_make_error_result(e, error);
+			else {
+				string->len = 0;
+				ocrpt_mem_string_append(string, error);
+			}
+			return;
+		}
+		case OCRPT_FORMAT_LITERAL:
+			ocrpt_mem_string_append_len(string, el->string->str, el->string->len);
+			break;
+		case OCRPT_FORMAT_NUMBER:
+			if (!d->isnull && !mpfr_nan_p(d->number)) {
+				char buf[128];
 
-					ocrpt_mem_string_append_len(string, data->string->str, blen);
+				if (el->conv == 'f' && (len = ocrpt_format_fixed(o, buf, sizeof(buf), d->number, el->length, el->prec, el->flags)) >= 0)
+					ocrpt_mem_string_append_len(string, buf, len);
+				else if (mpfr_asprintf(&result, el->string->str, d->number) >= 0) {
+					ocrpt_mem_string_append(string, result);
+					mpfr_free_str(result);
 				}
-				data_handled = true;
-				break;
-			case OCRPT_FORMAT_NONE:
-				break;
 			}
+			break;
+		case OCRPT_FORMAT_MONEY:
+			if (!d->isnull && !mpfr_nan_p(d->number) && (len = ocrpt_mpfr_strfmon(o, NULL, 0, el->string->str, d->number)) >= 0) {
+				result = ocrpt_mem_malloc(len + 1);
+				ocrpt_mpfr_strfmon(o, result, len, el->string->str, d->number);
+				result[len] = 0;
+				ocrpt_mem_string_append(string, result);
+				ocrpt_mem_free(result);
+			}
+			break;
+		case OCRPT_FORMAT_DATETIME:
+			if (!d->isnull) {
+				char dt[256];
 
-			end_inner_loop:
-			ocrpt_mem_string_free(tmp, true);
+				strftime_l(dt, sizeof(dt), el->string->str, &d->datetime, o->locale);
+				ocrpt_mem_string_append(string, dt);
+			}
+			break;
+		case OCRPT_FORMAT_STRING:
+			if (!d->isnull) {
+				int32_t blen = d->string->len;
 
-			advance += adv;
+				if (el->length > 0) {
+					int32_t slen;
+					ocrpt_utf8forward(d->string->str, el->length, &slen, d->string->len, &blen);
 
-			if (data_handled && i != (n_expr - 1))
-				break;
+					if (el->lpadded) {
+						int32_t padlen;
+
+						for (padlen = el->length - slen; padlen > 0; padlen--)
+							ocrpt_mem_string_append_c(string, ' ');
+					}
+				}
+
+				ocrpt_mem_string_append_len(string, d->string->str, blen);
+			}
+			break;
+		case OCRPT_FORMAT_NONE:
+			break;
 		}
 	}
+}
+
+/*
+ * Format the data according to the format string.
+ * If program is not NULL, the compiled format string is kept
+ * there and it's reused as long as the format string and the
+ * data types are the same.
+ */
+void ocrpt_format_string(opencreport *o, ocrpt_expr *e, ocrpt_format_program **program, ocrpt_string *string0, ocrpt_string *formatstring, ocrpt_expr **expr, int32_t n_expr) {
+	ocrpt_result *data_static[4];
+	ocrpt_result **data = data_static;
+	ocrpt_format_program *prog;
+	locale_t locale;
+	int32_t i;
+
+	/* Use the specified locale, so that thousand separators, etc. work. */
+	locale = uselocale(o->locale);
+
+	ocrpt_string *string = ocrpt_mem_string_resize(string0, 16);
+	assert(string);
+
+	if (e && !e->result[o->residx]->string) {
+		EXPR_STRING(e) = string;
+		EXPR_STRING_OWNED(e) = true;
+	}
+	string->len = 0;
+
+	if (n_expr > (int32_t)(sizeof(data_static) / sizeof(data_static[0]))) {
+		data = ocrpt_mem_malloc(n_expr * sizeof(ocrpt_result *));
+		if (!data) {
+			uselocale(locale);
+			return;
+		}
+	}
+	for (i = 0; i < n_expr; i++)
+		data[i] = expr[i]->result[o->residx];
+
+	if (program && ocrpt_format_program_matches(*program, formatstring, data, n_expr))
+		prog = *program;
+	else {
+		prog = ocrpt_format_program_compile(formatstring, data, n_expr);
+		if (program) {
+			ocrpt_format_program_free(*program);
+			*program = prog;
+		}
+	}
+
+	if (prog)
+		ocrpt_format_program_run(o, e, prog, string, data);
+
+	if (!program)
+		ocrpt_format_program_free(prog);
+	if (data != data_static)
+		ocrpt_mem_free(data);
 
 	uselocale(locale);
 }
@@ -941,6 +1233,8 @@ void ocrpt_format_string_literal(opencreport *o, ocrpt_expr *e, ocrpt_string *st
 			break;
 		}
 		case OCRPT_FORMAT_NONE:
+		case OCRPT_FORMAT_ERROR:
+		case OCRPT_FORMAT_DATA_ERROR:
 			break;
 		}
 
@@ -15,7 +15,10 @@ enum ocrpt_formatstring_type {
 	OCRPT_FORMAT_STRING,
 	OCRPT_FORMAT_NUMBER,
 	OCRPT_FORMAT_MONEY,
-	OCRPT_FORMAT_DATETIME
+	OCRPT_FORMAT_DATETIME,
+	/* Only used in compiled format strings */
+	OCRPT_FORMAT_ERROR,
+	OCRPT_FORMAT_DATA_ERROR
 };
 
 /* Number formatstring flags */
@@ -35,19 +38,47 @@ enum ocrpt_formatstring_type {
 #define OCRPT_FORMAT_MFLAG_OMIT_CURRENCY		(0x10)	/* '!' */
 #define OCRPT_FORMAT_MFLAG_LEFTALIGN			(0x20)	/* '-' */
 
+/*
+ * An element of a compiled format string:
+ * a literal, a conversion of the data at expr_idx
+ * or an error that ends the formatting.
+ * Fixed point number conversions, i.e. "%[-0][width].precRf"
+ * are marked with conv == 'f', so they can be done without
+ * mpfr_asprintf() using the flags, length and prec fields.
+ * For string conversions, length and lpadded are
+ * the output length and the padding flag.
+ */
 struct ocrpt_format_string_element_t {
 	int32_t type;
+	int32_t expr_idx;
 	int32_t flags;
 	int32_t length;
 	int32_t prec;
 	char conv;
+	bool lpadded;
 	ocrpt_string *string;
 };
 
+/*
+ * A format string compiled for the data types
+ * of the expressions it is used with
+ */
+struct ocrpt_format_program {
+	char *fmt;
+	size_t fmt_len;
+	enum ocrpt_result_type *types;
+	int32_t n_expr;
+	int32_t n_elements;
+	struct ocrpt_format_string_element_t *elements;
+};
+typedef struct ocrpt_format_program ocrpt_format_program;
+
 void ocrpt_utf8forward(const char *s, int l, int *l2, int blen, int *blen2);
 void ocrpt_utf8backward(const char *s, int l, int *l2, int blen, int *blen2);
 
 void ocrpt_format_string_literal(opencreport *o, ocrpt_expr *e, ocrpt_string *string, ocrpt_string *formatstring, ocrpt_string *value);
-void ocrpt_format_string(opencreport *o, ocrpt_expr *e, ocrpt_string *string, ocrpt_string *formatstring, ocrpt_expr **data, int32_t n_expr);
+void ocrpt_format_string(opencreport *o, ocrpt_expr *e, ocrpt_format_program **program, ocrpt_string *string, ocrpt_string *formatstring, ocrpt_expr **data, int32_t n_expr);
+void ocrpt_format_program_free(ocrpt_format_program *program);
+ssize_t ocrpt_format_fixed(opencreport *o, char *buf, size_t size, mpfr_ptr number, int32_t width, int32_t prec, int32_t flags);
 
 #endif
@@ -14,6 +14,7 @@
 #include "ocrpt-private.h"
 #include "listutil.h"
 #include "exprutil.h"
+#include "formatting.h"
 #include "scanner.h"
 #include "parts.h"
 
@@ -60,6 +61,11 @@ DLL_EXPORT_SYM void ocrpt_result_free(ocrpt_result *r) {
 	if (!r)
 		return;
 
+	if (r->pooled) {
+		ocrpt_result_pool_put(r);
+		return;
+	}
+
 	ocrpt_result_free_data(r);
 	ocrpt_mem_free(r);
 }
@@ -69,6 +75,8 @@ void ocrpt_expr_free_internal(ocrpt_expr *e, bool free_from_list) {
 		return;
 
 	if (free_from_list) {
+		/* Other expressions of the report may use shared nodes of this one. */
+		ocrpt_report_unshare_expressions(e->r);
 		if (e->r)
 			e->r->exprs = ocrpt_list_end_remove(e->r->exprs, &e->r->exprs_last, e);
 		if (e->o)
@@ -82,9 +90,6 @@ void ocrpt_expr_free_internal(ocrpt_expr *e, bool free_from_list) {
 	case OCRPT_EXPR_ERROR:
 	case OCRPT_EXPR_STRING:
 	case OCRPT_EXPR_DATETIME:
-		for (i = 0; i < OCRPT_EXPR_RESULTS; i++)
-			if (ocrpt_expr_get_result_owned(e, i))
-				ocrpt_result_free_data(e->result[i]);
 		break;
 	case OCRPT_EXPR_MVAR:
 	case OCRPT_EXPR_RVAR:
@@ -94,14 +99,8 @@ void ocrpt_expr_free_internal(ocrpt_expr *e, bool free_from_list) {
 		ocrpt_mem_string_free(e->name, true);
 		e->query = NULL;
 		e->name = NULL;
-		for (i = 0; i < OCRPT_EXPR_RESULTS; i++)
-			if (ocrpt_expr_get_result_owned(e, i))
-				ocrpt_result_free_data(e->result[i]);
 		break;
 	case OCRPT_EXPR:
-		for (i = 0; i < OCRPT_EXPR_RESULTS; i++)
-			if (ocrpt_expr_get_result_owned(e, i))
-				ocrpt_result_free_data(e->result[i]);
 		for (i = 0; i < e->n_ops; i++)
 			ocrpt_expr_free(e->ops[i]);
 		ocrpt_mem_free(e->ops);
@@ -110,8 +109,13 @@ void ocrpt_expr_free_internal(ocrpt_expr *e, bool free_from_list) {
 
 	for (i = 0; i < OCRPT_EXPR_RESULTS; i++)
 		if (ocrpt_expr_get_result_owned(e, i))
-			ocrpt_mem_free(e->result[i]);
+			ocrpt_result_free(e->result[i]);
 	ocrpt_result_free(e->delayed_result);
+	ocrpt_mem_free(e->program);
+	ocrpt_mem_free(e->deps);
+	ocrpt_mem_free(e->profile);
+	ocrpt_format_program_free(e->format_program);
+	ocrpt_expr_memo_free(e->memo);
 	ocrpt_mem_free(e->expr_string);
 	ocrpt_mem_free(e);
 }
@@ -236,6 +240,7 @@ void ocrpt_output_free(opencreport *o, ocrpt_output *output, bool free_subexprs)
 						pango_font_description_free(le->font_description);
 					if (le->layout)
 						g_object_unref(le->layout);
+					ocrpt_format_program_free(le->format_program);
 					ocrpt_mem_string_free(le->format_str, true);
 					ocrpt_mem_string_free(le->value_str, true);
 					ocrpt_mem_string_free(le->result_str, true);
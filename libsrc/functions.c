@@ -30,7 +30,7 @@ static bool ocrpt_expr_init_result_internal(ocrpt_expr *e, enum ocrpt_result_typ
 	ocrpt_result *result = e->result[which];
 
 	if (!result) {
-		result = ocrpt_result_new(e->o);
+		result = ocrpt_result_pool_get(e->o);
 		if (result) {
 			e->result[which] = result;
 			ocrpt_expr_set_result_owned(e, which, true);
@@ -39,6 +39,12 @@ static bool ocrpt_expr_init_result_internal(ocrpt_expr *e, enum ocrpt_result_typ
 	if (result) {
 		switch (type) {
 		case OCRPT_RESULT_STRING: {
+			/* Reset a borrowed view without allocating a buffer for it */
+			if (ocrpt_mem_string_is_view(result->string)) {
+				ocrpt_mem_string_view(result->string, "", 0);
+				break;
+			}
+
 			ocrpt_string *string = ocrpt_mem_string_resize(result->string, 16);
 			if (string) {
 				if (!result->string) {
@@ -132,6 +138,74 @@ OCRPT_STATIC_FUNCTION(ocrpt_uplus) {
 		ocrpt_expr_make_error_result(e, "invalid operand(s)");
 }
 
+/*
+ * Set the result to a substring of an operand.
+ * A substring running to the end of the operand is zero-terminated,
+ * so it's returned as a borrowed view instead of a copy. The view
+ * is valid until the operand's result in the same row slot is
+ * recomputed, which also recomputes this expression.
+ */
+static void ocrpt_expr_set_substring(ocrpt_expr *e, ocrpt_string *sstring, int32_t start, int32_t len) {
+	ocrpt_string *string;
+
+	if (start + len == sstring->len) {
+		string = ocrpt_mem_string_view(EXPR_STRING(e), sstring->str + start, len);
+		if (string) {
+			if (!EXPR_STRING(e)) {
+				EXPR_STRING(e) = string;
+				EXPR_STRING_OWNED(e) = true;
+			}
+			return;
+		}
+	}
+
+	string = ocrpt_mem_string_resize(EXPR_STRING(e), len);
+	if (string) {
+		if (!EXPR_STRING(e)) {
+			EXPR_STRING(e) = string;
+			EXPR_STRING_OWNED(e) = true;
+		}
+
+		string->len = 0;
+		ocrpt_mem_string_append_len(string, sstring->str + start, len);
+	} else
+		ocrpt_expr_make_error_result(e, "out of memory");
+}
+
+/* Concatenate the non-NULL string operands into the result */
+static void ocrpt_concat_strings(ocrpt_expr *e) {
+	ocrpt_string *string;
+	int32_t len;
+	uint32_t i, nonempty;
+
+	for (len = 0, nonempty = 0, i = 0; i < e->n_ops; i++) {
+		len += EXPR_STRING_LEN(e->ops[i]);
+		if (EXPR_STRING_LEN(e->ops[i]))
+			nonempty = i;
+	}
+
+	/* At most one non-empty operand: no need to copy it */
+	if (len == EXPR_STRING_LEN(e->ops[nonempty])) {
+		ocrpt_expr_set_substring(e, EXPR_STRING(e->ops[nonempty]), 0, len);
+		return;
+	}
+
+	string = ocrpt_mem_string_resize(EXPR_STRING(e), len);
+	if (string) {
+		if (!EXPR_STRING(e)) {
+			EXPR_STRING(e) = string;
+			EXPR_STRING_OWNED(e) = true;
+		}
+
+		string->len = 0;
+		for (i = 0; i < e->n_ops; i++) {
+			ocrpt_string *sstring = EXPR_STRING(e->ops[i]);
+			ocrpt_mem_string_append_len(string, sstring->str, sstring->len);
+		}
+	} else
+		ocrpt_expr_make_error_result(e, "out of memory");
+}
+
 OCRPT_STATIC_FUNCTION(ocrpt_add) {
 	uint32_t nnum, nstr, ndt;
 
@@ -166,35 +240,16 @@ OCRPT_STATIC_FUNCTION(ocrpt_add) {
 		for (uint32_t i = 1; i < e->n_ops; i++)
 			mpfr_add(EXPR_NUMERIC(e), EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[i]), EXPR_RNDMODE(e));
 	} else if (nstr == e->n_ops) {
-		ocrpt_string *string;
-		int32_t len;
-		uint32_t i;
-
 		ocrpt_expr_init_result(e, OCRPT_RESULT_STRING);
 
-		for (i = 0; i < e->n_ops; i++) {
+		for (uint32_t i = 0; i < e->n_ops; i++) {
 			if (EXPR_ISNULL(e->ops[i])) {
 				EXPR_ISNULL(e) = true;
 				return;
 			}
 		}
 
-		for (len = 0, i = 0; i < e->n_ops; i++)
-			len += EXPR_STRING_LEN(e->ops[i]);
-
-		string = ocrpt_mem_string_resize(EXPR_STRING(e), len);
-		if (string) {
-			if (!EXPR_STRING(e)) {
-				EXPR_STRING(e) = string;
-				EXPR_STRING_OWNED(e) = true;
-			}
-			string->len = 0;
-			for (i = 0; i < e->n_ops; i++) {
-				ocrpt_string *sstring = EXPR_STRING(e->ops[i]);
-				ocrpt_mem_string_append_len(string, sstring->str, sstring->len);
-			}
-		} else
-			ocrpt_expr_make_error_result(e, "out of memory");
+		ocrpt_concat_strings(e);
 	} else if (ndt > 0 && (nnum + ndt) == e->n_ops) {
 		/*
 		 * Rules for adding datetimes/intervals and numbers are a mix
@@ -1123,6 +1178,21 @@ OCRPT_STATIC_FUNCTION(ocrpt_nulls) {
 	EXPR_ISNULL(e) = true;
 }
 
+/*
+ * Only the operand selected by the condition is evaluated.
+ * If the condition is invalid, iif() returns an error
+ * without evaluating either branch.
+ */
+static int32_t ocrpt_iif_next_operand(ocrpt_expr *e, int32_t opidx) {
+	if (opidx > 0 || e->n_ops != 3)
+		return -1;
+
+	if (!EXPR_RESULT(e->ops[0]) || EXPR_TYPE(e->ops[0]) != OCRPT_RESULT_NUMBER || EXPR_ISNULL(e->ops[0]))
+		return -1;
+
+	return mpfr_get_si(EXPR_NUMERIC(e->ops[0]), EXPR_RNDMODE(e)) ? 1 : 2;
+}
+
 OCRPT_STATIC_FUNCTION(ocrpt_iif) {
 	int32_t opidx;
 	long cond;
@@ -1292,27 +1362,20 @@ OCRPT_STATIC_FUNCTION(ocrpt_eval) {
 
 	const char *expr_str = EXPR_STRING_VAL(e->ops[0]);
 	char *err = NULL;
-	ocrpt_expr *sub;
-
-	if (e->r)
-		sub = ocrpt_report_expr_parse(e->r, expr_str, &err);
-	else
-		sub = ocrpt_expr_parse(e->o, expr_str, &err);
+	/* Repeated expression strings are parsed and resolved only once */
+	ocrpt_expr *sub = ocrpt_eval_cache_get(e->o, e->r, expr_str, &err);
 
-	if (!sub || err) {
+	if (!sub) {
 		ocrpt_expr_make_error_result(e, err ? err : "parse error");
 		ocrpt_mem_free(err);
-		ocrpt_expr_free(sub);
 		return;
 	}
-	ocrpt_mem_free(err);
 
-	ocrpt_expr_resolve_worker(sub, NULL, sub, NULL, 0, false, NULL);
 	ocrpt_expr_eval(sub);
 
 	if (!EXPR_RESULT(sub)) {
 		ocrpt_expr_make_error_result(e, "eval failed");
-		ocrpt_expr_free(sub);
+		ocrpt_eval_cache_release(e->o, e->r, sub);
 		return;
 	}
 
@@ -1337,12 +1400,10 @@ OCRPT_STATIC_FUNCTION(ocrpt_eval) {
 		break;
 	}
 
-	ocrpt_expr_free(sub);
+	ocrpt_eval_cache_release(e->o, e->r, sub);
 }
 
 OCRPT_STATIC_FUNCTION(ocrpt_concat) {
-	ocrpt_string *string;
-	int32_t len;
 	uint32_t i;
 
 	if (e->n_ops < 2) {
@@ -1366,27 +1427,10 @@ OCRPT_STATIC_FUNCTION(ocrpt_concat) {
 		}
 	}
 
-	for (len = 0, i = 0; i < e->n_ops; i++)
-		len += EXPR_STRING_LEN(e->ops[i]);
-
-	string = ocrpt_mem_string_resize(EXPR_STRING(e), len);
-	if (string) {
-		if (!EXPR_STRING(e)) {
-			EXPR_STRING(e) = string;
-			EXPR_STRING_OWNED(e) = true;
-		}
-
-		string->len = 0;
-		for (i = 0; i < e->n_ops; i++) {
-			ocrpt_string *sstring = EXPR_STRING(e->ops[i]);
-			ocrpt_mem_string_append_len(string, sstring->str, sstring->len);
-		}
-	} else
-		ocrpt_expr_make_error_result(e, "out of memory");
+	ocrpt_concat_strings(e);
 }
 
 OCRPT_STATIC_FUNCTION(ocrpt_left) {
-	ocrpt_string *string;
 	ocrpt_string *sstring;
 	int32_t l, len;
 	uint32_t i;
@@ -1415,21 +1459,10 @@ OCRPT_STATIC_FUNCTION(ocrpt_left) {
 
 	ocrpt_utf8forward(sstring->str, l, NULL, sstring->len, &len);
 
-	string = ocrpt_mem_string_resize(EXPR_STRING(e), len);
-	if (string) {
-		if (!EXPR_STRING(e)) {
-			EXPR_STRING(e) = string;
-			EXPR_STRING_OWNED(e) = true;
-		}
-
-		string->len = 0;
-		ocrpt_mem_string_append_len(string, sstring->str, len);
-	} else
-		ocrpt_expr_make_error_result(e, "out of memory");
+	ocrpt_expr_set_substring(e, sstring, 0, len);
 }
 
 OCRPT_STATIC_FUNCTION(ocrpt_right) {
-	ocrpt_string *string;
 	ocrpt_string *sstring;
 	int32_t l, start;
 	uint32_t i;
@@ -1458,21 +1491,10 @@ OCRPT_STATIC_FUNCTION(ocrpt_right) {
 
 	ocrpt_utf8backward(sstring->str, l, NULL, sstring->len, &start);
 
-	string = ocrpt_mem_string_resize(EXPR_STRING(e), sstring->len - start);
-	if (string) {
-		if (!EXPR_STRING(e)) {
-			EXPR_STRING(e) = string;
-			EXPR_STRING_OWNED(e) = true;
-		}
-
-		string->len = 0;
-		ocrpt_mem_string_append_len(string, sstring->str + start, sstring->len - start);
-	} else
-		ocrpt_expr_make_error_result(e, "out of memory");
+	ocrpt_expr_set_substring(e, sstring, start, sstring->len - start);
 }
 
 OCRPT_STATIC_FUNCTION(ocrpt_mid) {
-	ocrpt_string *string;
 	ocrpt_string *sstring;
 	int32_t ofs, l, start, len;
 	uint32_t i;
@@ -1509,17 +1531,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_mid) {
 		start = 0;
 	ocrpt_utf8forward(sstring->str + start, l, NULL, sstring->len - start, &len);
 
-	string = ocrpt_mem_string_resize(EXPR_STRING(e), len);
-	if (string) {
-		if (!EXPR_STRING(e)) {
-			EXPR_STRING(e) = string;
-			EXPR_STRING_OWNED(e) = true;
-		}
-
-		string->len = 0;
-		ocrpt_mem_string_append_len(string, sstring->str + start, len);
-	} else
-		ocrpt_expr_make_error_result(e, "out of memory");
+	ocrpt_expr_set_substring(e, sstring, start, len);
 }
 
 OCRPT_STATIC_FUNCTION(ocrpt_random) {
@@ -1568,30 +1580,94 @@ OCRPT_STATIC_FUNCTION(ocrpt_factorial) {
 	}
 }
 
+/*
+ * Number of operands of a function with lazily evaluated
+ * operands that were evaluated from left to right before
+ * calling the function.
+ */
+static uint32_t ocrpt_lazy_n_ops(ocrpt_expr *e) {
+	uint32_t n_ops = 0;
+
+	if (!e->func->next_operand)
+		return e->n_ops;
+
+	for (int32_t i = 0; i >= 0 && i < e->n_ops; i = e->func->next_operand(e, i))
+		n_ops = i + 1;
+
+	return n_ops;
+}
+
+/*
+ * For logical and bitwise and/or, a valid non-NULL number
+ * decides the result if it's zero (and) or non-zero (or).
+ * Operands after it are not evaluated.
+ */
+static inline bool ocrpt_lazy_valid_number(ocrpt_expr *op) {
+	return EXPR_RESULT(op) && EXPR_TYPE(op) == OCRPT_RESULT_NUMBER && !EXPR_ISNULL(op);
+}
+
+static int32_t ocrpt_land_next_operand(ocrpt_expr *e, int32_t opidx) {
+	ocrpt_expr *op = e->ops[opidx];
+
+	if (opidx + 1 >= e->n_ops || (ocrpt_lazy_valid_number(op) && mpfr_cmp_ui(EXPR_NUMERIC(op), 0) == 0))
+		return -1;
+
+	return opidx + 1;
+}
+
+static int32_t ocrpt_lor_next_operand(ocrpt_expr *e, int32_t opidx) {
+	ocrpt_expr *op = e->ops[opidx];
+
+	if (opidx + 1 >= e->n_ops || (ocrpt_lazy_valid_number(op) && mpfr_cmp_ui(EXPR_NUMERIC(op), 0) != 0))
+		return -1;
+
+	return opidx + 1;
+}
+
+static int32_t ocrpt_and_next_operand(ocrpt_expr *e, int32_t opidx) {
+	ocrpt_expr *op = e->ops[opidx];
+
+	if (opidx + 1 >= e->n_ops || (ocrpt_lazy_valid_number(op) && mpfr_get_uj(EXPR_NUMERIC(op), EXPR_RNDMODE(e)) == 0))
+		return -1;
+
+	return opidx + 1;
+}
+
+static int32_t ocrpt_or_next_operand(ocrpt_expr *e, int32_t opidx) {
+	ocrpt_expr *op = e->ops[opidx];
+
+	if (opidx + 1 >= e->n_ops || (ocrpt_lazy_valid_number(op) && mpfr_get_uj(EXPR_NUMERIC(op), EXPR_RNDMODE(e)) != 0))
+		return -1;
+
+	return opidx + 1;
+}
+
 OCRPT_STATIC_FUNCTION(ocrpt_land) {
 	unsigned long ret;
-	uint32_t i;
+	uint32_t i, n_ops;
 
 	if (e->n_ops < 2) {
 		ocrpt_expr_make_error_result(e, "invalid operand(s)");
 		return;
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	n_ops = ocrpt_lazy_n_ops(e);
+
+	for (i = 0; i < n_ops; i++) {
 		if (!EXPR_RESULT(e->ops[i])) {
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 			return;
 		}
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_TYPE(e->ops[i]) == OCRPT_RESULT_ERROR) {
 			ocrpt_expr_make_error_result(e, EXPR_STRING_VAL(e->ops[i]));
 			return;
 		}
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_TYPE(e->ops[i]) != OCRPT_RESULT_NUMBER) {
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 			return;
@@ -1600,7 +1676,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_land) {
 
 	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_ISNULL(e->ops[i])) {
 			EXPR_ISNULL(e) = true;
 			return;
@@ -1608,7 +1684,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_land) {
 	}
 
 	ret = (mpfr_cmp_ui(EXPR_NUMERIC(e->ops[0]), 0) != 0);
-	for (i = 1; ret && i < e->n_ops; i++) {
+	for (i = 1; ret && i < n_ops; i++) {
 		unsigned long ret1 = (mpfr_cmp_ui(EXPR_NUMERIC(e->ops[i]), 0) != 0);
 		ret = ret && ret1;
 	}
@@ -1617,28 +1693,30 @@ OCRPT_STATIC_FUNCTION(ocrpt_land) {
 
 OCRPT_STATIC_FUNCTION(ocrpt_lor) {
 	unsigned long ret;
-	uint32_t i;
+	uint32_t i, n_ops;
 
 	if (e->n_ops < 2) {
 		ocrpt_expr_make_error_result(e, "invalid operand(s)");
 		return;
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	n_ops = ocrpt_lazy_n_ops(e);
+
+	for (i = 0; i < n_ops; i++) {
 		if (!EXPR_RESULT(e->ops[i])) {
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 			return;
 		}
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_TYPE(e->ops[i]) == OCRPT_RESULT_ERROR) {
 			ocrpt_expr_make_error_result(e, EXPR_STRING_VAL(e->ops[i]));
 			return;
 		}
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_TYPE(e->ops[i]) != OCRPT_RESULT_NUMBER) {
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 			return;
@@ -1647,7 +1725,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_lor) {
 
 	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_ISNULL(e->ops[i])) {
 			EXPR_ISNULL(e) = true;
 			return;
@@ -1655,7 +1733,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_lor) {
 	}
 
 	ret = (mpfr_cmp_ui(EXPR_NUMERIC(e->ops[0]), 0) != 0);
-	for (i = 1; !ret && i < e->n_ops; i++) {
+	for (i = 1; !ret && i < n_ops; i++) {
 		unsigned long ret1 = (mpfr_cmp_ui(EXPR_NUMERIC(e->ops[i]), 0) != 0);
 		ret = ret || ret1;
 	}
@@ -1693,28 +1771,30 @@ OCRPT_STATIC_FUNCTION(ocrpt_lnot) {
 
 OCRPT_STATIC_FUNCTION(ocrpt_and) {
 	uintmax_t ret;
-	uint32_t i;
+	uint32_t i, n_ops;
 
 	if (e->n_ops < 2) {
 		ocrpt_expr_make_error_result(e, "invalid operand(s)");
 		return;
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	n_ops = ocrpt_lazy_n_ops(e);
+
+	for (i = 0; i < n_ops; i++) {
 		if (!EXPR_RESULT(e->ops[i])) {
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 			return;
 		}
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_TYPE(e->ops[i]) == OCRPT_RESULT_ERROR) {
 			ocrpt_expr_make_error_result(e, EXPR_STRING_VAL(e->ops[i]));
 			return;
 		}
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_TYPE(e->ops[i]) != OCRPT_RESULT_NUMBER) {
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 			return;
@@ -1723,7 +1803,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_and) {
 
 	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_ISNULL(e->ops[i])) {
 			EXPR_ISNULL(e) = true;
 			return;
@@ -1731,7 +1811,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_and) {
 	}
 
 	ret = mpfr_get_uj(EXPR_NUMERIC(e->ops[0]), EXPR_RNDMODE(e));
-	for (i = 1; ret && i < e->n_ops; i++) {
+	for (i = 1; ret && i < n_ops; i++) {
 		uintmax_t ret1 = mpfr_get_uj(EXPR_NUMERIC(e->ops[i]), EXPR_RNDMODE(e));
 		ret &= ret1;
 	}
@@ -1740,28 +1820,30 @@ OCRPT_STATIC_FUNCTION(ocrpt_and) {
 
 OCRPT_STATIC_FUNCTION(ocrpt_or) {
 	uintmax_t ret;
-	uint32_t i;
+	uint32_t i, n_ops;
 
 	if (e->n_ops < 2) {
 		ocrpt_expr_make_error_result(e, "invalid operand(s)");
 		return;
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	n_ops = ocrpt_lazy_n_ops(e);
+
+	for (i = 0; i < n_ops; i++) {
 		if (!EXPR_RESULT(e->ops[i])) {
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 			return;
 		}
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_TYPE(e->ops[i]) == OCRPT_RESULT_ERROR) {
 			ocrpt_expr_make_error_result(e, EXPR_STRING_VAL(e->ops[i]));
 			return;
 		}
 	}
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_TYPE(e->ops[i]) != OCRPT_RESULT_NUMBER) {
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 			return;
@@ -1770,7 +1852,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_or) {
 
 	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
 
-	for (i = 0; i < e->n_ops; i++) {
+	for (i = 0; i < n_ops; i++) {
 		if (EXPR_ISNULL(e->ops[i])) {
 			EXPR_ISNULL(e) = true;
 			return;
@@ -1778,7 +1860,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_or) {
 	}
 
 	ret = mpfr_get_uj(EXPR_NUMERIC(e->ops[0]), EXPR_RNDMODE(e));
-	for (i = 1; !ret && i < e->n_ops; i++) {
+	for (i = 1; !ret && i < n_ops; i++) {
 		uintmax_t ret1 = mpfr_get_uj(EXPR_NUMERIC(e->ops[i]), EXPR_RNDMODE(e));
 		ret |= ret1;
 	}
@@ -2482,7 +2564,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_stodt) {
 		EXPR_TIME_VALID(e) = EXPR_TIME_VALID(e->ops[0]);
 		EXPR_INTERVAL(e) = EXPR_INTERVAL(e->ops[0]);
 		EXPR_DAY_CARRY(e) = EXPR_DAY_CARRY(e->ops[0]);
-	} else if (!ocrpt_parse_datetime(e->o, EXPR_STRING_VAL(e->ops[0]), EXPR_STRING_LEN(e->ops[0]), EXPR_RESULT(e)))
+	} else if (!ocrpt_parse_datetime(e->o, EXPR_STRING_VAL(e->ops[0]), EXPR_STRING_LEN(e->ops[0]), EXPR_RESULT(e), NULL))
 		if (!ocrpt_parse_interval(e->o, EXPR_STRING_VAL(e->ops[0]), EXPR_STRING_LEN(e->ops[0]), EXPR_RESULT(e)))
 			ocrpt_expr_make_error_result(e, "invalid operand(s)");
 }
@@ -3765,7 +3847,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_format) {
 		}
 	}
 
-	ocrpt_format_string(e->o, e, EXPR_STRING(e), &formatstring, e->ops, 1);
+	ocrpt_format_string(e->o, e, &e->format_program, EXPR_STRING(e), &formatstring, e->ops, 1);
 }
 
 OCRPT_STATIC_FUNCTION(ocrpt_dtosf) {
@@ -3822,7 +3904,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_dtosf) {
 		formatstring.len = strlen(formatstring.str);
 	}
 
-	ocrpt_format_string(e->o, e, EXPR_STRING(e), &formatstring, e->ops, 1);
+	ocrpt_format_string(e->o, e, &e->format_program, EXPR_STRING(e), &formatstring, e->ops, 1);
 }
 
 OCRPT_STATIC_FUNCTION(ocrpt_printf) {
@@ -3854,7 +3936,7 @@ OCRPT_STATIC_FUNCTION(ocrpt_printf) {
 
 	ocrpt_expr_init_result(e, OCRPT_RESULT_STRING);
 
-	ocrpt_format_string(e->o, e, EXPR_STRING(e), EXPR_STRING(e->ops[0]), &e->ops[1], e->n_ops - 1);
+	ocrpt_format_string(e->o, e, &e->format_program, EXPR_STRING(e), EXPR_STRING(e->ops[0]), &e->ops[1], e->n_ops - 1);
 }
 
 OCRPT_STATIC_FUNCTION(ocrpt_xlate) {
@@ -3948,118 +4030,414 @@ OCRPT_STATIC_FUNCTION(ocrpt_prevval) {
 		ocrpt_expr_make_error_result(e, "Subexpression has no previous result");
 }
 
+/*
+ * Type-specialised variants of the most common operators.
+ *
+ * The operand types are known before evaluation, but an operand
+ * may still be NULL or an error at runtime. Such cases are handed
+ * over to the generic function, so the result is always the same.
+ */
+static inline bool ocrpt_expr_operands_typed(ocrpt_expr *e, enum ocrpt_result_type type) {
+	for (uint32_t i = 0; i < e->n_ops; i++) {
+		ocrpt_result *r = EXPR_RESULT(e->ops[i]);
+
+		if (!r || r->type != type || r->isnull)
+			return false;
+		if (type == OCRPT_RESULT_NUMBER && !r->number_initialized)
+			return false;
+		if (type == OCRPT_RESULT_STRING && !r->string)
+			return false;
+	}
+
+	return true;
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_add_number) {
+	if (e->n_ops < 2 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_NUMBER)) {
+		ocrpt_add(e, user_data);
+		return;
+	}
+
+	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
+	mpfr_set(EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[0]), EXPR_RNDMODE(e));
+	for (uint32_t i = 1; i < e->n_ops; i++)
+		mpfr_add(EXPR_NUMERIC(e), EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[i]), EXPR_RNDMODE(e));
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_sub_number) {
+	if (e->n_ops < 2 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_NUMBER)) {
+		ocrpt_sub(e, user_data);
+		return;
+	}
+
+	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
+	mpfr_set(EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[0]), EXPR_RNDMODE(e));
+	for (uint32_t i = 1; i < e->n_ops; i++)
+		mpfr_sub(EXPR_NUMERIC(e), EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[i]), EXPR_RNDMODE(e));
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_mul_number) {
+	if (e->n_ops < 2 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_NUMBER)) {
+		ocrpt_mul(e, user_data);
+		return;
+	}
+
+	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
+	mpfr_set(EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[0]), EXPR_RNDMODE(e));
+	for (uint32_t i = 1; i < e->n_ops; i++)
+		mpfr_mul(EXPR_NUMERIC(e), EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[i]), EXPR_RNDMODE(e));
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_div_number) {
+	if (e->n_ops < 2 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_NUMBER)) {
+		ocrpt_div(e, user_data);
+		return;
+	}
+
+	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
+	mpfr_set(EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[0]), EXPR_RNDMODE(e));
+	for (uint32_t i = 1; i < e->n_ops; i++)
+		mpfr_div(EXPR_NUMERIC(e), EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[i]), EXPR_RNDMODE(e));
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_uminus_number) {
+	if (e->n_ops != 1 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_NUMBER)) {
+		ocrpt_uminus(e, user_data);
+		return;
+	}
+
+	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
+	mpfr_neg(EXPR_NUMERIC(e), EXPR_NUMERIC(e->ops[0]), EXPR_RNDMODE(e));
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_add_string) {
+	if (e->n_ops < 2 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_STRING)) {
+		ocrpt_add(e, user_data);
+		return;
+	}
+
+	ocrpt_expr_init_result(e, OCRPT_RESULT_STRING);
+	ocrpt_concat_strings(e);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_concat_string) {
+	if (e->n_ops < 2 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_STRING)) {
+		ocrpt_concat(e, user_data);
+		return;
+	}
+
+	ocrpt_expr_init_result(e, OCRPT_RESULT_STRING);
+	ocrpt_concat_strings(e);
+}
+
+static inline bool ocrpt_cmp_number_typed(ocrpt_expr *e, int *cmp) {
+	if (e->n_ops != 2 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_NUMBER))
+		return false;
+
+	*cmp = mpfr_cmp(EXPR_NUMERIC(e->ops[0]), EXPR_NUMERIC(e->ops[1]));
+	return true;
+}
+
+static inline bool ocrpt_cmp_string_typed(ocrpt_expr *e, int *cmp) {
+	if (e->n_ops != 2 || !ocrpt_expr_operands_typed(e, OCRPT_RESULT_STRING))
+		return false;
+
+	*cmp = strcmp(EXPR_STRING_VAL(e->ops[0]), EXPR_STRING_VAL(e->ops[1]));
+	return true;
+}
+
+static inline void ocrpt_cmp_set_result(ocrpt_expr *e, bool ret) {
+	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
+	mpfr_set_ui(EXPR_NUMERIC(e), ret, EXPR_RNDMODE(e));
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_eq_number) {
+	int cmp;
+
+	if (ocrpt_cmp_number_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp == 0);
+	else
+		ocrpt_eq(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_eq_string) {
+	int cmp;
+
+	if (ocrpt_cmp_string_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp == 0);
+	else
+		ocrpt_eq(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_ne_number) {
+	int cmp;
+
+	if (ocrpt_cmp_number_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp != 0);
+	else
+		ocrpt_ne(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_ne_string) {
+	int cmp;
+
+	if (ocrpt_cmp_string_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp != 0);
+	else
+		ocrpt_ne(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_lt_number) {
+	int cmp;
+
+	if (ocrpt_cmp_number_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp < 0);
+	else
+		ocrpt_lt(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_lt_string) {
+	int cmp;
+
+	if (ocrpt_cmp_string_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp < 0);
+	else
+		ocrpt_lt(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_le_number) {
+	int cmp;
+
+	if (ocrpt_cmp_number_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp <= 0);
+	else
+		ocrpt_le(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_le_string) {
+	int cmp;
+
+	if (ocrpt_cmp_string_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp <= 0);
+	else
+		ocrpt_le(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_gt_number) {
+	int cmp;
+
+	if (ocrpt_cmp_number_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp > 0);
+	else
+		ocrpt_gt(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_gt_string) {
+	int cmp;
+
+	if (ocrpt_cmp_string_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp > 0);
+	else
+		ocrpt_gt(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_ge_number) {
+	int cmp;
+
+	if (ocrpt_cmp_number_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp >= 0);
+	else
+		ocrpt_ge(e, user_data);
+}
+
+OCRPT_STATIC_FUNCTION(ocrpt_ge_string) {
+	int cmp;
+
+	if (ocrpt_cmp_string_typed(e, &cmp))
+		ocrpt_cmp_set_result(e, cmp >= 0);
+	else
+		ocrpt_ge(e, user_data);
+}
+
+static const struct ocrpt_function_typed ocrpt_eq_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_eq_number },
+	{ OCRPT_RESULT_STRING, OCRPT_RESULT_NUMBER, ocrpt_eq_string },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_ne_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_ne_number },
+	{ OCRPT_RESULT_STRING, OCRPT_RESULT_NUMBER, ocrpt_ne_string },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_lt_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_lt_number },
+	{ OCRPT_RESULT_STRING, OCRPT_RESULT_NUMBER, ocrpt_lt_string },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_le_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_le_number },
+	{ OCRPT_RESULT_STRING, OCRPT_RESULT_NUMBER, ocrpt_le_string },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_gt_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_gt_number },
+	{ OCRPT_RESULT_STRING, OCRPT_RESULT_NUMBER, ocrpt_gt_string },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_ge_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_ge_number },
+	{ OCRPT_RESULT_STRING, OCRPT_RESULT_NUMBER, ocrpt_ge_string },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_add_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_add_number },
+	{ OCRPT_RESULT_STRING, OCRPT_RESULT_STRING, ocrpt_add_string },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_sub_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_sub_number },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_mul_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_mul_number },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_div_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_div_number },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_uminus_typed[] = {
+	{ OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, ocrpt_uminus_number },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
+static const struct ocrpt_function_typed ocrpt_concat_typed[] = {
+	{ OCRPT_RESULT_STRING, OCRPT_RESULT_STRING, ocrpt_concat_string },
+	{ OCRPT_RESULT_ERROR, OCRPT_RESULT_ERROR, NULL },
+};
+
 /*
  * Keep this sorted by function name because it is
  * used via bsearch()
  */
 static const ocrpt_function ocrpt_functions[] = {
-	{ "abs",		ocrpt_abs,	NULL,	1,	false,	false,	false,	false },
-	{ "acos",		ocrpt_acos,	NULL,	1,	false,	false,	false,	false },
-	{ "add",		ocrpt_add,	NULL,	-1,	true,	true,	false,	false },
-	{ "and",		ocrpt_and,	NULL,	-1,	true,	true,	false,	false },
-	{ "asin",		ocrpt_asin,	NULL,	1,	false,	false,	false,	false },
-	{ "atan",		ocrpt_atan,	NULL,	1,	false,	false,	false,	false },
-	{ "brrownum",	ocrpt_brrownum,	NULL,	1,	false,	false,	false,	true },
-	{ "ceil",		ocrpt_ceil,	NULL,	1,	false,	false,	false,	false },
-	{ "chgdateof",	ocrpt_chgdateof,	NULL,	2,	false,	false,	false,	false },
-	{ "chgtimeof",	ocrpt_chgtimeof,	NULL,	2,	false,	false,	false,	false },
-	{ "concat",		ocrpt_concat,	NULL,	-1,	false,	false,	false,	false },
-	{ "cos",		ocrpt_cos,	NULL,	1,	false,	false,	false,	false },
-	{ "cot",		ocrpt_cot,	NULL,	1,	false,	false,	false,	false },
-	{ "csc",		ocrpt_csc,	NULL,	1,	false,	false,	false,	false },
-	{ "date",		ocrpt_date,	NULL,	0,	false,	false,	false,	false },
-	{ "dateof",		ocrpt_dateof,	NULL,	1,	false,	false,	false,	false },
-	{ "day",		ocrpt_day,	NULL,	1,	false,	false,	false,	false },
-	{ "dec",		ocrpt_dec,	NULL,	1,	false,	false,	false,	false },
-	{ "dim",		ocrpt_dim,	NULL,	1,	false,	false,	false,	false },
-	{ "div",		ocrpt_div,	NULL,	-1,	false,	false,	true,	false },
-	{ "dtos",		ocrpt_dtos,	NULL,	1,	false,	false,	false,	false },
-	{ "dtosf",		ocrpt_dtosf,	NULL,	2,	false,	false,	false,	false },
-	{ "eq",			ocrpt_eq,	NULL,	2,	true,	false,	false,	false },
-	{ "error",		ocrpt_error,	NULL,	1,	false,	false,	false,	false },
-	{ "eval",		ocrpt_eval,	NULL,	1,	false,	false,	false,	false },
-	{ "exp",		ocrpt_exp,	NULL,	1,	false,	false,	false,	false },
-	{ "exp10",		ocrpt_exp10,	NULL,	1,	false,	false,	false,	false },
-	{ "exp2",		ocrpt_exp2,	NULL,	1,	false,	false,	false,	false },
-	{ "factorial",	ocrpt_factorial,	NULL,	1,	false,	false,	false,	false },
-	{ "floor",		ocrpt_floor,	NULL,	1,	false,	false,	false,	false },
-	{ "fmod",		ocrpt_fmod,	NULL,	2,	false,	false,	false,	false },
-	{ "format" ,	ocrpt_format,	NULL,	2,	false,	false,	false,	false },
-	{ "fxpval",		ocrpt_fxpval,	NULL,	2,	false,	false,	false,	false },
-	{ "ge",			ocrpt_ge,	NULL,	2,	false,	false,	false,	false },
-	{ "gettimeinsecs",	ocrpt_gettimeinsecs,	NULL,	1,	false,	false,	false,	false },
-	{ "gt",			ocrpt_gt,	NULL,	2,	false,	false,	false,	false },
-	{ "iif",		ocrpt_iif,	NULL,	3,	false,	false,	false,	false },
-	{ "inc",		ocrpt_inc,	NULL,	1,	false,	false,	false,	false },
-	{ "interval",	ocrpt_interval,	NULL,	-1,	false,	false,	false,	false },
-	{ "isdatetime",	ocrpt_isdatetime,	NULL,	1,	false,	false,	false,	false },
-	{ "iserror",	ocrpt_iserror,	NULL,	1,	false,	false,	false,	false },
-	{ "isnan",		ocrpt_isnan,	NULL,	1,	false,	false,	false,	false },
-	{ "isnull",		ocrpt_isnull,	NULL,	1,	false,	false,	false,	false },
-	{ "isnumeric",	ocrpt_isnumeric,	NULL,	1,	false,	false,	false,	false },
-	{ "isstring",	ocrpt_isstring,	NULL,	1,	false,	false,	false,	false },
-	{ "land",		ocrpt_land,	NULL,	-1,	true,	true,	false,	false },
-	{ "le",			ocrpt_le,	NULL,	2,	false,	false,	false,	false },
-	{ "left",		ocrpt_left,	NULL,	2,	false,	false,	false,	false },
-	{ "ln",			ocrpt_log,	NULL,	1,	false,	false,	false,	false },
-	{ "lnot",		ocrpt_lnot,	NULL,	1,	false,	false,	false,	false },
-	{ "log",		ocrpt_log,	NULL,	1,	false,	false,	false,	false },
-	{ "log10",		ocrpt_log10,	NULL,	1,	false,	false,	false,	false },
-	{ "log2",		ocrpt_log2,	NULL,	1,	false,	false,	false,	false },
-	{ "lor",		ocrpt_lor,	NULL,	-1,	true,	true,	false,	false },
-	{ "lower",		ocrpt_lower,	NULL,	1,	false,	false,	false,	false },
-	{ "lt",			ocrpt_lt,	NULL,	2,	false,	false,	false,	false },
-	{ "mid",		ocrpt_mid,	NULL,	3,	false,	false,	false,	false },
-	{ "mod",		ocrpt_remainder,	NULL,	2,	false,	false,	false,	false },
-	{ "month",		ocrpt_month,	NULL,	1,	false,	false,	false,	false },
-	{ "mul",		ocrpt_mul,	NULL,	-1,	true,	true,	false,	false },
-	{ "ne",			ocrpt_ne,	NULL,	2,	true,	false,	false,	false },
-	{ "not",		ocrpt_not,	NULL,	1,	false,	false,	false,	false },
-	{ "now",		ocrpt_now,	NULL,	0,	false,	false,	false,	false },
-	{ "null",		ocrpt_null,	NULL,	1,	false,	false,	false,	false },
-	{ "nulldt",		ocrpt_nulldt,	NULL,	0,	false,	false,	false,	false },
-	{ "nulln",		ocrpt_nulln,	NULL,	0,	false,	false,	false,	false },
-	{ "nulls",		ocrpt_nulls,	NULL,	0,	false,	false,	false,	false },
-	{ "or",			ocrpt_or,	NULL,	-1,	true,	true,	false,	false },
-	{ "pow",		ocrpt_pow,	NULL,	2,	false,	false,	false,	false },
-	{ "prevval",	ocrpt_prevval,	NULL,	1,	false, false, false, false },
-	{ "printf",		ocrpt_printf,	NULL,	-1,	false,	false,	false,	false },
-	{ "proper",		ocrpt_proper,	NULL,	1,	false,	false,	false,	false },
-	{ "random",		ocrpt_random,	NULL,	0,	false,	false,	false,	true },
-	{ "remainder",	ocrpt_remainder,	NULL,	2,	false,	false,	false,	false },
-	{ "right",		ocrpt_right,	NULL,	2,	false,	false,	false,	false },
-	{ "rint",		ocrpt_rint,	NULL,	1,	false,	false,	false,	false },
-	{ "round",		ocrpt_round,	NULL,	1,	false,	false,	false,	false },
-	{ "rownum",		ocrpt_rownum,	NULL,	-1,	false,	false,	false,	true },
-	{ "sec",		ocrpt_sec,	NULL,	1,	false,	false,	false,	false },
-	{ "settimeinsecs",	ocrpt_settimeinsecs,	NULL,	2,	false,	false,	false,	false },
-	{ "shl",		ocrpt_shl,	NULL,	2,	false,	false,	false,	false },
-	{ "shr",		ocrpt_shr,	NULL,	2,	false,	false,	false,	false },
-	{ "sin",		ocrpt_sin,	NULL,	1,	false,	false,	false,	false },
-	{ "sqr",		ocrpt_sqr,	NULL,	1,	false,	false,	false,	false },
-	{ "sqrt",		ocrpt_sqrt,	NULL,	1,	false,	false,	false,	false },
-	{ "stdwiy",		ocrpt_stdwiy,	NULL,	1,	false,	false,	false,	false },
-	{ "stod",		ocrpt_stodt,	NULL,	1,	false,	false,	false,	false },
-	{ "stodt",		ocrpt_stodt,	NULL,	1,	false,	false,	false,	false },
-	{ "stodtsql",	ocrpt_stodt,	NULL,	1,	false,	false,	false,	false },
-	{ "str",		ocrpt_str,	NULL,		3,	false,	false,	false,	false },
-	{ "strlen",		ocrpt_strlen,	NULL,	1,	false,	false,	false,	false },
-	{ "sub",		ocrpt_sub,	NULL,	-1,	false,	false,	false,	false },
-	{ "tan",		ocrpt_tan,	NULL,	1,	false,	false,	false,	false },
-	{ "timeof",		ocrpt_timeof,	NULL,	1,	false,	false,	false,	false },
-	{ "translate",	ocrpt_xlate,	NULL,	1,	false,	false,	false,	false },
-	{ "translate2",	ocrpt_xlate2,	NULL,	3,	false,	false,	false,	false },
-	{ "trunc",		ocrpt_trunc,	NULL,	1,	false,	false,	false,	false },
-	{ "tstod",		ocrpt_stodt,	NULL,	1,	false,	false,	false,	false },
-	{ "uminus",		ocrpt_uminus,	NULL,	1,	false,	false,	false,	false },
-	{ "uplus",		ocrpt_uplus,	NULL,	1,	false,	false,	false,	false },
-	{ "upper",		ocrpt_upper,	NULL,	1,	false,	false,	false,	false },
-	{ "val",		ocrpt_val,	NULL,	1,	false,	false,	false,	false },
-	{ "wiy",		ocrpt_wiy,	NULL,	1,	false,	false,	false,	false },
-	{ "wiy1",		ocrpt_wiy1,	NULL,	1,	false,	false,	false,	false },
-	{ "wiyo",		ocrpt_wiyo,	NULL,	2,	false,	false,	false,	false },
-	{ "xor",		ocrpt_xor,	NULL,	-1,	true,	true,	true,	false },
-	{ "year",		ocrpt_year,	NULL,	1,	false,	false,	false,	false },
+	{ "abs",		ocrpt_abs,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "acos",		ocrpt_acos,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "add",		ocrpt_add,	NULL,	-1,	true,	true,	false,	false,	true,	false,	NULL,	ocrpt_add_typed },
+	{ "and",		ocrpt_and,	NULL,	-1,	true,	true,	false,	false,	true,	false,	ocrpt_and_next_operand },
+	{ "asin",		ocrpt_asin,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "atan",		ocrpt_atan,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "brrownum",	ocrpt_brrownum,	NULL,	1,	false,	false,	false,	true,	false,	false,	NULL },
+	{ "ceil",		ocrpt_ceil,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "chgdateof",	ocrpt_chgdateof,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "chgtimeof",	ocrpt_chgtimeof,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "concat",		ocrpt_concat,	NULL,	-1,	false,	false,	false,	false,	true,	false,	NULL,	ocrpt_concat_typed },
+	{ "cos",		ocrpt_cos,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "cot",		ocrpt_cot,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "csc",		ocrpt_csc,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "date",		ocrpt_date,	NULL,	0,	false,	false,	false,	false,	false,	false,	NULL },
+	{ "dateof",		ocrpt_dateof,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "day",		ocrpt_day,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "dec",		ocrpt_dec,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "dim",		ocrpt_dim,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "div",		ocrpt_div,	NULL,	-1,	false,	false,	true,	false,	true,	false,	NULL,	ocrpt_div_typed },
+	{ "dtos",		ocrpt_dtos,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "dtosf",		ocrpt_dtosf,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "eq",			ocrpt_eq,	NULL,	2,	true,	false,	false,	false,	true,	false,	NULL,	ocrpt_eq_typed },
+	{ "error",		ocrpt_error,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "eval",		ocrpt_eval,	NULL,	1,	false,	false,	false,	false,	false,	false,	NULL },
+	{ "exp",		ocrpt_exp,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "exp10",		ocrpt_exp10,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "exp2",		ocrpt_exp2,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "factorial",	ocrpt_factorial,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "floor",		ocrpt_floor,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "fmod",		ocrpt_fmod,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "format" ,	ocrpt_format,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "fxpval",		ocrpt_fxpval,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "ge",			ocrpt_ge,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL,	ocrpt_ge_typed },
+	{ "gettimeinsecs",	ocrpt_gettimeinsecs,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "gt",			ocrpt_gt,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL,	ocrpt_gt_typed },
+	{ "iif",		ocrpt_iif,	NULL,	3,	false,	false,	false,	false,	true,	false,	ocrpt_iif_next_operand },
+	{ "inc",		ocrpt_inc,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "interval",	ocrpt_interval,	NULL,	-1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "isdatetime",	ocrpt_isdatetime,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "iserror",	ocrpt_iserror,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "isnan",		ocrpt_isnan,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "isnull",		ocrpt_isnull,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "isnumeric",	ocrpt_isnumeric,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "isstring",	ocrpt_isstring,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "land",		ocrpt_land,	NULL,	-1,	true,	true,	false,	false,	true,	false,	ocrpt_land_next_operand },
+	{ "le",			ocrpt_le,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL,	ocrpt_le_typed },
+	{ "left",		ocrpt_left,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "ln",			ocrpt_log,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "lnot",		ocrpt_lnot,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "log",		ocrpt_log,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "log10",		ocrpt_log10,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "log2",		ocrpt_log2,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "lor",		ocrpt_lor,	NULL,	-1,	true,	true,	false,	false,	true,	false,	ocrpt_lor_next_operand },
+	{ "lower",		ocrpt_lower,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "lt",			ocrpt_lt,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL,	ocrpt_lt_typed },
+	{ "mid",		ocrpt_mid,	NULL,	3,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "mod",		ocrpt_remainder,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "month",		ocrpt_month,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "mul",		ocrpt_mul,	NULL,	-1,	true,	true,	false,	false,	true,	false,	NULL,	ocrpt_mul_typed },
+	{ "ne",			ocrpt_ne,	NULL,	2,	true,	false,	false,	false,	true,	false,	NULL,	ocrpt_ne_typed },
+	{ "not",		ocrpt_not,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "now",		ocrpt_now,	NULL,	0,	false,	false,	false,	false,	false,	false,	NULL },
+	{ "null",		ocrpt_null,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "nulldt",		ocrpt_nulldt,	NULL,	0,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "nulln",		ocrpt_nulln,	NULL,	0,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "nulls",		ocrpt_nulls,	NULL,	0,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "or",			ocrpt_or,	NULL,	-1,	true,	true,	false,	false,	true,	false,	ocrpt_or_next_operand },
+	{ "pow",		ocrpt_pow,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "prevval",	ocrpt_prevval,	NULL,	1,	false, false, false, false,	false,	false,	NULL },
+	{ "printf",		ocrpt_printf,	NULL,	-1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "proper",		ocrpt_proper,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "random",		ocrpt_random,	NULL,	0,	false,	false,	false,	true,	false,	false,	NULL },
+	{ "remainder",	ocrpt_remainder,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "right",		ocrpt_right,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "rint",		ocrpt_rint,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "round",		ocrpt_round,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "rownum",		ocrpt_rownum,	NULL,	-1,	false,	false,	false,	true,	false,	false,	NULL },
+	{ "sec",		ocrpt_sec,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "settimeinsecs",	ocrpt_settimeinsecs,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "shl",		ocrpt_shl,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "shr",		ocrpt_shr,	NULL,	2,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "sin",		ocrpt_sin,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "sqr",		ocrpt_sqr,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "sqrt",		ocrpt_sqrt,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "stdwiy",		ocrpt_stdwiy,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "stod",		ocrpt_stodt,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "stodt",		ocrpt_stodt,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "stodtsql",	ocrpt_stodt,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "str",		ocrpt_str,	NULL,		3,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "strlen",		ocrpt_strlen,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "sub",		ocrpt_sub,	NULL,	-1,	false,	false,	false,	false,	true,	false,	NULL,	ocrpt_sub_typed },
+	{ "tan",		ocrpt_tan,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "timeof",		ocrpt_timeof,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "translate",	ocrpt_xlate,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "translate2",	ocrpt_xlate2,	NULL,	3,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "trunc",		ocrpt_trunc,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "tstod",		ocrpt_stodt,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "uminus",		ocrpt_uminus,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL,	ocrpt_uminus_typed },
+	{ "uplus",		ocrpt_uplus,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
+	{ "upper",		ocrpt_upper,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "val",		ocrpt_val,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "wiy",		ocrpt_wiy,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "wiy1",		ocrpt_wiy1,	NULL,	1,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "wiyo",		ocrpt_wiyo,	NULL,	2,	false,	false,	false,	false,	true,	true,	NULL },
+	{ "xor",		ocrpt_xor,	NULL,	-1,	true,	true,	true,	false,	true,	false,	NULL },
+	{ "year",		ocrpt_year,	NULL,	1,	false,	false,	false,	false,	true,	false,	NULL },
 };
 
 static int n_ocrpt_functions = sizeof(ocrpt_functions) / sizeof(ocrpt_function);
@@ -4109,6 +4487,13 @@ DLL_EXPORT_SYM bool ocrpt_function_add(opencreport *o, const char *fname,
 	new_func->associative = associative;
 	new_func->left_associative = left_associative;
 	new_func->dont_optimize = dont_optimize;
+	new_func->pure = false;
+	new_func->memoize = false;
+	new_func->next_operand = NULL;
+	new_func->typed = NULL;
+	new_func->user_defined = true;
+	new_func->profile_calls = 0;
+	new_func->profile_ns = 0;
 
 	o->functions = f_array;
 	o->functions[o->n_functions++] = new_func;
@@ -4118,6 +4503,20 @@ DLL_EXPORT_SYM bool ocrpt_function_add(opencreport *o, const char *fname,
 	return true;
 }
 
+DLL_EXPORT_SYM bool ocrpt_function_set_pure(opencreport *o, const char *fname, bool pure) {
+	if (!o || !fname || !o->functions || o->executing)
+		return false;
+
+	ocrpt_function **f = bsearch(fname, o->functions, o->n_functions, sizeof(ocrpt_function *), funccmpind);
+	if (!f)
+		return false;
+
+	(*f)->pure = pure && !(*f)->dont_optimize;
+	(*f)->memoize = (*f)->pure;
+
+	return true;
+}
+
 
 const ocrpt_function *ocrpt_function_get_internal(opencreport *o, const char *fname, bool *builtin) {
 	if (!o || !fname)
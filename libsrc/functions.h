@@ -6,6 +6,26 @@
 #ifndef _FUNCTION_H_
 #define _FUNCTION_H_
 
+/*
+ * Operand selector for functions with lazily evaluated operands.
+ * It's called after the operand "opidx" was evaluated and returns
+ * the index of the next operand to evaluate, or -1 if the rest
+ * of the operands are not needed to compute the result.
+ * Evaluation always starts with the first operand.
+ */
+typedef int32_t (*ocrpt_function_next_operand)(ocrpt_expr *e, int32_t opidx);
+
+/*
+ * Type-specialised variant of a function. It's used instead
+ * of the generic function if the static type of every operand
+ * is op_type. See ocrpt_expr_infer_types().
+ */
+struct ocrpt_function_typed {
+	enum ocrpt_result_type op_type;
+	enum ocrpt_result_type result_type;
+	ocrpt_function_call func;
+};
+
 struct ocrpt_function {
 	const char *fname;
 	ocrpt_function_call func;
@@ -15,6 +35,26 @@ struct ocrpt_function {
 	bool associative:1;
 	bool left_associative:1;
 	bool dont_optimize:1;
+	/*
+	 * The result only depends on the operand values.
+	 * Only calls of pure functions may be shared between
+	 * expressions or reused for the next row.
+	 */
+	bool pure:1;
+	/*
+	 * Computing the result of a pure function costs more than
+	 * looking it up, so the calls are memoized.
+	 * See ocrpt_expr_call_memo().
+	 */
+	bool memoize:1;
+	ocrpt_function_next_operand next_operand;
+	/* Array of type-specialised variants terminated by a NULL func */
+	const struct ocrpt_function_typed *typed;
+	/* Set for functions added by ocrpt_function_add() */
+	bool user_defined;
+	/* Profiling counters of user defined functions */
+	uint64_t profile_calls;
+	uint64_t profile_ns;
 };
 
 const ocrpt_function *ocrpt_function_get_internal(opencreport *o, const char *fname, bool *builtin);
@@ -63,6 +63,22 @@ void ocrpt_layout_compute_text(opencreport *o, ocrpt_text *le) {
 		string->len = 0;
 	}
 
+	/*
+	 * A plain string value is passed through as a view
+	 * of the value's result, instead of copying it.
+	 */
+	if (!has_format && !has_translate && has_value && EXPR_TYPE(le->value) == OCRPT_RESULT_STRING) {
+		ocrpt_string *vstring = ocrpt_mem_string_view(le->result_str, EXPR_STRING_VAL(le->value), EXPR_STRING_LEN(le->value));
+		if (vstring) {
+			le->result_str = vstring;
+			return;
+		}
+	}
+
+	/* The previous value's buffer may be gone, don't copy the old view */
+	if (ocrpt_mem_string_is_view(le->result_str))
+		ocrpt_mem_string_view(le->result_str, "", 0);
+
 	ocrpt_string *rstring = ocrpt_mem_string_resize(le->result_str, 16);
 	if (rstring) {
 		le->result_str = rstring;
@@ -76,7 +92,7 @@ void ocrpt_layout_compute_text(opencreport *o, ocrpt_text *le) {
 			uselocale(locale);
 		} else
 			ocrpt_mem_string_append_printf(fstring, "%s", EXPR_STRING_VAL(le->format));
-		ocrpt_format_string(o, NULL, rstring, fstring, &le->value, 1);
+		ocrpt_format_string(o, NULL, &le->format_program, rstring, fstring, &le->value, 1);
 	} else if (has_value) {
 		switch (EXPR_TYPE(le->value)) {
 		case OCRPT_RESULT_STRING:
@@ -92,7 +108,7 @@ void ocrpt_layout_compute_text(opencreport *o, ocrpt_text *le) {
 			break;
 		case OCRPT_RESULT_NUMBER:
 			ocrpt_mem_string_append_printf(fstring, "%s", "%d");
-			ocrpt_format_string(o, NULL, rstring, fstring, &le->value, 1);
+			ocrpt_format_string(o, NULL, &le->format_program, rstring, fstring, &le->value, 1);
 			break;
 		case OCRPT_RESULT_DATETIME:
 			if (EXPR_RESULT(le->value)->date_valid && EXPR_RESULT(le->value)->time_valid)
@@ -101,7 +117,7 @@ void ocrpt_layout_compute_text(opencreport *o, ocrpt_text *le) {
 				ocrpt_mem_string_append_printf(fstring, "%s", nl_langinfo_l(D_FMT, o->locale));
 			else if (EXPR_RESULT(le->value)->time_valid)
 				ocrpt_mem_string_append_printf(fstring, "%s", nl_langinfo_l(T_FMT, o->locale));
-			ocrpt_format_string(o, NULL, rstring, fstring, &le->value, 1);
+			ocrpt_format_string(o, NULL, &le->format_program, rstring, fstring, &le->value, 1);
 			break;
 		}
 	}
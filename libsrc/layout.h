@@ -74,6 +74,7 @@ struct ocrpt_text {
 
 	/* Shortcuts carried over between get_text_sizes() and draw_text() */
 	const char *font;
+	struct ocrpt_format_program *format_program;
 	ocrpt_string *format_str;
 	ocrpt_string *value_str;
 	ocrpt_string *result_str;
@@ -97,6 +97,27 @@ DLL_EXPORT_SYM void ocrpt_mem_set_alloc_funcs(
 	mp_set_memory_functions(ocrpt_mem_malloc0, ocrpt_mem_reallocarray0, ocrpt_mem_free_size0);
 }
 
+/*
+ * A borrowed view (see ocrpt_mem_string_view()) doesn't own its buffer.
+ * Growing it allocates a private copy instead of reallocating the
+ * borrowed buffer.
+ */
+static char *ocrpt_mem_string_realloc(ocrpt_string *string, size_t size) {
+	char *str;
+
+	if (!ocrpt_mem_string_is_view(string))
+		return ocrpt_mem_realloc(string->str, size);
+
+	str = ocrpt_mem_malloc(size > string->len ? size : string->len + 1);
+	if (!str)
+		return NULL;
+
+	memcpy(str, string->str, string->len);
+	str[string->len] = 0;
+
+	return str;
+}
+
 DLL_EXPORT_SYM ocrpt_string *ocrpt_mem_string_new(const char *str, bool copy) {
 	ocrpt_string *string = ocrpt_mem_malloc(sizeof(ocrpt_string));
 
@@ -191,7 +212,7 @@ DLL_EXPORT_SYM ocrpt_string *ocrpt_mem_string_resize(ocrpt_string *string, size_
 	if (string->allocated_len > len)
 		return string;
 
-	str = ocrpt_mem_realloc(string->str, len + 1);
+	str = ocrpt_mem_string_realloc(string, len + 1);
 	if (str) {
 		string->str = str;
 		string->allocated_len = len + 1;
@@ -208,7 +229,8 @@ DLL_EXPORT_SYM char *ocrpt_mem_string_free(ocrpt_string *string, bool free_str)
 		return NULL;
 
 	if (free_str) {
-		ocrpt_mem_free(string->str);
+		if (!ocrpt_mem_string_is_view(string))
+			ocrpt_mem_free(string->str);
 		str = NULL;
 	} else
 		str = string->str;
@@ -218,6 +240,28 @@ DLL_EXPORT_SYM char *ocrpt_mem_string_free(ocrpt_string *string, bool free_str)
 	return str;
 }
 
+DLL_EXPORT_SYM ocrpt_string *ocrpt_mem_string_view(ocrpt_string *string, const char *str, size_t len) {
+	if (!str)
+		return string;
+
+	if (!string) {
+		string = ocrpt_mem_malloc(sizeof(ocrpt_string));
+		if (!string)
+			return NULL;
+	} else if (!ocrpt_mem_string_is_view(string))
+		ocrpt_mem_free(string->str);
+
+	string->str = (char *)str;
+	string->len = len;
+	string->allocated_len = 0;
+
+	return string;
+}
+
+DLL_EXPORT_SYM bool ocrpt_mem_string_is_view(const ocrpt_string *string) {
+	return string && string->str && !string->allocated_len;
+}
+
 DLL_EXPORT_SYM void ocrpt_mem_string_append_len(ocrpt_string *string, const char *str, const size_t len) {
 	if (!string)
 		return;
@@ -227,7 +271,7 @@ DLL_EXPORT_SYM void ocrpt_mem_string_append_len(ocrpt_string *string, const char
 		return;
 
 	if (string->allocated_len < string->len + len + 1) {
-		char *strnew = ocrpt_mem_realloc(string->str, string->len + len + 1);
+		char *strnew = ocrpt_mem_string_realloc(string, string->len + len + 1);
 
 		if (!strnew)
 			return;
@@ -250,7 +294,7 @@ DLL_EXPORT_SYM void ocrpt_mem_string_append_len_binary(ocrpt_string *string, con
 		return;
 
 	if (string->allocated_len < string->len + len + 1) {
-		char *strnew = ocrpt_mem_realloc(string->str, string->len + len + 1);
+		char *strnew = ocrpt_mem_string_realloc(string, string->len + len + 1);
 
 		if (!strnew)
 			return;
@@ -281,7 +325,7 @@ DLL_EXPORT_SYM void ocrpt_mem_string_append_c(ocrpt_string *string, const char c
 		return;
 
 	if (string->allocated_len < string->len + 2) {
-		char *strnew = ocrpt_mem_realloc(string->str, string->len + 2);
+		char *strnew = ocrpt_mem_string_realloc(string, string->len + 2);
 
 		if (!strnew)
 			return;
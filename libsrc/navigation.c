@@ -138,8 +138,6 @@ static bool ocrpt_navigate_next_n_to_1(ocrpt_query *q, ocrpt_list *start, ocrpt_
 
 static void ocrpt_navigate_start_private(ocrpt_query *topq, ocrpt_query *q) {
 	ocrpt_list *l;
-	ocrpt_query_result *qr;
-	int32_t cols;
 
 	if (!q)
 		return;
@@ -147,8 +145,7 @@ static void ocrpt_navigate_start_private(ocrpt_query *topq, ocrpt_query *q) {
 	assert(q->source);
 	assert(q->source->o);
 
-	qr = ocrpt_query_get_result(q, &cols);
-	if (!qr || !cols)
+	if (!ocrpt_query_describe(q))
 		return;
 
 	if (q->source->input && q->source->input->rewind)
@@ -201,15 +198,46 @@ DLL_EXPORT_SYM void ocrpt_query_navigate_start(ocrpt_query *q) {
 
 	ocrpt_query_finalize_followers(q);
 
-	q->source->o->residx = 0;
+	opencreport *o = q->source->o;
+
+	/* Results computed from the previous rows are invalid after rewinding. */
+	for (int32_t i = 0; i < OCRPT_EXPR_RESULTS; i++)
+		o->residx_serial[i] = ++o->residx_serial_last;
+
+	o->residx = 0;
 	ocrpt_navigate_start_private(q, q);
 }
 
+DLL_EXPORT_SYM bool ocrpt_query_get_error(ocrpt_query *q) {
+	if (!q)
+		return false;
+
+	if (q->error)
+		return true;
+
+	for (ocrpt_list *l = q->followers; l; l = l->next)
+		if (ocrpt_query_get_error((ocrpt_query *)l->data))
+			return true;
+
+	for (ocrpt_list *l = q->followers_n_to_1; l; l = l->next)
+		if (ocrpt_query_get_error((ocrpt_query *)l->data))
+			return true;
+
+	return false;
+}
+
 DLL_EXPORT_SYM bool ocrpt_query_navigate_next(ocrpt_query *q) {
 	if (!q || !q->source || !q->source->o)
 		return false;
 
-	q->source->o->residx = ocrpt_expr_next_residx(q->source->o->residx);
+	/* A partially read query set is not a valid result */
+	if (ocrpt_query_get_error(q))
+		return false;
+
+	opencreport *o = q->source->o;
+
+	o->residx = ocrpt_expr_next_residx(o->residx);
+	o->residx_serial[o->residx] = ++o->residx_serial_last;
 
 	bool has_row = false;
 	bool n_to_1_has_row = false;
@@ -297,7 +325,7 @@ DLL_EXPORT_SYM bool ocrpt_query_navigate_next(ocrpt_query *q) {
 		}
 	} while (has_row);
 
-	return has_row;
+	return has_row && !ocrpt_query_get_error(q);
 }
 
 DLL_EXPORT_SYM void ocrpt_query_navigate_use_prev_row(ocrpt_query *q) {
@@ -7,6 +7,7 @@
 #define _DATETIME_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 #include "opencreport.h"
 
@@ -16,7 +17,17 @@ static inline bool ocrpt_leap_year(int y) {
 	return ((y % 100) == 0) ? ((y % 400) == 0) : ((y % 4) == 0);
 }
 
-bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, ocrpt_result *result) __attribute__((nonnull(1,2)));
+/*
+ * The date and time formats (index + 1, or 0 if unknown)
+ * that parsed the previous value of a query column.
+ */
+struct ocrpt_datetime_hint {
+	uint8_t date_fmt;
+	uint8_t time_fmt;
+};
+typedef struct ocrpt_datetime_hint ocrpt_datetime_hint;
+
+bool ocrpt_parse_datetime(opencreport *o, const char *time_string, int ts_len, ocrpt_result *result, ocrpt_datetime_hint *hint) __attribute__((nonnull(1,2)));
 bool ocrpt_parse_interval(opencreport *o, const char *time_string, int ts_len, ocrpt_result *result) __attribute__((nonnull(1,2)));
 bool ocrpt_datetime_result_add_number(opencreport *o, ocrpt_result *dst, ocrpt_result *src_datetime, long number);
 void ocrpt_datetime_add_number(opencreport *o, ocrpt_expr *dst, ocrpt_result *src_datetime, ocrpt_result *src_number);
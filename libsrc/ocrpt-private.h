@@ -51,6 +51,15 @@ struct ocrpt_mvarentry {
 };
 typedef struct ocrpt_mvarentry ocrpt_mvarentry;
 
+#define OCRPT_RESULT_SLAB_SIZE (256)
+
+struct ocrpt_result_slab {
+	struct ocrpt_result_slab *next;
+	uint32_t used;
+	ocrpt_result results[OCRPT_RESULT_SLAB_SIZE];
+};
+typedef struct ocrpt_result_slab ocrpt_result_slab;
+
 struct opencreport {
 	/* Paper name and size */
 	const ocrpt_paper *paper;
@@ -134,6 +143,12 @@ struct opencreport {
 	ocrpt_result *one;
 	ocrpt_result *zero;
 
+	/* Pool of internally owned results and its free list */
+	ocrpt_result_slab *result_slabs;
+	ocrpt_result **result_pool_free;
+	uint32_t result_pool_n_free;
+	uint32_t result_pool_free_size;
+
 	/* Locale specific data */
 	char *textdomain;
 	locale_t locale;
@@ -144,10 +159,39 @@ struct opencreport {
 	mpfr_rnd_t rndmode;
 	gmp_randstate_t randstate;
 
+	/* Scratch space for ocrpt_format_fixed() */
+	mpfr_t format_tmp;
+
 	/* Global (default) font size and approximate width */
 	double font_size;
 	double font_width;
 
+	/*
+	 * Serial numbers of the rows stored in the
+	 * alternating datasource row result slots.
+	 */
+	uint32_t residx_serial[OCRPT_EXPR_RESULTS];
+	uint32_t residx_serial_last;
+
+	/* Time spent in nested toplevel expressions while profiling */
+	uint64_t profile_child_ns;
+
+	/*
+	 * Incremented when a setting that results of pure
+	 * functions depend on changes, e.g. the locale.
+	 * It invalidates the memos of function calls.
+	 */
+	uint32_t memo_epoch;
+
+	/*
+	 * Incremented when the identifiers of an expression may
+	 * resolve differently, e.g. a query or a variable is added
+	 * or removed. It invalidates the expressions cached by eval().
+	 */
+	uint32_t resolve_epoch;
+	/* Expressions cached by eval() outside reports */
+	struct ocrpt_eval_cache *eval_cache;
+
 	/* Alternating datasource row result index  */
 	unsigned int residx:3;
 	unsigned int output_format:3;
@@ -157,6 +201,7 @@ struct opencreport {
 	bool noquery_show_nodata:1;
 	bool report_height_after_last:1;
 	bool follower_match_single:1;
+	bool profiling:1;
 	/* Bools for output parameters */
 	bool suppress_html_head:1;
 	bool csv_as_text:1;
@@ -452,16 +452,52 @@ void parser_init(base_yy_extra_type *yyext, opencreport *o, ocrpt_report *r) {
 	yyext->o = o;
 	yyext->r = r;
 	yyext->err = NULL;
+	yyext->dont_cache = false;
 }
 
 static void ocrpt_grammar_free_token(ocrpt_string *token) {
 	ocrpt_mem_string_free(token, true);
 }
 
+static ocrpt_expr *ocrpt_expr_parse_finish(opencreport *o, ocrpt_report *r, ocrpt_expr *e, const char *expr_string) {
+	bool found_on_o_list = false;
+	ocrpt_list *l;
+
+	for (l = o->exprs; l && !found_on_o_list; l = l->next)
+		if (e == l->data)
+			found_on_o_list = true;
+
+	if (r && !r->executing && !r->dont_add_exprs) {
+		bool found_on_r_list = false;
+		for (l = r->exprs; l && !found_on_r_list; l = l->next)
+			if (e == l->data)
+				found_on_r_list = true;
+
+		if (!found_on_o_list && !found_on_r_list) {
+			r->exprs = ocrpt_list_end_append(r->exprs, &r->exprs_last, e);
+			e->result_index = r->num_expressions++;
+			e->result_index_set = true;
+		}
+	} else {
+		if (!found_on_o_list)
+			o->exprs = ocrpt_list_end_append(o->exprs, &o->exprs_last, e);
+		e->result_index = -1;
+	}
+
+	e->o = o;
+	e->r = r;
+	e->expr_string = ocrpt_mem_strdup(expr_string);
+	return e;
+}
+
 static ocrpt_expr *ocrpt_expr_parse_internal(opencreport *o, ocrpt_report *r, const char *expr_string, char **err) {
 	yyscan_t yyscanner = NULL;
 	base_yy_extra_type yyextra;
 	int yyresult = 1;
+	ocrpt_expr *cached = ocrpt_expr_parse_cache_get(o, r, expr_string);
+
+	if (cached)
+		return ocrpt_expr_parse_finish(o, r, cached, expr_string);
 
 	memset(&yyextra, 0, sizeof(yyextra));
 
@@ -535,34 +571,14 @@ static ocrpt_expr *ocrpt_expr_parse_internal(opencreport *o, ocrpt_report *r, co
 	ocrpt_list_free(yyextra.parsed_arglist_stack);
 	ocrpt_list_free(yyextra.parsed_exprs);
 
-	bool found_on_o_list = false;
-	ocrpt_list *l;
-
-	for (l = o->exprs; l && !found_on_o_list; l = l->next)
-		if (yyextra.last_expr == l->data)
-			found_on_o_list = true;
-
-	if (r && !r->executing && !r->dont_add_exprs) {
-		bool found_on_r_list = false;
-		for (l = r->exprs; l && !found_on_r_list; l = l->next)
-			if (yyextra.last_expr == l->data)
-				found_on_r_list = true;
-
-		if (!found_on_o_list && !found_on_r_list) {
-			r->exprs = ocrpt_list_end_append(r->exprs, &r->exprs_last, yyextra.last_expr);
-			yyextra.last_expr->result_index = r->num_expressions++;
-			yyextra.last_expr->result_index_set = true;
-		}
-	} else {
-		if (!found_on_o_list)
-			o->exprs = ocrpt_list_end_append(o->exprs, &o->exprs_last, yyextra.last_expr);
-		yyextra.last_expr->result_index = -1;
-	}
+	/*
+	 * Parsing an inlined eval() argument also registers it
+	 * with the report, a cached copy wouldn't do the same.
+	 */
+	if (!yyextra.dont_cache)
+		ocrpt_expr_parse_cache_add(o, expr_string, yyextra.last_expr);
 
-	yyextra.last_expr->o = o;
-	yyextra.last_expr->r = r;
-	yyextra.last_expr->expr_string = ocrpt_mem_strdup(expr_string);
-	return yyextra.last_expr;
+	return ocrpt_expr_parse_finish(o, r, yyextra.last_expr, expr_string);
 }
 
 DLL_EXPORT_SYM ocrpt_expr *ocrpt_expr_parse(opencreport *o, const char *expr_string, char **err) {
@@ -808,6 +824,7 @@ static ocrpt_expr *parseembeddedexpr(yyscan_t yyscanner, ocrpt_expr *func, ocrpt
 	ocrpt_list_free(extra->parsed_arglist);
 	extra->parsed_arglist = NULL;
 	extra->last_expr = NULL;
+	extra->dont_cache = true;
 
 	if (!e) {
 		char *err1 = alloca(strlen(err) + 1);
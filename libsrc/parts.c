@@ -195,6 +195,9 @@ void ocrpt_report_matched_values_free(ocrpt_report *r) {
 }
 
 void ocrpt_report_free(ocrpt_report *r) {
+	ocrpt_eval_cache_free(r->eval_cache);
+	r->eval_cache = NULL;
+	ocrpt_report_unshare_expressions(r);
 	ocrpt_variables_free(r);
 	ocrpt_breaks_free(r);
 	r->executing = true;
@@ -229,6 +232,7 @@ DLL_EXPORT_SYM void ocrpt_report_set_main_query(ocrpt_report *r, const ocrpt_que
 		return;
 
 	r->query = (ocrpt_query *)query;
+	r->o->resolve_epoch++;
 }
 
 DLL_EXPORT_SYM void ocrpt_report_set_main_query_from_expr(ocrpt_report *r, const char *expr_string) {
@@ -298,6 +302,9 @@ DLL_EXPORT_SYM void ocrpt_report_resolve_expressions(ocrpt_report *r) {
 	if (!r || !r->o || r->executing || r->o->executing)
 		return;
 
+	/* The optimizer may rewrite the trees, the shared nodes are collected again. */
+	ocrpt_report_unshare_expressions(r);
+
 	for (ocrpt_list *ptr = r->exprs; ptr; ptr = ptr->next) {
 		ocrpt_expr *e = (ocrpt_expr *)ptr->data;
 
@@ -307,6 +314,8 @@ DLL_EXPORT_SYM void ocrpt_report_resolve_expressions(ocrpt_report *r) {
 		if (e->delayed || ocrpt_expr_get_precalculate(e))
 			r->have_delayed_expr = true;
 	}
+
+	ocrpt_report_share_expressions(r);
 }
 
 DLL_EXPORT_SYM void ocrpt_report_evaluate_expressions(ocrpt_report *r) {
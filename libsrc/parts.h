@@ -85,6 +85,8 @@ struct ocrpt_report {
 	/* List of expressions */
 	ocrpt_list *exprs;
 	ocrpt_list *exprs_last;
+	/* Expressions cached by eval() */
+	struct ocrpt_eval_cache *eval_cache;
 	/* List of ocrpt_report_cb_data pointers */
 	ocrpt_list *start_callbacks;
 	ocrpt_list *done_callbacks;
@@ -125,6 +127,7 @@ struct ocrpt_report {
 	bool suppress:1;
 	bool executing:1;
 	bool dont_add_exprs:1;
+	bool exprs_shared:1;
 	bool fieldheader_high_priority:1;
 	bool finished:1;
 	bool noquery_show_nodata:1;
@@ -63,6 +63,8 @@ typedef struct base_yy_extra_type {
 	ocrpt_list *parsed_arglist;
 	ocrpt_list *parsed_arglist_stack;
 	char *err;
+	/* The parse tree depends on more than the expression string */
+	bool dont_cache;
 } base_yy_extra_type;
 
 #define parser_yyget_extra(yyscanner) (*((base_yy_extra_type **) (yyscanner)))
@@ -0,0 +1,159 @@
+/*
+ * Byte scanning utilities
+ *
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <config.h>
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define OCRPT_SCAN_SSE2 1
+#if defined(__GNUC__)
+#define OCRPT_SCAN_AVX2 1
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define OCRPT_SCAN_NEON 1
+#endif
+
+#include "scanutil.h"
+
+typedef size_t (*ocrpt_scan_any4_func)(const char *str, size_t len, char c1, char c2, char c3, char c4);
+
+static size_t ocrpt_scan_any4_scalar(const char *str, size_t len, char c1, char c2, char c3, char c4) {
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		char c = str[i];
+
+		if (c == c1 || c == c2 || c == c3 || c == c4)
+			break;
+	}
+
+	return i;
+}
+
+#ifdef OCRPT_SCAN_SSE2
+static inline __m128i ocrpt_scan_match_sse2(__m128i v, __m128i v1, __m128i v2, __m128i v3, __m128i v4) {
+	return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)),
+						_mm_or_si128(_mm_cmpeq_epi8(v, v3), _mm_cmpeq_epi8(v, v4)));
+}
+
+/* 32 bytes per iteration */
+static size_t ocrpt_scan_any4_sse2(const char *str, size_t len, char c1, char c2, char c3, char c4) {
+	const __m128i v1 = _mm_set1_epi8(c1);
+	const __m128i v2 = _mm_set1_epi8(c2);
+	const __m128i v3 = _mm_set1_epi8(c3);
+	const __m128i v4 = _mm_set1_epi8(c4);
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(str + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(str + i + 16));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(ocrpt_scan_match_sse2(a, v1, v2, v3, v4)) |
+						((uint32_t)_mm_movemask_epi8(ocrpt_scan_match_sse2(b, v1, v2, v3, v4)) << 16);
+
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+
+	return i + ocrpt_scan_any4_scalar(str + i, len - i, c1, c2, c3, c4);
+}
+#endif
+
+#ifdef OCRPT_SCAN_AVX2
+__attribute__((target("avx2")))
+static inline __m256i ocrpt_scan_match_avx2(__m256i v, __m256i v1, __m256i v2, __m256i v3, __m256i v4) {
+	return _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, v1), _mm256_cmpeq_epi8(v, v2)),
+						_mm256_or_si256(_mm256_cmpeq_epi8(v, v3), _mm256_cmpeq_epi8(v, v4)));
+}
+
+/* 64 bytes per iteration, only used if the CPU supports AVX2 */
+__attribute__((target("avx2")))
+static size_t ocrpt_scan_any4_avx2(const char *str, size_t len, char c1, char c2, char c3, char c4) {
+	const __m256i v1 = _mm256_set1_epi8(c1);
+	const __m256i v2 = _mm256_set1_epi8(c2);
+	const __m256i v3 = _mm256_set1_epi8(c3);
+	const __m256i v4 = _mm256_set1_epi8(c4);
+	size_t i;
+
+	for (i = 0; i + 64 <= len; i += 64) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(str + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(str + i + 32));
+		uint64_t mask = (uint64_t)(uint32_t)_mm256_movemask_epi8(ocrpt_scan_match_avx2(a, v1, v2, v3, v4)) |
+						((uint64_t)(uint32_t)_mm256_movemask_epi8(ocrpt_scan_match_avx2(b, v1, v2, v3, v4)) << 32);
+
+		if (mask)
+			return i + __builtin_ctzll(mask);
+	}
+
+	return i + ocrpt_scan_any4_sse2(str + i, len - i, c1, c2, c3, c4);
+}
+#endif
+
+#ifdef OCRPT_SCAN_NEON
+/*
+ * NEON has no movemask, narrowing the 0x00/0xff comparison
+ * result by 4 bits gives 4 bits per byte in a 64-bit word.
+ */
+static inline uint64_t ocrpt_scan_mask_neon(uint8x16_t v, uint8x16_t v1, uint8x16_t v2, uint8x16_t v3, uint8x16_t v4) {
+	uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, v1), vceqq_u8(v, v2)), vorrq_u8(vceqq_u8(v, v3), vceqq_u8(v, v4)));
+
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+
+/* 32 bytes per iteration */
+static size_t ocrpt_scan_any4_neon(const char *str, size_t len, char c1, char c2, char c3, char c4) {
+	const uint8x16_t v1 = vdupq_n_u8((uint8_t)c1);
+	const uint8x16_t v2 = vdupq_n_u8((uint8_t)c2);
+	const uint8x16_t v3 = vdupq_n_u8((uint8_t)c3);
+	const uint8x16_t v4 = vdupq_n_u8((uint8_t)c4);
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		uint64_t mask = ocrpt_scan_mask_neon(vld1q_u8((const uint8_t *)(str + i)), v1, v2, v3, v4);
+
+		if (mask)
+			return i + (__builtin_ctzll(mask) >> 2);
+
+		mask = ocrpt_scan_mask_neon(vld1q_u8((const uint8_t *)(str + i + 16)), v1, v2, v3, v4);
+		if (mask)
+			return i + 16 + (__builtin_ctzll(mask) >> 2);
+	}
+
+	return i + ocrpt_scan_any4_scalar(str + i, len - i, c1, c2, c3, c4);
+}
+#endif
+
+static ocrpt_scan_any4_func ocrpt_scan_any4_impl;
+static pthread_once_t ocrpt_scan_any4_once = PTHREAD_ONCE_INIT;
+
+static void ocrpt_scan_any4_select(void) {
+#if defined(OCRPT_SCAN_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		ocrpt_scan_any4_impl = ocrpt_scan_any4_avx2;
+		return;
+	}
+#endif
+#if defined(OCRPT_SCAN_SSE2)
+	ocrpt_scan_any4_impl = ocrpt_scan_any4_sse2;
+#elif defined(OCRPT_SCAN_NEON)
+	ocrpt_scan_any4_impl = ocrpt_scan_any4_neon;
+#else
+	ocrpt_scan_any4_impl = ocrpt_scan_any4_scalar;
+#endif
+}
+
+size_t ocrpt_scan_any4(const char *str, size_t len, char c1, char c2, char c3, char c4) {
+	/* The indexing threads may get here at the same time */
+	pthread_once(&ocrpt_scan_any4_once, ocrpt_scan_any4_select);
+
+	return ocrpt_scan_any4_impl(str, len, c1, c2, c3, c4);
+}
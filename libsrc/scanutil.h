@@ -0,0 +1,21 @@
+/*
+ * Byte scanning utilities
+ *
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+#ifndef __OCRPT_SCANUTIL_H__
+#define __OCRPT_SCANUTIL_H__
+
+#include <stddef.h>
+
+/*
+ * Return the offset of the first byte in str[0 .. len - 1]
+ * that is equal to any of c1, c2, c3 or c4, or len if none is.
+ * Pass the same character more than once to look for fewer.
+ * Only the CSV input uses it, scanning JSON structure
+ * with it is deferred because yajl does its own lexing.
+ */
+size_t ocrpt_scan_any4(const char *str, size_t len, char c1, char c2, char c3, char c4);
+
+#endif
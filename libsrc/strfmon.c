@@ -55,6 +55,7 @@ __FBSDID("$FreeBSD: src/lib/libc/stdlib/strfmon.c,v 1.14 2003/03/20 08:18:55 ach
 #include <mpfr.h>
 #include <opencreport.h>
 #include "ocrpt-private.h"
+#include "formatting.h"
 
 /* internal flags */
 #define	NEED_GROUPING		0x01	/* print digits grouped (default) */
@@ -507,6 +508,7 @@ static char *__format_grouped_mpfr(opencreport *o, mpfr_t value, int *flags, int
 	char		*avalue;
 	int		avalue_size;
 	char		fmt[32];
+	char		abuf[64];
 
 	size_t		bufsize;
 	char		*bufend;
@@ -548,17 +550,23 @@ static char *__format_grouped_mpfr(opencreport *o, mpfr_t value, int *flags, int
 	if (*flags & NEED_GROUPING)
 		left_prec += get_groups(left_prec, grouping);
 
-	/* convert to string */
-	snprintf(fmt, sizeof(fmt), "%%%d.%dRf", left_prec + right_prec + 1, right_prec);
-	avalue_size = mpfr_asprintf(&avalue, fmt, value);
-	if (avalue_size < 0)
-		return (NULL);
+	/* convert to string, try the fast path first */
+	avalue_size = ocrpt_format_fixed(o, abuf, sizeof(abuf), value, left_prec + right_prec + 1, right_prec, 0);
+	if (avalue_size >= 0)
+		avalue = abuf;
+	else {
+		snprintf(fmt, sizeof(fmt), "%%%d.%dRf", left_prec + right_prec + 1, right_prec);
+		avalue_size = mpfr_asprintf(&avalue, fmt, value);
+		if (avalue_size < 0)
+			return (NULL);
+	}
 
 	/* make sure that we've enough space for result string */
 	bufsize = strlen(avalue) * 2 + 1;
 	rslt = ocrpt_mem_malloc(bufsize);
 	if (rslt == NULL) {
-		mpfr_free_str(avalue);
+		if (avalue != abuf)
+			mpfr_free_str(avalue);
 		return (NULL);
 	}
 	memset(rslt, 0, bufsize);
@@ -620,6 +628,7 @@ static char *__format_grouped_mpfr(opencreport *o, mpfr_t value, int *flags, int
 
 	bufsize = bufsize - (bufend - rslt);
 	memmove(rslt, bufend, bufsize);
-	mpfr_free_str(avalue);
+	if (avalue != abuf)
+		mpfr_free_str(avalue);
 	return (rslt);
 }
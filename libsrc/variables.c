@@ -142,6 +142,7 @@ DLL_EXPORT_SYM ocrpt_var *ocrpt_variable_new_full(ocrpt_report *r, enum ocrpt_re
 	r->dont_add_exprs = false;
 
 	r->variables = ocrpt_list_append(r->variables, var);
+	r->o->resolve_epoch++;
 
 	return var;
 }
@@ -293,16 +294,223 @@ void ocrpt_variables_free(ocrpt_report *r) {
 
 	ocrpt_list_free(r->variables);
 	r->variables = NULL;
+	r->o->resolve_epoch++;
 }
 
 DLL_EXPORT_SYM bool ocrpt_variable_get_precalculate(ocrpt_var *var) {
 	return var ? var->precalculate : false;
 }
 
+/*
+ * Built-in aggregate variables are computed directly from
+ * the values of the base and ignore expressions and the
+ * value of the variable in the previous row, the same way
+ * their generated expressions would compute them.
+ * This is a scalar fast path: one row is added at a time,
+ * with the same MPFR operations, so the results are the same
+ * whether the variable is precalculated or not.
+ *
+ * The generated expressions are still evaluated for the
+ * rows the native code doesn't deal with, like errors
+ * and non-numeric values.
+ */
+static bool ocrpt_variable_native_eligible(ocrpt_var *v) {
+	if (v->basetype != OCRPT_RESULT_NUMBER || !v->ignoreexpr)
+		return false;
+
+	switch (v->type) {
+	case OCRPT_VARIABLE_COUNT:
+	case OCRPT_VARIABLE_COUNTALL:
+		return true;
+	case OCRPT_VARIABLE_SUM:
+	case OCRPT_VARIABLE_LOWEST:
+	case OCRPT_VARIABLE_HIGHEST:
+		break;
+	case OCRPT_VARIABLE_AVERAGE:
+		if (!v->intermedexpr || !v->intermed2expr)
+			return false;
+		break;
+	case OCRPT_VARIABLE_AVERAGEALL:
+		if (!v->intermedexpr)
+			return false;
+		break;
+	default:
+		return false;
+	}
+
+	/* The row number that resets the value must be known */
+	if (v->br)
+		return v->br->rownum != NULL;
+
+	return v->r->query && v->r->query->rownum;
+}
+
+static inline bool ocrpt_variable_native_number(ocrpt_result *rs) {
+	return rs && rs->type == OCRPT_RESULT_NUMBER && !rs->isnull && rs->number_initialized;
+}
+
+static inline void ocrpt_variable_native_done(ocrpt_expr *e, int32_t residx) {
+	ocrpt_expr_set_result_evaluated(e, residx, true);
+	ocrpt_expr_set_result_evaluated(e, ocrpt_expr_next_residx(residx), false);
+}
+
+static ocrpt_result *ocrpt_variable_native_result(ocrpt_expr *e, int32_t residx) {
+	ocrpt_result *rs = e ? e->result[residx] : NULL;
+
+	if (!rs)
+		return NULL;
+
+	if (!rs->number_initialized) {
+		mpfr_init2(rs->number, e->o->prec);
+		rs->number_initialized = true;
+	}
+	rs->type = OCRPT_RESULT_NUMBER;
+	rs->isnull = false;
+
+	return rs;
+}
+
+/* (reset ? 0 : r.self) + (add ? value : 0) */
+static void ocrpt_variable_native_add(ocrpt_var *v, ocrpt_expr *e, int32_t residx, bool reset, bool add, mpfr_t value) {
+	opencreport *o = v->r->o;
+	ocrpt_result *self = e->result[ocrpt_expr_prev_residx(residx)];
+	ocrpt_result *rs = ocrpt_variable_native_result(e, residx);
+
+	if (reset)
+		mpfr_set_ui(rs->number, 0, o->rndmode);
+	else
+		mpfr_set(rs->number, self->number, o->rndmode);
+	if (add)
+		mpfr_add(rs->number, rs->number, value, o->rndmode);
+
+	ocrpt_variable_native_done(e, residx);
+}
+
+/*
+ * Compute the value of the variable for the current row.
+ * Returns false without touching the results of the variable
+ * if the generated expressions must be evaluated instead.
+ */
+bool ocrpt_variable_native_evaluate(ocrpt_var *v, uint32_t precalc_round) {
+	opencreport *o = v->r->o;
+	mpfr_rnd_t rndmode = o->rndmode;
+	int32_t residx = o->residx, prev = ocrpt_expr_prev_residx(residx);
+	ocrpt_result *base = NULL, *ignore, *rownum, *self, *rs;
+	bool reset = false, add;
+
+	ocrpt_expr_eval_worker(v->ignoreexpr, v->ignoreexpr, v, precalc_round);
+
+	ignore = EXPR_RESULT(v->ignoreexpr);
+	if (!ocrpt_variable_native_number(ignore))
+		return false;
+	add = mpfr_zero_p(ignore->number);
+
+	if (v->type != OCRPT_VARIABLE_COUNTALL) {
+		base = EXPR_RESULT(v->baseexpr);
+		if (!base || base->type == OCRPT_RESULT_ERROR)
+			return false;
+		if (v->type != OCRPT_VARIABLE_COUNT && (base->type != OCRPT_RESULT_NUMBER || (!base->isnull && !base->number_initialized)))
+			return false;
+		add = add && !base->isnull;
+	}
+
+	if (v->type != OCRPT_VARIABLE_COUNT && v->type != OCRPT_VARIABLE_COUNTALL) {
+		rownum = (v->br ? v->br->rownum : v->r->query->rownum)->result[residx];
+		if (!ocrpt_variable_native_number(rownum))
+			return false;
+		reset = (mpfr_cmp_ui(rownum->number, 1) == 0);
+	}
+
+	self = v->resultexpr->result[prev];
+
+	switch (v->type) {
+	case OCRPT_VARIABLE_COUNT:
+	case OCRPT_VARIABLE_COUNTALL:
+		if (!ocrpt_variable_native_number(self))
+			return false;
+
+		rs = ocrpt_variable_native_result(v->resultexpr, residx);
+		if (!rs)
+			return false;
+		mpfr_add_ui(rs->number, self->number, add ? 1 : 0, rndmode);
+		break;
+
+	case OCRPT_VARIABLE_SUM:
+		if ((!reset && !ocrpt_variable_native_number(self)) || !v->resultexpr->result[residx])
+			return false;
+
+		ocrpt_variable_native_add(v, v->resultexpr, residx, reset, add, base->number);
+		return true;
+
+	case OCRPT_VARIABLE_AVERAGE:
+	case OCRPT_VARIABLE_AVERAGEALL: {
+		ocrpt_result *sum = NULL, *count = NULL;
+
+		if ((!reset && !ocrpt_variable_native_number(v->intermedexpr->result[prev])) || !v->intermedexpr->result[residx])
+			return false;
+		if (v->type == OCRPT_VARIABLE_AVERAGE &&
+				(!ocrpt_variable_native_number(v->intermed2expr->result[prev]) || !v->intermed2expr->result[residx]))
+			return false;
+
+		rs = ocrpt_variable_native_result(v->resultexpr, residx);
+		if (!rs)
+			return false;
+
+		ocrpt_variable_native_add(v, v->intermedexpr, residx, reset, add, base->number);
+		sum = v->intermedexpr->result[residx];
+
+		if (v->type == OCRPT_VARIABLE_AVERAGE) {
+			count = ocrpt_variable_native_result(v->intermed2expr, residx);
+			mpfr_add_ui(count->number, v->intermed2expr->result[prev]->number, add ? 1 : 0, rndmode);
+			ocrpt_variable_native_done(v->intermed2expr, residx);
+		} else
+			count = rownum;
+
+		mpfr_div(rs->number, sum->number, count->number, rndmode);
+		break;
+	}
+
+	case OCRPT_VARIABLE_LOWEST:
+	case OCRPT_VARIABLE_HIGHEST: {
+		ocrpt_result *src;
+
+		if (!reset && (!self || self->type != OCRPT_RESULT_NUMBER || (!self->isnull && !self->number_initialized)))
+			return false;
+
+		if (reset || self->isnull)
+			src = base;
+		else if (!add)
+			src = self;
+		else if (v->type == OCRPT_VARIABLE_LOWEST)
+			src = (mpfr_less_p(self->number, base->number) ? self : base);
+		else
+			src = (mpfr_greater_p(self->number, base->number) ? self : base);
+
+		rs = ocrpt_variable_native_result(v->resultexpr, residx);
+		if (!rs)
+			return false;
+		if (src->isnull)
+			rs->isnull = true;
+		else
+			mpfr_set(rs->number, src->number, rndmode);
+		break;
+	}
+
+	default:
+		return false;
+	}
+
+	ocrpt_variable_native_done(v->resultexpr, residx);
+
+	return true;
+}
+
 DLL_EXPORT_SYM void ocrpt_variable_resolve(ocrpt_var *v) {
 	if (!v || !v->r || !v->r->o || v->r->o->executing || v->r->executing)
 		return;
 
+	bool reset_on_break_ok = true;
+
 	if (v->baseexpr) {
 		ocrpt_expr_resolve_worker(v->baseexpr, NULL, v->baseexpr, v, 0, true, NULL);
 		ocrpt_expr_optimize(v->baseexpr);
@@ -333,8 +541,11 @@ DLL_EXPORT_SYM void ocrpt_variable_resolve(ocrpt_var *v) {
 			ocrpt_err_printf("break '%s' not found, disabling resetonbreak for v.'%s'\n", v->br_name, v->name);
 			ocrpt_mem_free(v->br_name);
 			v->br_name = NULL;
+			reset_on_break_ok = false;
 		}
     }
+
+	v->native = reset_on_break_ok && ocrpt_variable_native_eligible(v);
 }
 
 DLL_EXPORT_SYM void ocrpt_variable_evaluate(ocrpt_var *v) {
@@ -347,6 +558,8 @@ DLL_EXPORT_SYM void ocrpt_variable_evaluate(ocrpt_var *v) {
 	if (v->r->o->precalculate || !v->precalculate) {
 		if (v->baseexpr)
 			ocrpt_expr_eval_worker(v->baseexpr, v->baseexpr, v, v->r->cur_precalc_round);
+		if (v->native && ocrpt_variable_native_evaluate(v, v->r->cur_precalc_round))
+			return;
 		if (v->ignoreexpr)
 			ocrpt_expr_eval_worker(v->ignoreexpr, v->ignoreexpr, v, v->r->cur_precalc_round);
 		if (v->intermedexpr)
@@ -392,9 +605,9 @@ void ocrpt_variables_add_precalculated_results(ocrpt_report *r, ocrpt_list *brl_
 				var_br_triggered = true;
 
 			if (var_br_triggered) {
-				ocrpt_result *dst = ocrpt_result_new(r->o);
+				ocrpt_result *dst = ocrpt_result_pool_get(r->o);
 				ocrpt_result_copy(dst, EXPR_RESULT(var->resultexpr));
-				var->precalc_results = ocrpt_list_append(var->precalc_results, dst);
+				var->precalc_results = ocrpt_list_end_append(var->precalc_results, &var->precalc_results_last, dst);
 			}
 		}
 	}
@@ -424,12 +637,8 @@ void ocrpt_variables_advance_precalculated_results(ocrpt_report *r, ocrpt_list *
 					if (var_br_triggered && var->precalc_rptr->next)
 						var->precalc_rptr = var->precalc_rptr->next;
 				}
-			} else if (var->precalc_results && !var->precalc_rptr) {
-				ocrpt_list *l1;
-				for (l1 = var->precalc_results; l1 && l1->next; l1 = l1->next)
-					;
-				var->precalc_rptr = l1;
-			}
+			} else if (var->precalc_results && !var->precalc_rptr)
+				var->precalc_rptr = var->precalc_results_last;
 		}
 	}
 }
@@ -19,6 +19,7 @@ struct ocrpt_var {
 	ocrpt_expr *intermed2expr;
 	ocrpt_expr *resultexpr;
 	ocrpt_list *precalc_results;
+	ocrpt_list *precalc_results_last;
 	ocrpt_list *precalc_rptr;
 	/*
 	 * If this report variable is precalculated,
@@ -29,6 +30,8 @@ struct ocrpt_var {
 	enum ocrpt_var_type type:4;
 	enum ocrpt_result_type basetype:2;
 	bool precalculate:1;
+	/* Built-in aggregate computed by ocrpt_variable_native_evaluate() */
+	bool native:1;
 };
 
 void ocrpt_variable_reset(ocrpt_var *v);
@@ -36,5 +39,6 @@ void ocrpt_variables_add_precalculated_results(ocrpt_report *r, ocrpt_list *brl_
 void ocrpt_variables_advance_precalculated_results(ocrpt_report *r, ocrpt_list *brl_start, uint32_t older_than_round);
 void ocrpt_variable_free(ocrpt_var *var);
 void ocrpt_variables_free(ocrpt_report *r);
+bool ocrpt_variable_native_evaluate(ocrpt_var *v, uint32_t precalc_round);
 
 #endif
@@ -0,0 +1,131 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <opencreport.h>
+#include "test_common.h"
+
+#define ROWS 3000
+
+static const char *countries[] = { "HU", "AT", "SK", "CZ", "SI" };
+static const char *amounts[] = { "12.50", "3", "100.25", "0.75", "7", "42", "1e1", "5.5" };
+
+/*
+ * Every column but "id" has only a few distinct values,
+ * so they are stored and converted once per value.
+ */
+static char *make_xml(void) {
+	char *filename = strdup("/tmp/colstore_test.XXXXXX");
+	int fd = mkstemp(filename);
+	FILE *fp = (fd >= 0 ? fdopen(fd, "w") : NULL);
+	int32_t i;
+
+	if (!fp) {
+		if (fd >= 0)
+			close(fd);
+		free(filename);
+		return NULL;
+	}
+
+	fprintf(fp, "<?xml version=\"1.0\"?>\n<data>\n");
+	fprintf(fp, "\t<fields>\n\t\t<field>id</field>\n\t\t<field>country</field>\n\t\t<field>amount</field>\n\t\t<field>shipped</field>\n\t\t<field>status</field>\n\t</fields>\n");
+	fprintf(fp, "\t<coltypes>\n\t\t<field>number</field>\n\t\t<field>string</field>\n\t\t<field>number</field>\n\t\t<field>datetime</field>\n\t\t<field>string</field>\n\t</coltypes>\n");
+	fprintf(fp, "\t<rows>\n");
+
+	for (i = 1; i <= ROWS; i++) {
+		fprintf(fp, "\t\t<row><col>%d</col><col>%s</col><col>%s</col><col>2026-%02d-%02d</col>", i, countries[i % 5], amounts[i % 8], i % 4 + 1, i % 3 + 1);
+		/* The missing last column is NULL */
+		if (i % 4)
+			fprintf(fp, "<col>%s</col>", i % 2 ? "open" : "closed");
+		fprintf(fp, "</row>\n");
+	}
+
+	fprintf(fp, "\t</rows>\n</data>\n");
+	fclose(fp);
+
+	return filename;
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "xml", "xml", NULL);
+	char *filename = make_xml();
+	ocrpt_query *q;
+	ocrpt_expr *e[5];
+	int32_t i, pass;
+
+	if (!filename) {
+		fprintf(stderr, "cannot create the XML file\n");
+		ocrpt_free(o);
+		return 1;
+	}
+
+	q = ocrpt_query_add_file(ds, "a", filename, NULL, 0);
+	if (!q) {
+		printf("adding the query failed\n");
+		ocrpt_free(o);
+		unlink(filename);
+		free(filename);
+		return 0;
+	}
+
+	e[0] = ocrpt_expr_parse(o, "id", NULL);
+	e[1] = ocrpt_expr_parse(o, "country", NULL);
+	e[2] = ocrpt_expr_parse(o, "amount * 4", NULL);
+	e[3] = ocrpt_expr_parse(o, "month(shipped) * 100 + day(shipped)", NULL);
+	e[4] = ocrpt_expr_parse(o, "status", NULL);
+	for (i = 0; i < 5; i++)
+		ocrpt_expr_resolve(e[i]);
+
+	for (pass = 1; pass <= 2; pass++) {
+		int32_t rows = 0, hu = 0, nulls = 0;
+		long ids = 0, shipped = 0;
+		double amount = 0.0;
+
+		ocrpt_query_navigate_start(q);
+
+		while (ocrpt_query_navigate_next(q)) {
+			long id = ocrpt_expr_get_long(e[0]);
+			ocrpt_result *country = ocrpt_expr_eval(e[1]);
+			double amount4 = ocrpt_expr_get_double(e[2]);
+			long shipped1 = ocrpt_expr_get_long(e[3]);
+			ocrpt_result *status = ocrpt_expr_eval(e[4]);
+
+			rows++;
+			ids += id;
+			amount += amount4;
+			shipped += shipped1;
+			if (!strcmp(ocrpt_result_get_string(country)->str, "HU"))
+				hu++;
+			if (ocrpt_result_isnull(status))
+				nulls++;
+
+			if (rows <= 3 || rows == ROWS)
+				printf("pass %d row %d: id = %ld country = '%s' amount * 4 = %.2f shipped = %ld status = %s%s%s\n", pass, rows,
+						id, ocrpt_result_get_string(country)->str, amount4, shipped1,
+						ocrpt_result_isnull(status) ? "" : "'",
+						ocrpt_result_isnull(status) ? "NULL" : ocrpt_result_get_string(status)->str,
+						ocrpt_result_isnull(status) ? "" : "'");
+		}
+
+		printf("pass %d: rows %d sum of id %ld sum of amount * 4 %.2f sum of shipped %ld HU %d NULL status %d\n",
+				pass, rows, ids, amount, shipped, hu, nulls);
+	}
+
+	for (i = 0; i < 5; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	unlink(filename);
+	free(filename);
+
+	return 0;
+}
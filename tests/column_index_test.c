@@ -0,0 +1,89 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opencreport.h>
+
+#define COLS 300
+static char *array[2][COLS];
+static int32_t coltypes[COLS];
+
+#define FCOLS 4
+/* NOT static */ const char *farray[2][FCOLS] = {
+	{ "c299", "d0", "dup", "dup" },
+	{ "b_c299", "b_d0", "first", "second" }
+};
+
+/* NOT static */ const int32_t fcoltypes[FCOLS] = {
+	OCRPT_RESULT_STRING, OCRPT_RESULT_STRING, OCRPT_RESULT_STRING, OCRPT_RESULT_STRING
+};
+
+/*
+ * The main query is wide, column names are looked up
+ * in it first and then in its follower.
+ */
+static const char *exprs[] = {
+	"c0",
+	"c150",
+	"c299",
+	"a.c299",
+	"b.c299",
+	"d0",
+	"dup",
+	"b.dup",
+	"a.d0",
+	"nosuch",
+};
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *a, *b;
+	int32_t nexprs = sizeof(exprs) / sizeof(exprs[0]);
+	ocrpt_expr *e[nexprs];
+	int32_t i;
+
+	for (i = 0; i < COLS; i++) {
+		char buf[16];
+
+		snprintf(buf, sizeof(buf), "c%d", i);
+		array[0][i] = strdup(buf);
+		snprintf(buf, sizeof(buf), "a%d", i);
+		array[1][i] = strdup(buf);
+		coltypes[i] = OCRPT_RESULT_STRING;
+	}
+
+	a = ocrpt_query_add_data(ds, "a", (const char **)array, 1, COLS, coltypes, COLS);
+	b = ocrpt_query_add_data(ds, "b", (const char **)farray, 1, FCOLS, fcoltypes, FCOLS);
+	ocrpt_query_add_follower(a, b);
+
+	for (i = 0; i < nexprs; i++) {
+		e[i] = ocrpt_expr_parse(o, exprs[i], NULL);
+		ocrpt_expr_resolve(e[i]);
+	}
+
+	ocrpt_query_navigate_start(a);
+
+	while (ocrpt_query_navigate_next(a)) {
+		for (i = 0; i < nexprs; i++)
+			printf("%s = %s\n", exprs[i], ocrpt_result_get_string(ocrpt_expr_eval(e[i]))->str);
+	}
+
+	for (i = 0; i < nexprs; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	for (i = 0; i < COLS; i++) {
+		free(array[0][i]);
+		free(array[1][i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 5
+#define COLS 2
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "id", "name" },
+	{ "1", "Fred Flintstone" },
+	{ "2", "Wilma Flintstone" },
+	{ "3", "Pebbles Flintstone" },
+	{ "4", "Betty Rubble" },
+	{ "5", "Barney Rubble" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_STRING
+};
+
+#define EXPRS 6
+static const char *exprs[EXPRS] = {
+	/* Common subexpression: counted(id) */
+	"counted(id) * 2",
+	"counted(id) + 1",
+	/* Volatile functions are never merged */
+	"volatile(id) * 2",
+	"volatile(id) + 1",
+	/* The whole iif() is shared, its operands are evaluated lazily */
+	"1 + iif(id > 2, counted2(id), 0)",
+	"2 + iif(id > 2, counted2(id), 0)",
+};
+
+/* Return the operand unchanged and count how many times it was called */
+OCRPT_STATIC_FUNCTION(my_counted) {
+	int *calls = user_data;
+	ocrpt_result *rs;
+
+	(*calls)++;
+
+	if (ocrpt_expr_get_num_operands(e) != 1 || !(rs = ocrpt_expr_operand_get_result(e, 0)) || !ocrpt_result_isnumber(rs)) {
+		ocrpt_expr_make_error_result(e, "invalid operand(s)");
+		return;
+	}
+
+	ocrpt_expr_set_number(e, ocrpt_result_get_number(rs));
+}
+
+static long get_long(ocrpt_expr *e) {
+	ocrpt_result *rs = ocrpt_expr_eval(e);
+
+	if (!ocrpt_result_isnumber(rs) || ocrpt_result_isnull(rs))
+		return -100L;
+
+	return mpfr_get_si(ocrpt_result_get_number(rs), MPFR_RNDN);
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_report *r = ocrpt_part_column_new_report(ocrpt_part_row_new_column(ocrpt_part_new_row(ocrpt_part_new(o))));
+	ocrpt_expr *e[EXPRS];
+	int calls = 0, volatile_calls = 0, lazy_calls = 0;
+	int32_t i, row = 0;
+
+	/* Only functions declared pure are shared */
+	ocrpt_function_add(o, "counted", my_counted, &calls, 1, false, false, false, false);
+	ocrpt_function_set_pure(o, "counted", true);
+	ocrpt_function_add(o, "volatile", my_counted, &volatile_calls, 1, false, false, false, false);
+	ocrpt_function_add(o, "counted2", my_counted, &lazy_calls, 1, false, false, false, false);
+	ocrpt_function_set_pure(o, "counted2", true);
+
+	ocrpt_report_set_main_query(r, q);
+
+	for (i = 0; i < EXPRS; i++)
+		e[i] = ocrpt_report_expr_parse(r, exprs[i], NULL);
+
+	ocrpt_report_resolve_expressions(r);
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		row++;
+		printf("row %d:", row);
+		for (i = 0; i < EXPRS; i++)
+			printf(" e%d %ld", i + 1, get_long(e[i]));
+		printf(" calls: %d volatile: %d lazy: %d\n", calls, volatile_calls, lazy_calls);
+	}
+
+	ocrpt_free(o);
+
+	return 0;
+}
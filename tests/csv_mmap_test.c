@@ -0,0 +1,92 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <opencreport.h>
+#include "test_common.h"
+
+/*
+ * CRLF line endings, quoted fields with delimiters, line breaks
+ * and escaped double quotes, NULL and empty values, an empty line,
+ * short and long rows and no line ending at the end of the file.
+ */
+static const char csvdata[] =
+	"id, name ,comment\r\n"
+	"1,\"Flintstone, Fred\",\"says \"\"yabba dabba doo\"\"\"\r\n"
+	"2,  Wilma  ,\r\n"
+	"\r\n"
+	"3,\"Pebbles\nFlintstone\",\"\"\r\n"
+	"4,Dino\r\n"
+	"5,Bamm-Bamm,strong,ignored\r\n"
+	"6,Barney,\"last row\"";
+
+#define COLS 3
+static const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_STRING, OCRPT_RESULT_STRING
+};
+
+static void print_value(ocrpt_query_result *qr, int32_t col) {
+	ocrpt_result *r = ocrpt_query_result_column_result(qr, col);
+
+	if (ocrpt_result_isnull(r))
+		printf(" NULL");
+	else
+		printf(" [%s]", ocrpt_result_get_string(r)->str);
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "csv", "csv", NULL);
+	char filename[] = "/tmp/csv_mmap_test.XXXXXX";
+	int fd = mkstemp(filename);
+	ocrpt_query *q;
+	ocrpt_query_result *qr;
+	ocrpt_expr *e;
+	int32_t cols, i, pass;
+
+	if (fd < 0 || write(fd, csvdata, strlen(csvdata)) != (ssize_t)strlen(csvdata)) {
+		fprintf(stderr, "cannot create the CSV file\n");
+		ocrpt_free(o);
+		return 1;
+	}
+	close(fd);
+
+	q = ocrpt_query_add_file(ds, "a", filename, coltypes, COLS);
+	qr = ocrpt_query_get_result(q, &cols);
+	printf("Query columns:\n");
+	for (i = 0; i < cols; i++)
+		printf("%d: '%s'\n", i, ocrpt_query_result_column_name(qr, i));
+
+	e = ocrpt_expr_parse(o, "id * 10", NULL);
+	ocrpt_expr_resolve(e);
+
+	/* The second pass reads the rows through the row index again */
+	for (pass = 1; pass <= 2; pass++) {
+		printf("Pass %d\n", pass);
+
+		ocrpt_query_navigate_start(q);
+
+		while (ocrpt_query_navigate_next(q)) {
+			qr = ocrpt_query_get_result(q, &cols);
+
+			printf("Row:");
+			for (i = 0; i < cols; i++)
+				print_value(qr, i);
+			printf(" id * 10 = %ld\n", ocrpt_expr_get_long(e));
+		}
+	}
+
+	ocrpt_expr_free(e);
+	ocrpt_free(o);
+
+	unlink(filename);
+
+	return 0;
+}
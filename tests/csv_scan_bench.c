@@ -0,0 +1,176 @@
+/*
+ * OpenCReports benchmark
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ *
+ * Cost of scanning a large CSV file: a generated file is
+ * parsed with libcsv, which is what the CSV input used before,
+ * then added as a CSV query (mapping and indexing the rows)
+ * and finally every row of the query is read.
+ *
+ * The libcsv callbacks only count the fields and rows,
+ * the old input also copied every field.
+ *
+ * Usage: csv_scan_bench [megabytes]
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <csv.h>
+
+#include <opencreport.h>
+
+#define DEFAULT_MEGABYTES 1024
+#define COLS 6
+
+static const char *cities[] = { "Budapest", "Wien", "Bratislava", "Praha", "Ljubljana", "Zagreb", "Beograd", "Bucuresti" };
+
+static const char *comments[] = {
+	"",
+	"delivered",
+	"\"left at the door, next to the \"\"blue\"\" box\"",
+	"customer asked for a call before the delivery but was not available at the given number",
+	"\"returned\nsecond attempt failed\"",
+};
+
+static double elapsed_ms(const struct timespec *start) {
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - start->tv_sec) * 1000.0 + (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static char *make_csv(long long bytes, long long *rows) {
+	char *filename = strdup("/tmp/csv_scan_bench.XXXXXX");
+	int fd = mkstemp(filename);
+	FILE *fp = (fd >= 0 ? fdopen(fd, "w") : NULL);
+	long long written, i;
+
+	if (!fp) {
+		if (fd >= 0)
+			close(fd);
+		free(filename);
+		return NULL;
+	}
+
+	written = fprintf(fp, "id,name,city,amount,date,comment\n");
+
+	for (i = 0; written < bytes; i++) {
+		written += fprintf(fp, "%lld,%s%lld%s,%s,%lld.%02lld,2026-%02lld-%02lld,%s\n",
+							i + 1,
+							i % 3 ? "Customer " : "\"Customer, Inc. ", i % 100000, i % 3 ? "" : "\"",
+							cities[i % 8],
+							(i * 7919) % 100000, i % 100,
+							i % 12 + 1, i % 28 + 1,
+							comments[i % 5]);
+	}
+
+	fclose(fp);
+
+	*rows = i;
+	return filename;
+}
+
+static void count_field(void *field, size_t len, void *data) {
+	long long *counts = data;
+
+	counts[0]++;
+}
+
+static void count_row(int c, void *data) {
+	long long *counts = data;
+
+	counts[1]++;
+}
+
+static void run_libcsv(const char *filename) {
+	struct timespec start;
+	struct csv_parser p;
+	struct stat st;
+	long long counts[2] = { 0, 0 };
+	char *map;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	csv_init(&p, CSV_STRICT | CSV_STRICT_FINI | CSV_APPEND_NULL | CSV_EMPTY_IS_NULL);
+	csv_parse(&p, map, st.st_size, count_field, count_row, counts);
+	csv_fini(&p, count_field, count_row, counts);
+	csv_free(&p);
+
+	printf("libcsv: rows: %lld fields: %lld time: %.3f ms\n", counts[1] - 1, counts[0], elapsed_ms(&start));
+
+	munmap(map, st.st_size);
+}
+
+static void run_ocrpt(const char *filename) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "csv", "csv", NULL);
+	struct timespec start;
+	ocrpt_query *q;
+	long long n = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	q = ocrpt_query_add_file(ds, "a", filename, NULL, 0);
+	if (!q) {
+		printf("csv: failed to add the query\n");
+		ocrpt_free(o);
+		return;
+	}
+
+	printf("csv index: time: %.3f ms\n", elapsed_ms(&start));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	ocrpt_query_navigate_start(q);
+	while (ocrpt_query_navigate_next(q))
+		n++;
+
+	printf("csv rows: rows: %lld cells: %lld time: %.3f ms\n", n, n * COLS, elapsed_ms(&start));
+
+	ocrpt_free(o);
+}
+
+int main(int argc, char **argv) {
+	long long megabytes = (argc > 1 ? atoll(argv[1]) : DEFAULT_MEGABYTES);
+	long long rows;
+	char *filename;
+
+	if (megabytes <= 0)
+		megabytes = DEFAULT_MEGABYTES;
+
+	filename = make_csv(megabytes * 1024 * 1024, &rows);
+	if (!filename)
+		return 1;
+
+	printf("file: %lld MB rows: %lld\n", megabytes, rows);
+
+	run_libcsv(filename);
+	run_ocrpt(filename);
+
+	unlink(filename);
+	free(filename);
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <opencreport.h>
+#include "test_common.h"
+
+#define ROWS 20000
+#define COLS 3
+
+static const char *comments[] = {
+	"plain",
+	"",
+	"\"with, a comma\"",
+	"\"spans\r\ntwo lines\"",
+	"\"\"\"quoted\"\"\"",
+	"  padded  ",
+	"\"a long comment that makes the chunk boundaries fall into quoted fields\nsometimes\"",
+};
+
+static const ocrpt_input_connect_parameter conn_params[] = {
+	{ .param_name = "threads", .param_value = "4" },
+	{ .param_name = NULL }
+};
+
+static char *make_csv(bool broken) {
+	char *filename = strdup("/tmp/csv_threads_test.XXXXXX");
+	int fd = mkstemp(filename);
+	FILE *fp = (fd >= 0 ? fdopen(fd, "w") : NULL);
+	int32_t i;
+
+	if (!fp) {
+		if (fd >= 0)
+			close(fd);
+		free(filename);
+		return NULL;
+	}
+
+	fprintf(fp, "id,name,comment\n");
+
+	for (i = 1; i <= ROWS; i++) {
+		fprintf(fp, "%d,%s%d%s,%s%s", i,
+				i % 5 ? "name " : "\"name\n", i, i % 5 ? "" : "\"",
+				comments[i % 7], i % 11 ? "\n" : "\r\n\r\n");
+
+		/* An unquoted field with a double quote */
+		if (broken && i == ROWS - 10)
+			fprintf(fp, "0,x\"y,z\n");
+	}
+
+	fclose(fp);
+
+	return filename;
+}
+
+static const char *value(ocrpt_query_result *qr, int32_t col) {
+	ocrpt_result *r = ocrpt_query_result_column_result(qr, col);
+
+	return ocrpt_result_isnull(r) ? NULL : ocrpt_result_get_string(r)->str;
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *serial = ocrpt_datasource_add(o, "serial", "csv", NULL);
+	ocrpt_datasource *parallel = ocrpt_datasource_add(o, "parallel", "csv", conn_params);
+	char *filename = make_csv(false);
+	char *broken = make_csv(true);
+	ocrpt_query *q1, *q2;
+	int32_t rows = 0, diffs = 0, nulls = 0;
+
+	if (!filename || !broken) {
+		fprintf(stderr, "cannot create the CSV files\n");
+		ocrpt_free(o);
+		return 1;
+	}
+
+	q1 = ocrpt_query_add_file(serial, "s", filename, NULL, 0);
+	q2 = ocrpt_query_add_file(parallel, "p", filename, NULL, 0);
+
+	ocrpt_query_navigate_start(q1);
+	ocrpt_query_navigate_start(q2);
+
+	for (;;) {
+		bool n1 = ocrpt_query_navigate_next(q1);
+		bool n2 = ocrpt_query_navigate_next(q2);
+		ocrpt_query_result *qr1, *qr2;
+		int32_t cols, i;
+
+		if (n1 != n2) {
+			printf("different number of rows\n");
+			break;
+		}
+		if (!n1)
+			break;
+
+		rows++;
+
+		qr1 = ocrpt_query_get_result(q1, &cols);
+		qr2 = ocrpt_query_get_result(q2, &cols);
+
+		for (i = 0; i < COLS; i++) {
+			const char *v1 = value(qr1, i);
+			const char *v2 = value(qr2, i);
+
+			if (!v1)
+				nulls++;
+			if ((v1 == NULL) != (v2 == NULL) || (v1 && strcmp(v1, v2)))
+				diffs++;
+		}
+	}
+
+	printf("rows: %d NULL values: %d different values: %d\n", rows, nulls, diffs);
+
+	/* Both fail the same way */
+	printf("broken file, serial: %s\n", ocrpt_query_add_file(serial, "sb", broken, NULL, 0) ? "added" : "failed");
+	printf("broken file, parallel: %s\n", ocrpt_query_add_file(parallel, "pb", broken, NULL, 0) ? "added" : "failed");
+
+	ocrpt_free(o);
+
+	unlink(filename);
+	unlink(broken);
+	free(filename);
+	free(broken);
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 16
+#define COLS 2
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "str", "dt" },
+	{ "1980-05-05", "1980-05-05" },
+	{ "1980-05-05 06:10:15", "1980-05-05 06:10:15" },
+	{ "1980-05-05T06:10:15.123456", "1980-05-05T06:10:15.123456" },
+	{ "2024-02-29 23:59", "2024-02-29 23:59" },
+	{ "2023-02-31 12:00:00", "2023-02-31 12:00:00" },
+	{ "1980-05-05 06:10p", "1980-05-05 06:10p" },
+	{ "5/5/1980", "5/5/1980" },
+	{ "05/05/80", "05/05/80" },
+	{ "05/05/1980 06:10", "05/05/1980 06:10" },
+	{ "05/05/1980 06:10:15", "05/05/1980 06:10:15" },
+	{ "05/05/1980 06:10:15p", "05/05/1980 06:10:15p" },
+	{ "06:10:15", "06:10:15" },
+	{ "06:10", "06:10" },
+	{ "19800505061015", "19800505061015" },
+	{ "0610p", "0610p" },
+	{ NULL, NULL }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_STRING, OCRPT_RESULT_DATETIME
+};
+
+static void print_datetime(ocrpt_result *r) {
+	const struct tm *tm;
+
+	if (ocrpt_result_isnull(r)) {
+		printf("NULL\n");
+		return;
+	}
+	if (!ocrpt_result_isdatetime(r)) {
+		ocrpt_result_print(r);
+		return;
+	}
+
+	tm = ocrpt_result_get_datetime(r);
+	printf("%04d-%02d-%02d %02d:%02d:%02d wday %d yday %d date %s time %s\n",
+			tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
+			tm->tm_hour, tm->tm_min, tm->tm_sec, tm->tm_wday, tm->tm_yday,
+			ocrpt_result_datetime_is_date_valid(r) ? "yes" : "no",
+			ocrpt_result_datetime_is_time_valid(r) ? "yes" : "no");
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_expr *e[COLS];
+	int32_t i;
+
+	/*
+	 * The datetime column remembers the formats of the previous
+	 * value, it must not change how the next value is parsed.
+	 */
+	e[0] = ocrpt_expr_parse(o, "str", NULL);
+	e[1] = ocrpt_expr_parse(o, "dt", NULL);
+	for (i = 0; i < COLS; i++)
+		ocrpt_expr_resolve(e[i]);
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		ocrpt_result *r = ocrpt_expr_eval(e[0]);
+
+		printf("%s\n", ocrpt_result_isnull(r) ? "NULL" : ocrpt_result_get_string(r)->str);
+		print_datetime(ocrpt_expr_eval(e[1]));
+		printf("\n");
+	}
+
+	for (i = 0; i < COLS; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 5
+#define COLS 2
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "id", "grp" },
+	{ "1", "1" },
+	{ "2", "1" },
+	{ "3", "2" },
+	{ "4", "2" },
+	{ "5", "2" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER
+};
+
+#define EXPRS 3
+static const char *exprs[EXPRS] = {
+	/* Only re-evaluated when grp changes */
+	"counted(grp) * 10",
+	/* id changes in every row */
+	"counted2(id) + grp",
+	/* rownum() is volatile, only the memo of counted3() helps */
+	"counted3(grp) + rownum() * 0",
+};
+
+/* Return the operand unchanged and count how many times it was called */
+OCRPT_STATIC_FUNCTION(my_counted) {
+	int *calls = user_data;
+	ocrpt_result *rs;
+
+	(*calls)++;
+
+	if (ocrpt_expr_get_num_operands(e) != 1 || !(rs = ocrpt_expr_operand_get_result(e, 0)) || !ocrpt_result_isnumber(rs)) {
+		ocrpt_expr_make_error_result(e, "invalid operand(s)");
+		return;
+	}
+
+	ocrpt_expr_set_number(e, ocrpt_result_get_number(rs));
+}
+
+static long get_long(ocrpt_expr *e) {
+	ocrpt_result *rs = ocrpt_expr_eval(e);
+
+	if (!ocrpt_result_isnumber(rs) || ocrpt_result_isnull(rs))
+		return -100L;
+
+	return mpfr_get_si(ocrpt_result_get_number(rs), MPFR_RNDN);
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_expr *e[EXPRS];
+	int calls[EXPRS] = { 0, 0, 0 };
+	int32_t i, row = 0;
+
+	ocrpt_function_add(o, "counted", my_counted, &calls[0], 1, false, false, false, false);
+	ocrpt_function_set_pure(o, "counted", true);
+	ocrpt_function_add(o, "counted2", my_counted, &calls[1], 1, false, false, false, false);
+	ocrpt_function_set_pure(o, "counted2", true);
+	ocrpt_function_add(o, "counted3", my_counted, &calls[2], 1, false, false, false, false);
+	ocrpt_function_set_pure(o, "counted3", true);
+
+	for (i = 0; i < EXPRS; i++) {
+		e[i] = ocrpt_expr_parse(o, exprs[i], NULL);
+		ocrpt_expr_resolve(e[i]);
+		ocrpt_expr_optimize(e[i]);
+	}
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		row++;
+		printf("row %d:", row);
+		for (i = 0; i < EXPRS; i++)
+			printf(" e%d %ld", i + 1, get_long(e[i]));
+		printf(" calls:");
+		for (i = 0; i < EXPRS; i++)
+			printf(" %d", calls[i]);
+		printf("\n");
+	}
+
+	/*
+	 * Rewinding the query invalidates the previous results,
+	 * counted() is still not called thanks to its memo
+	 */
+	ocrpt_query_navigate_start(q);
+	ocrpt_query_navigate_next(q);
+	printf("rewind: e1 %ld calls: %d\n", get_long(e[0]), calls[0]);
+
+	for (i = 0; i < EXPRS; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 8
+#define COLS 2
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "a", "f" },
+	{ "1", "a * 2" },
+	{ "2", "a + 1" },
+	{ "3", "a * 2" },
+	{ "4", "a + 1" },
+	{ "5", "m.x" },
+	{ "6", "a * 2" },
+	{ "7", "m.x" },
+	{ "8", "a - 1" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_STRING
+};
+
+static uint64_t parse_count(void) {
+	uint64_t hits, misses;
+
+	ocrpt_expr_parse_cache_get_stats(&hits, &misses, NULL);
+
+	return hits + misses;
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_expr *e, *f;
+	uint64_t start;
+	int32_t row = 0;
+
+	ocrpt_expr_parse_cache_clear();
+
+	ocrpt_set_mvariable(o, "x", "old value");
+
+	e = ocrpt_expr_parse(o, "eval(f)", NULL);
+	ocrpt_expr_resolve(e);
+	f = ocrpt_expr_parse(o, "f", NULL);
+	ocrpt_expr_resolve(f);
+
+	/*
+	 * Repeated formulas are parsed only once.
+	 * Setting an m. variable invalidates the cached
+	 * formulas because m.x was resolved to its value.
+	 */
+	start = parse_count();
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		ocrpt_result *r;
+
+		row++;
+		if (row == 6)
+			ocrpt_set_mvariable(o, "x", "new value");
+
+		r = ocrpt_expr_eval(e);
+		printf("row %d (parsed %" PRIu64 "): %s = ", row, parse_count() - start, ocrpt_result_get_string(ocrpt_expr_eval(f))->str);
+		if (ocrpt_result_isstring(r))
+			printf("%s\n", ocrpt_result_get_string(r)->str);
+		else
+			ocrpt_result_print(r);
+	}
+
+	ocrpt_expr_free(f);
+	ocrpt_expr_free(e);
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 6
+#define COLS 3
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "a", "n", "f" },
+	{ "1", "3", "%d" },
+	{ "-2.5", "1", "%.1d" },
+	{ "0.125", "10", "%.2d" },
+	{ "-0.001", "2", "%.3d" },
+	{ "1234567.891", "0", "%.2d" },
+	{ "0.05", "5", "%d" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, OCRPT_RESULT_STRING
+};
+
+/*
+ * The compiled format strings are reused across rows,
+ * except for the one coming from a column that changes
+ * on every row. Exact halfway cases, like 0.125 with
+ * 2 decimals, are formatted by MPFR.
+ */
+static const char *exprs[] = {
+	"format(a, '%d')",
+	"format(a, '%.2d')",
+	"format(a, '%-10.2d|')",
+	"format(a, '%08.1d')",
+	"format(a, f)",
+	"printf('%d items at %.2d each', n, a)",
+};
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	int32_t nexprs = sizeof(exprs) / sizeof(exprs[0]);
+	ocrpt_expr *e[nexprs];
+	int32_t i, row = 0;
+
+	for (i = 0; i < nexprs; i++) {
+		e[i] = ocrpt_expr_parse(o, exprs[i], NULL);
+		ocrpt_expr_resolve(e[i]);
+		ocrpt_expr_optimize(e[i]);
+	}
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		row++;
+		printf("row %d:\n", row);
+		for (i = 0; i < nexprs; i++) {
+			ocrpt_result *r = ocrpt_expr_eval(e[i]);
+
+			printf("%s = ", exprs[i]);
+			if (ocrpt_result_isstring(r))
+				printf("%s\n", ocrpt_result_get_string(r)->str);
+			else
+				ocrpt_result_print(r);
+		}
+	}
+
+	for (i = 0; i < nexprs; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	return 0;
+}
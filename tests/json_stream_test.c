@@ -0,0 +1,175 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <opencreport.h>
+#include "test_common.h"
+
+#define ROWS 5000
+#define BROKEN_ROW 4000
+
+static const char *leader[4][1] = {
+	{ "id" },
+	{ "1" },
+	{ "2500" },
+	{ "5000" }
+};
+
+static const int32_t leader_types[1] = { OCRPT_RESULT_NUMBER };
+
+/*
+ * The file is larger than what's parsed at once,
+ * so it's read incrementally in the first pass
+ * and kept in memory for the second pass and
+ * when it's used as an N:1 follower.
+ * The broken file has a syntax error in a row
+ * after the first block.
+ */
+static char *make_json(bool broken) {
+	char *filename = strdup("/tmp/json_stream_test.XXXXXX");
+	int fd = mkstemp(filename);
+	FILE *fp = (fd >= 0 ? fdopen(fd, "w") : NULL);
+	int32_t i;
+
+	if (!fp) {
+		if (fd >= 0)
+			close(fd);
+		free(filename);
+		return NULL;
+	}
+
+	fprintf(fp, "{\n\t\"columns\": [\"id\", \"name\", \"comment\"],\n\t\"coltypes\": [\"number\", \"string\", \"string\"],\n\t\"rows\": [\n");
+
+	for (i = 1; i <= ROWS; i++) {
+		fprintf(fp, "\t\t{ \"id\": %d, \"name\": \"Customer %d\"", i, i);
+		if (i % 3)
+			fprintf(fp, ", \"comment\": \"order %d was delivered on time\"", i * 7);
+		if (i % 10 == 0)
+			fprintf(fp, ", \"ignored\": \"ignored\"");
+		fprintf(fp, " %c%s\n", (broken && i == BROKEN_ROW) ? ']' : '}', i < ROWS ? "," : "");
+	}
+
+	fprintf(fp, "\t]\n}\n");
+	fclose(fp);
+
+	return filename;
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "json", "json", NULL);
+	ocrpt_datasource *ds2 = ocrpt_datasource_add(o, "array", "array", NULL);
+	char *filename = make_json(false);
+	char *broken = make_json(true);
+	ocrpt_query *q, *l, *b, *c;
+	ocrpt_expr *e[3], *lid, *bname, *match;
+	int32_t i, pass, rows;
+
+	if (!filename || !broken) {
+		fprintf(stderr, "cannot create the JSON file\n");
+		ocrpt_free(o);
+		if (filename) {
+			unlink(filename);
+			free(filename);
+		}
+		if (broken) {
+			unlink(broken);
+			free(broken);
+		}
+		return 1;
+	}
+
+	q = ocrpt_query_add_file(ds, "a", filename, NULL, 0);
+	if (!q) {
+		printf("adding the query failed\n");
+		ocrpt_free(o);
+		unlink(filename);
+		free(filename);
+		unlink(broken);
+		free(broken);
+		return 0;
+	}
+
+	e[0] = ocrpt_expr_parse(o, "id * 2", NULL);
+	e[1] = ocrpt_expr_parse(o, "name", NULL);
+	e[2] = ocrpt_expr_parse(o, "comment", NULL);
+	for (i = 0; i < 3; i++)
+		ocrpt_expr_resolve(e[i]);
+
+	for (pass = 1; pass <= 2; pass++) {
+		int32_t rows = 0, nulls = 0;
+		long sum = 0;
+
+		ocrpt_query_navigate_start(q);
+
+		while (ocrpt_query_navigate_next(q)) {
+			long id2 = ocrpt_expr_get_long(e[0]);
+			ocrpt_result *r1 = ocrpt_expr_eval(e[1]);
+			ocrpt_result *r2 = ocrpt_expr_eval(e[2]);
+
+			rows++;
+			sum += id2;
+			if (ocrpt_result_isnull(r2))
+				nulls++;
+
+			if (rows <= 3 || rows == ROWS)
+				printf("pass %d row %d: id * 2 = %ld name = '%s' comment = %s%s%s\n", pass, rows,
+						id2, ocrpt_result_get_string(r1)->str,
+						ocrpt_result_isnull(r2) ? "" : "'",
+						ocrpt_result_isnull(r2) ? "NULL" : ocrpt_result_get_string(r2)->str,
+						ocrpt_result_isnull(r2) ? "" : "'");
+		}
+
+		printf("pass %d: rows %d sum of id * 2 %ld NULL comments %d\n", pass, rows, sum, nulls);
+	}
+
+	for (i = 0; i < 3; i++)
+		ocrpt_expr_free(e[i]);
+
+	l = ocrpt_query_add_data(ds2, "l", (const char **)leader, 3, 1, leader_types, 1);
+	b = ocrpt_query_add_file(ds, "b", filename, NULL, 0);
+	match = ocrpt_expr_parse(o, "l.id = b.id", NULL);
+	ocrpt_query_add_follower_n_to_1(l, b, match);
+
+	lid = ocrpt_expr_parse(o, "l.id", NULL);
+	bname = ocrpt_expr_parse(o, "b.name", NULL);
+	ocrpt_expr_resolve(lid);
+	ocrpt_expr_resolve(bname);
+
+	ocrpt_query_navigate_start(l);
+
+	while (ocrpt_query_navigate_next(l))
+		printf("follower: id %ld name '%s'\n", ocrpt_expr_get_long(lid), ocrpt_result_get_string(ocrpt_expr_eval(bname))->str);
+
+	ocrpt_expr_free(lid);
+	ocrpt_expr_free(bname);
+
+	/* The syntax error is reported, the rows before it are not a valid result */
+	c = ocrpt_query_add_file(ds, "c", broken, NULL, 0);
+
+	rows = 0;
+	ocrpt_query_navigate_start(c);
+
+	while (ocrpt_query_navigate_next(c))
+		rows++;
+
+	printf("broken: %s, error %s\n",
+			rows < BROKEN_ROW ? "stopped before the error" : "read past the error",
+			ocrpt_query_get_error(c) ? "reported" : "not reported");
+
+	ocrpt_free(o);
+
+	unlink(filename);
+	free(filename);
+	unlink(broken);
+	free(broken);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 3
+#define COLS 3
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "a", "d", "unused" },
+	{ "1", "1980-05-05", "10" },
+	{ "2", "bad", "20" },
+	{ "3", NULL, "30" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_DATETIME, OCRPT_RESULT_NUMBER
+};
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_expr *e, *e2 = NULL;
+	int32_t cols, i, row = 0;
+
+	/* Only the columns used by expressions are converted while reading the rows */
+	e = ocrpt_expr_parse(o, "a * 2", NULL);
+	ocrpt_expr_resolve(e);
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		row++;
+		printf("row %d:\n", row);
+
+		/* Using a column converts the values already read */
+		if (row == 2) {
+			e2 = ocrpt_expr_parse(o, "unused + 1", NULL);
+			ocrpt_expr_resolve(e2);
+		}
+
+		if (e2) {
+			printf("unused + 1 = ");
+			ocrpt_result_print(ocrpt_expr_eval(e2));
+		}
+
+		printf("a * 2 = ");
+		ocrpt_result_print(ocrpt_expr_eval(e));
+
+		printf("\n");
+	}
+
+	/* Accessing the result array directly converts every column */
+	row = 0;
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		ocrpt_query_result *qr = ocrpt_query_get_result(q, &cols);
+
+		row++;
+		printf("pass 2 row %d:\n", row);
+
+		for (i = 0; i < cols; i++) {
+			printf("%s: ", ocrpt_query_result_column_name(qr, i));
+			ocrpt_result_print(ocrpt_query_result_column_result(qr, i));
+		}
+
+		printf("\n");
+	}
+
+	ocrpt_expr_free(e);
+	ocrpt_expr_free(e2);
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 5
+#define COLS 2
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "id", "name" },
+	{ "1", "Fred Flintstone" },
+	{ "2", "Wilma Flintstone" },
+	{ "3", "Pebbles Flintstone" },
+	{ "4", "Betty Rubble" },
+	{ "5", "Barney Rubble" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_STRING
+};
+
+static int calls;
+
+/* Return the operand unchanged and count how many times it was called */
+OCRPT_STATIC_FUNCTION(my_counted) {
+	ocrpt_result *rs;
+
+	calls++;
+
+	if (ocrpt_expr_get_num_operands(e) != 1 || !(rs = ocrpt_expr_operand_get_result(e, 0)) || !ocrpt_result_isnumber(rs)) {
+		ocrpt_expr_make_error_result(e, "invalid operand(s)");
+		return;
+	}
+
+	ocrpt_expr_set_number(e, ocrpt_result_get_number(rs));
+}
+
+static long get_long(ocrpt_expr *e) {
+	ocrpt_result *rs = ocrpt_expr_eval(e);
+
+	if (!ocrpt_result_isnumber(rs) || ocrpt_result_isnull(rs))
+		return -100L;
+
+	return mpfr_get_si(ocrpt_result_get_number(rs), MPFR_RNDN);
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_expr *e1, *e2, *e3, *e4;
+	const ocrpt_string *s;
+	int row = 0;
+
+	ocrpt_function_add(o, "counted", my_counted, NULL, 1, false, false, false, false);
+
+	/* Only the selected branch is evaluated */
+	e1 = ocrpt_expr_parse(o, "id > 2 ? counted(id) : counted(-id)", NULL);
+	ocrpt_expr_resolve(e1);
+	ocrpt_expr_optimize(e1);
+
+	/* The second operand is only evaluated if the first is true */
+	e2 = ocrpt_expr_parse(o, "id > 3 && counted(id) > 0", NULL);
+	ocrpt_expr_resolve(e2);
+	ocrpt_expr_optimize(e2);
+
+	/* The second operand is only evaluated if the first is false */
+	e3 = ocrpt_expr_parse(o, "id < 3 || counted(id) > 0", NULL);
+	ocrpt_expr_resolve(e3);
+	ocrpt_expr_optimize(e3);
+
+	/* The condition is constant, the other branch is dropped */
+	e4 = ocrpt_expr_parse(o, "iif(1, 'constant', counted(id))", NULL);
+	ocrpt_expr_resolve(e4);
+	ocrpt_expr_optimize(e4);
+	s = ocrpt_expr_get_string(e4);
+	printf("e4 nodes: %d value: %s calls: %d\n", ocrpt_expr_nodes(e4), s ? s->str : "NULL", calls);
+	printf("\n");
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		long v1, v2, v3;
+
+		row++;
+		v1 = get_long(e1);
+		v2 = get_long(e2);
+		v3 = get_long(e3);
+
+		printf("row %d: e1 %ld e2 %ld e3 %ld calls: %d\n", row, v1, v2, v3, calls);
+	}
+
+	ocrpt_expr_free(e1);
+	ocrpt_expr_free(e2);
+	ocrpt_expr_free(e3);
+	ocrpt_expr_free(e4);
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 8
+#define COLS 3
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "id", "grp", "val" },
+	{ "1", "0", "5" },
+	{ "2", "0", NULL },
+	{ "3", "0", "-2.5" },
+	{ "4", "0", "10" },
+	{ "5", "1", "3" },
+	{ "6", "1", NULL },
+	{ "7", "1", "7" },
+	{ "8", "1", "1.5" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER
+};
+
+#define SUM_EXPR "(brrownum('grp') == 1 ? 0 : r.self) + ((r.ignoreexpr || isnull(r.baseexpr)) ? 0 : r.baseexpr)"
+#define COUNT_EXPR "r.self + ((r.ignoreexpr || isnull(r.baseexpr)) ? 0 : 1)"
+
+/*
+ * The built-in variable types are computed natively.
+ * Every one of them is added again as a custom variable
+ * with the expressions that describe the same computation.
+ */
+static const struct {
+	ocrpt_var_type type;
+	const char *name;
+	const char *baseexpr;
+	const char *intermedexpr;
+	const char *intermed2expr;
+	const char *resultexpr;
+} vars[] = {
+	{ OCRPT_VARIABLE_SUM, "sum", "val", NULL, NULL, SUM_EXPR },
+	{ OCRPT_VARIABLE_COUNT, "count", "val", NULL, NULL, COUNT_EXPR },
+	{ OCRPT_VARIABLE_COUNTALL, "countall", NULL, NULL, NULL, "r.self + (r.ignoreexpr ? 0 : 1)" },
+	{ OCRPT_VARIABLE_AVERAGE, "avg", "val", SUM_EXPR, COUNT_EXPR, "r.intermedexpr / r.intermed2expr" },
+	{ OCRPT_VARIABLE_AVERAGEALL, "avgall", "val", SUM_EXPR, NULL, "r.intermedexpr / brrownum('grp')" },
+	{ OCRPT_VARIABLE_LOWEST, "lowest", "val", NULL, NULL,
+		"brrownum('grp') == 1 ? (r.baseexpr) : (isnull(r.self) ? (r.baseexpr) : "
+		"((r.ignoreexpr || isnull(r.baseexpr)) ? r.self : (r.self < (r.baseexpr) ? r.self : (r.baseexpr))))" },
+	{ OCRPT_VARIABLE_HIGHEST, "highest", "val", NULL, NULL,
+		"brrownum('grp') == 1 ? (r.baseexpr) : (isnull(r.self) ? (r.baseexpr) : "
+		"((r.ignoreexpr || isnull(r.baseexpr)) ? r.self : (r.self > (r.baseexpr) ? r.self : (r.baseexpr))))" },
+};
+#define VARS (sizeof(vars) / sizeof(vars[0]))
+
+struct rowdata {
+	ocrpt_expr *id;
+	ocrpt_expr *native[VARS];
+	ocrpt_expr *custom[VARS];
+};
+
+static void print_result(ocrpt_result *rs) {
+	if (ocrpt_result_isnull(rs))
+		printf("NULL");
+	else if (ocrpt_result_isnumber(rs))
+		printf("%.6f", mpfr_get_d(ocrpt_result_get_number(rs), MPFR_RNDN));
+	else {
+		ocrpt_string *s = ocrpt_result_get_string(rs);
+
+		printf("%s", s ? s->str : "(unknown)");
+	}
+}
+
+static void test_newrow_cb(opencreport *o, ocrpt_report *r, void *ptr) {
+	struct rowdata *rd = ptr;
+	uint32_t i;
+
+	printf("row %ld:\n", ocrpt_expr_get_long(rd->id));
+
+	for (i = 0; i < VARS; i++) {
+		printf("\t%s: ", vars[i].name);
+		print_result(ocrpt_expr_eval(rd->native[i]));
+		printf(" ");
+		print_result(ocrpt_expr_eval(rd->custom[i]));
+		printf("\n");
+	}
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_report *r = ocrpt_part_column_new_report(ocrpt_part_row_new_column(ocrpt_part_new_row(ocrpt_part_new(o))));
+	ocrpt_query *q;
+	ocrpt_break *br;
+	struct rowdata rd;
+	uint32_t i;
+
+	q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_report_set_main_query(r, q);
+
+	br = ocrpt_break_new(r, "grp");
+	ocrpt_break_add_breakfield(br, ocrpt_report_expr_parse(r, "grp", NULL));
+
+	rd.id = ocrpt_report_expr_parse(r, "id", NULL);
+
+	for (i = 0; i < VARS; i++) {
+		char name[64], vexpr[80];
+
+		/* The value in row 7 is ignored */
+		snprintf(name, sizeof(name), "native_%s", vars[i].name);
+		ocrpt_variable_new(r, vars[i].type, name, vars[i].baseexpr, "id == 7", "grp", false);
+		snprintf(vexpr, sizeof(vexpr), "v.%s", name);
+		rd.native[i] = ocrpt_report_expr_parse(r, vexpr, NULL);
+
+		snprintf(name, sizeof(name), "custom_%s", vars[i].name);
+		ocrpt_variable_new_full(r, OCRPT_RESULT_NUMBER, name, vars[i].baseexpr, "id == 7", vars[i].intermedexpr, vars[i].intermed2expr, vars[i].resultexpr, "grp", false);
+		snprintf(vexpr, sizeof(vexpr), "v.%s", name);
+		rd.custom[i] = ocrpt_report_expr_parse(r, vexpr, NULL);
+	}
+
+	if (!ocrpt_report_add_new_row_cb(r, test_newrow_cb, &rd)) {
+		fprintf(stderr, "Failed to add new row callback.\n");
+		ocrpt_free(o);
+		return 1;
+	}
+
+	ocrpt_execute(o);
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * OpenCReports benchmark
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ *
+ * Cost of converting numeric cells while reading a query:
+ * the same integers and fixed-point decimals are read from
+ * an array and from a CSV file.
+ *
+ * Usage: numeric_ingest_bench [cells]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <opencreport.h>
+
+#define DEFAULT_CELLS 10000000
+#define COLS 10
+#define VALUES 1000
+
+static const char *colnames[COLS] = { "c0", "c1", "c2", "c3", "c4", "c5", "c6", "c7", "c8", "c9" };
+
+static int32_t coltypes[COLS];
+
+static char *values[VALUES];
+
+static void make_values(void) {
+	char buf[32];
+	int32_t i;
+
+	for (i = 0; i < VALUES; i++) {
+		switch (i % 4) {
+		case 0:
+			snprintf(buf, sizeof(buf), "%d", i * 37);
+			break;
+		case 1:
+			snprintf(buf, sizeof(buf), "-%d", i * 101);
+			break;
+		case 2:
+			snprintf(buf, sizeof(buf), "%d.%02d", i * 13, i % 100);
+			break;
+		default:
+			snprintf(buf, sizeof(buf), "-%d.%04d", i, (i * 7919) % 10000);
+			break;
+		}
+		values[i] = strdup(buf);
+	}
+}
+
+static const char **make_data(int32_t rows) {
+	const char **data = malloc((rows + 1) * COLS * sizeof(char *));
+	int32_t i, j;
+
+	for (j = 0; j < COLS; j++)
+		data[j] = colnames[j];
+
+	for (i = 1; i <= rows; i++)
+		for (j = 0; j < COLS; j++)
+			data[i * COLS + j] = values[(i * 7 + j * 131) % VALUES];
+
+	return data;
+}
+
+static char *make_csv(const char **data, int32_t rows) {
+	char *filename = strdup("/tmp/numeric_ingest_bench.XXXXXX");
+	int fd = mkstemp(filename);
+	FILE *fp = (fd >= 0 ? fdopen(fd, "w") : NULL);
+	int32_t i, j;
+
+	if (!fp) {
+		if (fd >= 0)
+			close(fd);
+		free(filename);
+		return NULL;
+	}
+
+	for (i = 0; i <= rows; i++)
+		for (j = 0; j < COLS; j++)
+			fprintf(fp, "%s%c", data[i * COLS + j], j == COLS - 1 ? '\n' : ',');
+
+	fclose(fp);
+
+	return filename;
+}
+
+static void run(const char *input, const char **data, const char *filename, int32_t rows) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, input, input, NULL);
+	ocrpt_query *q;
+	struct timespec start, end;
+	int32_t n = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (data)
+		q = ocrpt_query_add_data(ds, "a", data, rows, COLS, coltypes, COLS);
+	else
+		q = ocrpt_query_add_file(ds, "a", filename, coltypes, COLS);
+
+	ocrpt_query_navigate_start(q);
+	while (ocrpt_query_navigate_next(q))
+		n++;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%s: rows: %d cells: %lld time: %.3f ms\n", input, n, (long long)n * COLS,
+			(end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+
+	ocrpt_free(o);
+}
+
+int main(int argc, char **argv) {
+	long long cells = (argc > 1 ? atoll(argv[1]) : DEFAULT_CELLS);
+	int32_t rows, i;
+	const char **data;
+	char *filename;
+
+	if (cells <= 0)
+		cells = DEFAULT_CELLS;
+	rows = (cells + COLS - 1) / COLS;
+
+	for (i = 0; i < COLS; i++)
+		coltypes[i] = OCRPT_RESULT_NUMBER;
+
+	make_values();
+	data = make_data(rows);
+
+	run("array", data, NULL, rows);
+
+	filename = make_csv(data, rows);
+	if (filename) {
+		run("csv", NULL, filename, rows);
+		unlink(filename);
+		free(filename);
+	}
+
+	free(data);
+	for (i = 0; i < VALUES; i++)
+		free(values[i]);
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <opencreport.h>
+
+OCRPT_STATIC_FUNCTION(my_func) {
+	ocrpt_expr_init_result(e, OCRPT_RESULT_NUMBER);
+}
+
+static void print_stats(const char *step) {
+	uint64_t hits, misses;
+	uint32_t entries;
+
+	ocrpt_expr_parse_cache_get_stats(&hits, &misses, &entries);
+	printf("%s: hits %" PRIu64 " misses %" PRIu64 " entries %" PRIu32 "\n\n", step, hits, misses, entries);
+}
+
+static void parse_print(opencreport *o, const char *str) {
+	char *err = NULL;
+	ocrpt_expr *e = ocrpt_expr_parse(o, str, &err);
+
+	printf("%s: ", str);
+	if (e)
+		ocrpt_expr_print(e);
+	else
+		printf("error\n");
+
+	ocrpt_strfree(err);
+	ocrpt_expr_free(e);
+}
+
+static void parse_print_number(opencreport *o, const char *str) {
+	ocrpt_expr *e = ocrpt_expr_parse(o, str, NULL);
+	mpfr_ptr number = ocrpt_result_get_number(ocrpt_expr_get_result(e));
+
+	mpfr_printf("%s: precision %ld value %.25Rf\n", str, (long)mpfr_get_prec(number), number);
+
+	ocrpt_expr_free(e);
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	opencreport *o2 = ocrpt_init();
+
+	ocrpt_expr_parse_cache_clear();
+	printf("cache size: %" PRIu32 "\n", ocrpt_expr_parse_cache_get_size());
+	print_stats("start");
+
+	parse_print(o, "1.5 + a * 'x'");
+	parse_print(o, "1.5 + a * 'x'");
+	print_stats("same expression twice");
+
+	parse_print(o, "r.pageno == v.var1 ? m.'x' : upper(q.b)");
+	parse_print(o, "r.pageno == v.var1 ? m.'x' : upper(q.b)");
+	print_stats("identifiers and functions");
+
+	parse_print(o, "1 +");
+	parse_print(o, "1 +");
+	print_stats("syntax errors are not cached");
+
+	parse_print(o, "eval('2 * 3') + 1");
+	parse_print(o, "eval('2 * 3') + 1");
+	print_stats("only the inlined eval() argument is cached");
+
+	parse_print_number(o, "0.1");
+	ocrpt_set_numeric_precision_bits(o, "53");
+	parse_print_number(o, "0.1");
+	parse_print_number(o, "0.1");
+	print_stats("numeric precision is part of the key");
+
+	ocrpt_function_add(o2, "my_func", my_func, NULL, 1, false, false, false, false);
+	parse_print(o2, "1.5 + a * 'x'");
+	parse_print(o2, "my_func(1)");
+	print_stats("user defined functions bypass the cache");
+
+	ocrpt_expr_parse_cache_set_size(2);
+	printf("cache size: %" PRIu32 "\n", ocrpt_expr_parse_cache_get_size());
+	print_stats("shrinking empties the cache");
+
+	parse_print(o, "a");
+	parse_print(o, "b");
+	parse_print(o, "c");
+	parse_print(o, "c");
+	parse_print(o, "a");
+	print_stats("full cache");
+
+	ocrpt_expr_parse_cache_set_size(0);
+	parse_print(o, "a");
+	print_stats("disabled cache");
+
+	ocrpt_expr_parse_cache_clear();
+	print_stats("cleared");
+
+	ocrpt_free(o2);
+	ocrpt_free(o);
+
+	return 0;
+}
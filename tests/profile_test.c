@@ -0,0 +1,119 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 4
+#define COLS 1
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "a" },
+	{ "1" },
+	{ "2" },
+	{ "3" },
+	{ "4" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER
+};
+
+#define EXPRS 3
+static const char *exprs[EXPRS] = {
+	"a + 1",
+	"my_func(a) * 2",
+	"a - 1",
+};
+
+/* Return the operand unchanged */
+OCRPT_STATIC_FUNCTION(my_func) {
+	ocrpt_result *rs;
+
+	if (ocrpt_expr_get_num_operands(e) != 1 || !(rs = ocrpt_expr_operand_get_result(e, 0)) || !ocrpt_result_isnumber(rs)) {
+		ocrpt_expr_make_error_result(e, "invalid operand(s)");
+		return;
+	}
+
+	ocrpt_expr_set_number(e, ocrpt_result_get_number(rs));
+}
+
+static void print_profile(ocrpt_expr **e, opencreport *o) {
+	uint64_t calls, total_ns, self_ns;
+	int32_t i;
+
+	for (i = 0; i < EXPRS; i++) {
+		if (ocrpt_expr_get_profile(e[i], &calls, &total_ns, &self_ns))
+			printf("%s: calls %" PRIu64 " self <= total %s\n", exprs[i], calls, self_ns <= total_ns ? "yes" : "no");
+		else
+			printf("%s: not profiled\n", exprs[i]);
+	}
+
+	if (ocrpt_function_get_profile(o, "my_func", &calls, NULL))
+		printf("my_func: calls %" PRIu64 "\n", calls);
+	printf("add is a user defined function: %s\n", ocrpt_function_get_profile(o, "add", NULL, NULL) ? "yes" : "no");
+	printf("\n");
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_expr *e[EXPRS];
+	int32_t i, row = 0;
+
+	ocrpt_function_add(o, "my_func", my_func, NULL, 1, false, false, false, false);
+
+	for (i = 0; i < EXPRS; i++) {
+		e[i] = ocrpt_expr_parse(o, exprs[i], NULL);
+		ocrpt_expr_resolve(e[i]);
+		ocrpt_expr_optimize(e[i]);
+	}
+
+	printf("profiling: %s\n\n", ocrpt_get_profiling(o) ? "enabled" : "disabled");
+
+	/* Without profiling support in the library, it can't be enabled */
+	if (!ocrpt_set_profiling(o, false)) {
+		printf("profiling is not supported\n");
+		printf("enabling it: %s\n", ocrpt_set_profiling(o, true) ? "succeeded" : "failed");
+		printf("profiling: %s\n", ocrpt_get_profiling(o) ? "enabled" : "disabled");
+
+		for (i = 0; i < EXPRS; i++)
+			ocrpt_expr_free(e[i]);
+
+		ocrpt_free(o);
+
+		return 0;
+	}
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		row++;
+
+		/* Profile the 2nd and 3rd rows */
+		ocrpt_set_profiling(o, row == 2 || row == 3);
+
+		/* The last expression is never evaluated */
+		for (i = 0; i < EXPRS - 1; i++)
+			ocrpt_expr_eval(e[i]);
+
+		printf("row %d profiling: %s\n", row, ocrpt_get_profiling(o) ? "enabled" : "disabled");
+		print_profile(e, o);
+	}
+
+	ocrpt_profile_reset(o);
+	printf("after reset\n");
+	print_profile(e, o);
+
+	for (i = 0; i < EXPRS; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 8
+#define COLS 1
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "status" },
+	{ "new" },
+	{ "paid" },
+	{ "new" },
+	{ "paid" },
+	{ "overdue" },
+	{ "new" },
+	{ "overdue" },
+	{ "paid" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_STRING
+};
+
+#define EXPRS 5
+static const char *exprs[EXPRS] = {
+	"proper(status)",
+	"upper(status) + '!'",
+	/* Memoized user defined function */
+	"label(status)",
+	/* Not memoized, it's called for every row */
+	"counted(status)",
+	/* Constant, it's evaluated only once by the optimizer */
+	"upper('paid')",
+};
+
+/* Prefix the operand and count how many times it was called */
+OCRPT_STATIC_FUNCTION(my_label) {
+	int *calls = user_data;
+	ocrpt_result *rs;
+	char buf[64];
+
+	(*calls)++;
+
+	if (ocrpt_expr_get_num_operands(e) != 1 || !(rs = ocrpt_expr_operand_get_result(e, 0)) || !ocrpt_result_isstring(rs)) {
+		ocrpt_expr_make_error_result(e, "invalid operand(s)");
+		return;
+	}
+
+	snprintf(buf, sizeof(buf), "status: %s", ocrpt_result_get_string(rs)->str);
+	ocrpt_expr_set_string(e, buf);
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	ocrpt_expr *e[EXPRS];
+	int calls[2] = { 0, 0 };
+	int32_t i, row = 0;
+
+	ocrpt_function_add(o, "label", my_label, &calls[0], 1, false, false, false, false);
+	ocrpt_function_set_pure(o, "label", true);
+	ocrpt_function_add(o, "counted", my_label, &calls[1], 1, false, false, false, false);
+
+	for (i = 0; i < EXPRS; i++) {
+		e[i] = ocrpt_expr_parse(o, exprs[i], NULL);
+		ocrpt_expr_resolve(e[i]);
+		ocrpt_expr_optimize(e[i]);
+	}
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		row++;
+		printf("row %d:", row);
+		for (i = 0; i < EXPRS; i++)
+			printf(" '%s'", ocrpt_result_get_string(ocrpt_expr_eval(e[i]))->str);
+		printf(" calls: %d %d\n", calls[0], calls[1]);
+	}
+
+	printf("\n");
+
+	for (i = 0; i < EXPRS; i++) {
+		uint64_t hits, misses;
+
+		if (ocrpt_expr_get_memo_stats(e[i], &hits, &misses))
+			printf("%s: hits %" PRIu64 " misses %" PRIu64 "\n", exprs[i], hits, misses);
+		else
+			printf("%s: not memoized\n", exprs[i]);
+	}
+
+	for (i = 0; i < EXPRS; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+/*
+ * Results of freed expressions are recycled for later ones.
+ * Recycled results must behave as freshly allocated ones,
+ * regardless of the type of the previous value.
+ */
+static const char *exprs[] = {
+	"'abc' + 'def'",
+	"1 + 2",
+	"stodt('2026-10-17')",
+	"upper('x') + 1",
+	"'' + ''",
+	"nulls()",
+	"1 / 3",
+};
+
+static void parse_eval_print(opencreport *o, const char *str) {
+	ocrpt_expr *e = ocrpt_expr_parse(o, str, NULL);
+	ocrpt_result *r;
+
+	ocrpt_expr_resolve(e);
+	ocrpt_expr_optimize(e);
+	r = ocrpt_expr_eval(e);
+
+	printf("%s: ", str);
+	if (ocrpt_result_isnumber(r))
+		mpfr_printf("precision %ld ", (long)mpfr_get_prec(ocrpt_result_get_number(r)));
+	ocrpt_result_print(r);
+
+	ocrpt_expr_free(e);
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	int32_t i, round;
+
+	for (round = 0; round < 2; round++) {
+		for (i = 0; i < (int32_t)(sizeof(exprs) / sizeof(exprs[0])); i++)
+			parse_eval_print(o, exprs[i]);
+		printf("\n");
+
+		/* Recycled numbers are switched to the new precision */
+		ocrpt_set_numeric_precision_bits(o, "64");
+	}
+
+	ocrpt_free(o);
+
+	return 0;
+}
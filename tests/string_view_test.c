@@ -0,0 +1,86 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 3
+#define COLS 1
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "s" },
+	{ "hello world" },
+	{ "" },
+	{ "árvíztűrő" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_STRING
+};
+
+static const char *exprs[] = {
+	"right(s, 3)",
+	"left(s, 3)",
+	"left(s, 100)",
+	"mid(s, 2, 100)",
+	"mid(s, 2, 2)",
+	"mid(s, -3, 2)",
+	"s + ''",
+	"'' + s + ''",
+	"s + 'x'",
+	"concat('', s)",
+};
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	int32_t nexprs = sizeof(exprs) / sizeof(exprs[0]);
+	ocrpt_expr *e[nexprs];
+	ocrpt_string *source, *view;
+	int32_t i, row = 0;
+
+	for (i = 0; i < nexprs; i++) {
+		e[i] = ocrpt_expr_parse(o, exprs[i], NULL);
+		ocrpt_expr_resolve(e[i]);
+		ocrpt_expr_optimize(e[i]);
+	}
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		row++;
+		printf("row %d:\n", row);
+		for (i = 0; i < nexprs; i++) {
+			ocrpt_string *s = ocrpt_result_get_string(ocrpt_expr_eval(e[i]));
+
+			printf("%s = '%s' len %zu view %s\n", exprs[i], s->str, s->len, ocrpt_mem_string_is_view(s) ? "yes" : "no");
+		}
+		printf("\n");
+	}
+
+	for (i = 0; i < nexprs; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	/* Appending to a view makes a private copy of it */
+	source = ocrpt_mem_string_new("abcdef", true);
+	view = ocrpt_mem_string_view(NULL, source->str + 3, source->len - 3);
+	printf("view: '%s' view %s\n", view->str, ocrpt_mem_string_is_view(view) ? "yes" : "no");
+	ocrpt_mem_string_append(view, "gh");
+	printf("view: '%s' view %s\n", view->str, ocrpt_mem_string_is_view(view) ? "yes" : "no");
+	printf("source: '%s'\n", source->str);
+
+	/* Making it a view again frees the private copy */
+	view = ocrpt_mem_string_view(view, source->str, source->len);
+	printf("view: '%s' view %s\n", view->str, ocrpt_mem_string_is_view(view) ? "yes" : "no");
+
+	ocrpt_mem_string_free(view, true);
+	ocrpt_mem_string_free(source, true);
+
+	return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+
+#define ROWS 4
+#define COLS 4
+/* NOT static */ const char *array[ROWS + 1][COLS] = {
+	{ "a", "b", "s", "t" },
+	{ "1", "2", "x", "y" },
+	{ "5", "3", "b", "b" },
+	{ NULL, "4", NULL, "z" },
+	{ "2.5", "0", "abc", "ab" }
+};
+
+/* NOT static */ const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, OCRPT_RESULT_STRING, OCRPT_RESULT_STRING
+};
+
+/*
+ * The operand types of these are known after resolving,
+ * except the last one with mixed operand types.
+ * NULL values are handled by the generic functions.
+ */
+static const char *exprs[] = {
+	"a + b",
+	"a - b - 1",
+	"a * b",
+	"a / b",
+	"-a",
+	"a < b",
+	"a == b",
+	"s + t",
+	"concat(s, t, '!')",
+	"s >= t",
+	"s + a",
+};
+
+static void print_result(ocrpt_result *r) {
+	if (ocrpt_result_isnull(r))
+		printf("NULL\n");
+	else if (ocrpt_result_isnumber(r))
+		printf("%g\n", mpfr_get_d(ocrpt_result_get_number(r), MPFR_RNDN));
+	else if (ocrpt_result_isstring(r))
+		printf("%s\n", ocrpt_result_get_string(r)->str);
+	else
+		ocrpt_result_print(r);
+}
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	ocrpt_query *q = ocrpt_query_add_data(ds, "a", (const char **)array, ROWS, COLS, coltypes, COLS);
+	int32_t nexprs = sizeof(exprs) / sizeof(exprs[0]);
+	ocrpt_expr *e[nexprs];
+	int32_t i, row = 0;
+
+	for (i = 0; i < nexprs; i++) {
+		e[i] = ocrpt_expr_parse(o, exprs[i], NULL);
+		ocrpt_expr_resolve(e[i]);
+		ocrpt_expr_optimize(e[i]);
+	}
+
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		row++;
+		printf("row %d:\n", row);
+		for (i = 0; i < nexprs; i++) {
+			printf("%s = ", exprs[i]);
+			print_result(ocrpt_expr_eval(e[i]));
+		}
+	}
+
+	for (i = 0; i < nexprs; i++)
+		ocrpt_expr_free(e[i]);
+
+	ocrpt_free(o);
+
+	return 0;
+}
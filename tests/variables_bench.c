@@ -0,0 +1,127 @@
+/*
+ * OpenCReports benchmark
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ *
+ * Evaluation cost of a variable-heavy report: every numeric
+ * column is aggregated with SUM, AVERAGE, COUNT, LOWEST and
+ * HIGHEST for every break and for the whole report.
+ *
+ * Usage: variables_bench [rows]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <opencreport.h>
+
+#define DEFAULT_ROWS 20000
+#define COLS 6
+
+static const char *colnames[COLS] = { "id", "grp", "sub", "a", "b", "c" };
+
+static const int32_t coltypes[COLS] = {
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER,
+	OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER, OCRPT_RESULT_NUMBER
+};
+
+static const char *breaks[] = { "grp", "sub", NULL };
+#define BREAKS (sizeof(breaks) / sizeof(breaks[0]))
+
+static const struct {
+	ocrpt_var_type type;
+	const char *name;
+} vartypes[] = {
+	{ OCRPT_VARIABLE_SUM, "sum" },
+	{ OCRPT_VARIABLE_AVERAGE, "avg" },
+	{ OCRPT_VARIABLE_COUNT, "cnt" },
+	{ OCRPT_VARIABLE_LOWEST, "low" },
+	{ OCRPT_VARIABLE_HIGHEST, "high" },
+};
+#define VARTYPES (sizeof(vartypes) / sizeof(vartypes[0]))
+
+static char **make_data(int32_t rows) {
+	char **data = malloc((rows + 1) * COLS * sizeof(char *));
+	int32_t i, j;
+
+	for (j = 0; j < COLS; j++)
+		data[j] = strdup(colnames[j]);
+
+	for (i = 1; i <= rows; i++) {
+		char buf[32];
+		int32_t vals[COLS] = { i, i / 1000, i / 100, i % 97, (i * 7) % 1013, (i * 13) % 10007 };
+
+		for (j = 0; j < COLS; j++) {
+			snprintf(buf, sizeof(buf), "%d", vals[j]);
+			data[i * COLS + j] = strdup(buf);
+		}
+	}
+
+	return data;
+}
+
+static void free_data(char **data, int32_t rows) {
+	int32_t i;
+
+	for (i = 0; i < (rows + 1) * COLS; i++)
+		free(data[i]);
+	free(data);
+}
+
+int main(int argc, char **argv) {
+	int32_t rows = (argc > 1 ? atoi(argv[1]) : DEFAULT_ROWS);
+	char **data;
+	opencreport *o;
+	ocrpt_datasource *ds;
+	ocrpt_query *q;
+	ocrpt_report *r;
+	struct timespec start, end;
+	int32_t nvars = 0;
+	uint32_t b, t;
+	int32_t c;
+
+	if (rows <= 0)
+		rows = DEFAULT_ROWS;
+
+	data = make_data(rows);
+
+	o = ocrpt_init();
+	ocrpt_set_output_format(o, OCRPT_OUTPUT_TXT);
+	ds = ocrpt_datasource_add(o, "array", "array", NULL);
+	q = ocrpt_query_add_data(ds, "a", (const char **)data, rows, COLS, coltypes, COLS);
+
+	r = ocrpt_part_column_new_report(ocrpt_part_row_new_column(ocrpt_part_new_row(ocrpt_part_new(o))));
+	ocrpt_report_set_main_query(r, q);
+
+	for (b = 0; b < BREAKS - 1; b++) {
+		ocrpt_break *br = ocrpt_break_new(r, breaks[b]);
+
+		ocrpt_break_add_breakfield(br, ocrpt_report_expr_parse(r, breaks[b], NULL));
+	}
+
+	for (b = 0; b < BREAKS; b++) {
+		for (c = 3; c < COLS; c++) {
+			for (t = 0; t < VARTYPES; t++) {
+				char name[64];
+
+				snprintf(name, sizeof(name), "%s_%s_%s", vartypes[t].name, colnames[c], breaks[b] ? breaks[b] : "all");
+				if (ocrpt_variable_new(r, vartypes[t].type, name, colnames[c], NULL, breaks[b], false))
+					nvars++;
+			}
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ocrpt_execute(o);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("rows: %d variables: %d time: %.3f ms\n", rows, nvars,
+			(end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0);
+
+	ocrpt_free(o);
+	free_data(data, rows);
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+#include <stdio.h>
+
+#include <opencreport.h>
+#include "test_common.h"
+
+int main(int argc, char **argv) {
+	opencreport *o = ocrpt_init();
+	ocrpt_datasource *ds = ocrpt_datasource_add(o, "xml", "xml", NULL);
+	ocrpt_query *q;
+	ocrpt_query_result *qr;
+	int32_t cols, row, i;
+
+	/* The file has no <fields>, the first row holds the column names */
+	q = ocrpt_query_add_file(ds, "a", "xmldata6.xml", NULL, 0);
+	qr = ocrpt_query_get_result(q, &cols);
+	printf("Query columns:\n");
+	for (i = 0; i < cols; i++)
+		printf("%d: '%s'\n", i, ocrpt_query_result_column_name(qr, i));
+
+	row = 0;
+	ocrpt_query_navigate_start(q);
+
+	while (ocrpt_query_navigate_next(q)) {
+		qr = ocrpt_query_get_result(q, &cols);
+
+		printf("Row #%d\n", row++);
+		print_result_row("a", qr, cols);
+
+		printf("\n");
+	}
+
+	printf("--- END ---\n");
+
+	ocrpt_free(o);
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+<?php
+/*
+ * OpenCReports test
+ * Copyright (C) 2019-2026 Zoltán Böszörményi <zboszor@gmail.com>
+ * See COPYING.LGPLv3 in the toplevel directory.
+ */
+
+require_once 'test_common.php';
+
+$o = new OpenCReport();
+
+$ds = $o->datasource_add("xml", "xml");
+
+/* The file has no <fields>, the first row holds the column names */
+$q = $ds->query_add("a", "xmldata6.xml");
+print_query_columns($q);
+
+$row = 0;
+$q->navigate_start();
+
+while ($q->navigate_next()) {
+	$qr = $q->get_result();
+
+	echo "Row #" . $row . PHP_EOL;
+	$row++;
+	print_result_row("a", $qr);
+
+	echo PHP_EOL;
+}
+
+echo "--- END ---" . PHP_EOL;